@@ -26,6 +26,10 @@ if [ -z ${BIN+x} ];then
 	exit 42
 fi
 
+# the indexes, logs, stats, caches, and sockets the cases write; removed once
+# every case passed.
+SCRATCH=$(mktemp -d)
+
 #
 # SUCCESS SCENARIOS
 #
@@ -47,3 +51,285 @@ ${BIN} samples/a.txt samples/b.txt -o firstdiff.diff
 bail_if_nonzero
 zero_differences
 
+${BIN} -N samples/a.txt samples/b.txt -o samples/overlap.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -j 3 -N samples/a.txt samples/b.txt -o samples/overlap.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -S intersect samples/a.txt samples/b.txt -o samples/intersect.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -S minus samples/a.txt samples/b.txt -o samples/minus.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -M -S symdiff samples/a.txt samples/b.txt -o samples/symdiff.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -T samples/base.txt samples/ours.txt samples/theirs.txt -o samples/threeway.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -S delta samples/a.txt samples/b.txt -o samples/delta.ndjson
+bail_if_nonzero
+zero_differences
+
+${BIN} -A samples/delta.ndjson samples/a.txt -o samples/applied.out
+bail_if_nonzero
+zero_differences
+
+# a raw domain or hosts entry and a '||domain^' entry of the same name differ:
+# the latter blocks the subdomains too.
+${BIN} -S delta samples/raw.txt samples/full.txt -o samples/rawfull.ndjson
+bail_if_nonzero
+zero_differences
+
+${BIN} -A samples/rawfull.ndjson samples/raw.txt -o samples/rawfull.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -S intersect samples/full.txt samples/hosts.txt -o samples/hostsfull.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -S minus samples/full.txt samples/raw.txt -o samples/fullminus.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -N samples/raw.txt samples/hosts.txt samples/full.txt -o samples/fulloverlap.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -D -x samples/a.txt -o ${SCRATCH}/a.idx
+bail_if_nonzero
+zero_differences
+
+${BIN} -D ${SCRATCH}/a.idx -o samples/a.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -S minus ${SCRATCH}/a.idx samples/b.txt -o samples/minus.out
+bail_if_nonzero
+zero_differences
+
+
+rm -f ${SCRATCH}/u.idx
+${BIN} -U ${SCRATCH}/u.idx samples/a.txt samples/b.txt
+bail_if_nonzero
+zero_differences
+
+${BIN} -D ${SCRATCH}/u.idx -o samples/ab.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -U ${SCRATCH}/u.idx samples/a.txt
+bail_if_nonzero
+zero_differences
+
+${BIN} -D ${SCRATCH}/u.idx -o samples/a.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -Q samples/queries.txt samples/a.txt samples/b.txt -o samples/queries.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -D samples/a.txt samples/hosts.txt samples/raw.txt -o samples/mixed.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -D samples/a.txt samples/hosts.txt samples/raw.txt -o samples/mixed.out -F rpz:samples/mixed.rpz -F unbound:samples/mixed.unbound
+bail_if_nonzero
+zero_differences
+
+${BIN} -D samples/allow.txt -o samples/allow.out -F dnsmasq:samples/allow.dnsmasq
+bail_if_nonzero
+zero_differences
+
+${BIN} -D samples/case.txt -o samples/case.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -J ${SCRATCH}/a.stats -D samples/a.txt -o samples/a.out
+bail_if_nonzero
+zero_differences
+grep -q '"final":true,.*"lines_read":28,.*"output_lines":28,' ${SCRATCH}/a.stats
+bail_if_nonzero
+
+# a warning repeated for many lines of an input is logged ten times and counted
+rm -f ${SCRATCH}/longlines.log
+${BIN} -E ${SCRATCH}/longlines.log -D samples/longlines.txt -o samples/longlines.out
+bail_if_nonzero
+zero_differences
+test "$(grep -c '^WARNING: requested line length' ${SCRATCH}/longlines.log)" -eq 10
+bail_if_nonzero
+grep -q "^NOTICE: 6 more like 'WARNING: requested line length" ${SCRATCH}/longlines.log
+bail_if_nonzero
+
+${BIN} -D -P .out samples/a.txt samples/b.txt samples/pro.txt
+bail_if_nonzero
+zero_differences
+
+${BIN} -j 3 -D samples/a.txt samples/b.txt -o samples/ab.out
+bail_if_nonzero
+zero_differences
+
+# the reader thread of large inputs, forced on for small ones and one core
+PFB_TEST_PIPELINE=1 ${BIN} -D samples/pro.txt -o samples/pro.out
+bail_if_nonzero
+zero_differences
+
+PFB_TEST_PIPELINE=1 ${BIN} -D samples/a.txt samples/b.txt -o samples/ab.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -e -b 1 -D samples/a.txt samples/b.txt -o samples/ab.out
+bail_if_nonzero
+zero_differences
+
+# the runs of -e keep the header of a single input, also when -D switches to
+# them for the budget; the switch is said even with -s.
+${BIN} -e -b 1 -D samples/pro.txt -o samples/pro.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -s -b 32 -D samples/pro.txt -o samples/pro.out 2>&1 | \
+	grep -q '^NOTICE: the inputs exceed the memory budget'
+bail_if_nonzero
+zero_differences
+
+${BIN} -b 1 -D samples/a.txt -o samples/a.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -z 1 -J ${SCRATCH}/ab.stats -D samples/a.txt samples/b.txt -o samples/ab.out
+bail_if_nonzero
+zero_differences
+grep -q '"final":true,.*"lines_read":47,.*"lines_prefiltered":12,' ${SCRATCH}/ab.stats
+bail_if_nonzero
+
+rm -rf ${SCRATCH}/pfb.cache
+${BIN} -C ${SCRATCH}/pfb.cache -D samples/a.txt samples/b.txt -o samples/ab.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -C ${SCRATCH}/pfb.cache -D samples/a.txt samples/b.txt -o samples/ab.out
+bail_if_nonzero
+zero_differences
+
+# the exceptions of one input apply to the others whether it is read, mapped
+# from an index, or from a cached run.
+${BIN} -D samples/exceptions.txt samples/a.txt samples/b.txt -o samples/exceptions.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -D -x samples/exceptions.txt -o ${SCRATCH}/e.idx
+bail_if_nonzero
+zero_differences
+
+${BIN} -D ${SCRATCH}/e.idx samples/a.txt samples/b.txt -o samples/exceptions.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -e -D ${SCRATCH}/e.idx samples/a.txt samples/b.txt -o samples/exceptions.out
+bail_if_nonzero
+zero_differences
+
+rm -rf ${SCRATCH}/pfb.cache
+${BIN} -C ${SCRATCH}/pfb.cache -D samples/exceptions.txt samples/a.txt samples/b.txt -o samples/exceptions.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -C ${SCRATCH}/pfb.cache -D samples/exceptions.txt samples/a.txt samples/b.txt -o samples/exceptions.out
+bail_if_nonzero
+zero_differences
+
+# -U keeps the exceptions of an input with the index; the entries they allow
+# come back once that input is dropped.
+rm -f ${SCRATCH}/u.idx
+${BIN} -U ${SCRATCH}/u.idx samples/exceptions.txt samples/a.txt samples/b.txt
+bail_if_nonzero
+${BIN} -D ${SCRATCH}/u.idx -o samples/exceptions.out
+bail_if_nonzero
+zero_differences
+
+${BIN} -U ${SCRATCH}/u.idx samples/a.txt samples/b.txt
+bail_if_nonzero
+${BIN} -D ${SCRATCH}/u.idx -o samples/ab.out
+bail_if_nonzero
+zero_differences
+
+# -R serves requests over a Unix domain socket until signaled; socat is the
+# client. the requests of samples/daemon.txt are answered in one connection,
+# then a request split across two writes and one longer than a request may be.
+if command -v socat > /dev/null; then
+	rm -f ${SCRATCH}/pfb.sock
+	${BIN} -R ${SCRATCH}/pfb.sock samples/a.txt &
+	daemon_pid=$!
+	# a failed check exits; the server must not outlive it.
+	trap "kill ${daemon_pid} 2> /dev/null" EXIT
+	for i in $(seq 100); do [ -S ${SCRATCH}/pfb.sock ] && break; sleep 0.1; done
+	[ -S ${SCRATCH}/pfb.sock ]
+	bail_if_nonzero
+
+	socat -t 10 - UNIX-CONNECT:${SCRATCH}/pfb.sock < samples/daemon.txt > samples/daemon.out
+	bail_if_nonzero
+	{ printf 'BLOCK'; sleep 0.5; printf 'ED b.live.aco\nQUIT\n'; } | \
+		socat -t 10 - UNIX-CONNECT:${SCRATCH}/pfb.sock >> samples/daemon.out
+	bail_if_nonzero
+	head -c 5000 /dev/zero | tr '\0' a | \
+		socat -t 10 - UNIX-CONNECT:${SCRATCH}/pfb.sock >> samples/daemon.out
+	bail_if_nonzero
+	zero_differences
+
+	# a dump larger than the socket buffers is streamed whole.
+	printf 'ADD pro samples/pro.txt\nDUMP pro\nQUIT\n' | \
+		socat -t 10 - UNIX-CONNECT:${SCRATCH}/pfb.sock > ${SCRATCH}/pro.dump
+	bail_if_nonzero
+	pro_count=$(grep -vc '^[![]' samples/pro.out)
+	{ echo "OK pro ${pro_count}"; echo "OK ${pro_count}"; \
+		grep -v '^[![]' samples/pro.out; echo .; echo OK; } | cmp - ${SCRATCH}/pro.dump
+	bail_if_nonzero
+
+	# an index that cannot be used is refused; the server goes on.
+	head -c 128 ${SCRATCH}/a.idx > ${SCRATCH}/bad.idx
+	printf 'ADD bad %s\nLISTS\nQUIT\n' ${SCRATCH}/bad.idx | \
+		socat -t 10 - UNIX-CONNECT:${SCRATCH}/pfb.sock > ${SCRATCH}/bad.out
+	bail_if_nonzero
+	printf 'ERR cannot load %s\nOK 2\nsamples/a.txt\t28\npro\t%s\n.\nOK\n' \
+		${SCRATCH}/bad.idx ${pro_count} | cmp - ${SCRATCH}/bad.out
+	bail_if_nonzero
+
+	kill -TERM ${daemon_pid}
+	wait ${daemon_pid}
+	bail_if_nonzero
+	trap - EXIT
+	[ ! -e ${SCRATCH}/pfb.sock ]
+	bail_if_nonzero
+
+	# so is a list over the -b budget.
+	${BIN} -b 1 -R ${SCRATCH}/pfb.sock samples/a.txt &
+	daemon_pid=$!
+	trap "kill ${daemon_pid} 2> /dev/null" EXIT
+	for i in $(seq 100); do [ -S ${SCRATCH}/pfb.sock ] && break; sleep 0.1; done
+	printf 'ADD pro samples/pro.txt\nLISTS\nQUIT\n' | \
+		socat -t 10 - UNIX-CONNECT:${SCRATCH}/pfb.sock > ${SCRATCH}/bad.out
+	bail_if_nonzero
+	printf 'ERR samples/pro.txt exceeds the memory budget of 1 MB\nOK 1\nsamples/a.txt\t28\n.\nOK\n' | \
+		cmp - ${SCRATCH}/bad.out
+	bail_if_nonzero
+
+	kill -TERM ${daemon_pid}
+	wait ${daemon_pid}
+	bail_if_nonzero
+	trap - EXIT
+else
+	echo "SKIPPED: -R needs socat"
+fi
+
+rm -rf "${SCRATCH}"
@@ -39,3 +39,110 @@ ${BIN} samples/a.txt
 bail_if_zero
 zero_differences
 
+
+${BIN} -N samples/a.txt
+bail_if_zero
+zero_differences
+
+${BIN} -D -N samples/a.txt samples/b.txt
+bail_if_zero
+zero_differences
+
+${BIN} -S union samples/a.txt samples/b.txt
+bail_if_zero
+zero_differences
+
+${BIN} -D -S minus samples/a.txt
+bail_if_zero
+zero_differences
+
+${BIN} -T samples/base.txt samples/ours.txt
+bail_if_zero
+zero_differences
+
+${BIN} -A samples/delta.ndjson samples/a.txt samples/b.txt
+bail_if_zero
+zero_differences
+
+${BIN} -A samples/missing.ndjson samples/a.txt
+bail_if_zero
+zero_differences
+
+${BIN} -x samples/a.txt samples/b.txt
+bail_if_zero
+zero_differences
+
+${BIN} -U u.idx -D samples/a.txt
+bail_if_zero
+zero_differences
+
+${BIN} -U u.idx
+bail_if_zero
+zero_differences
+
+${BIN} -R pfb.sock -D samples/a.txt
+bail_if_zero
+zero_differences
+
+${BIN} -Q samples/queries.txt -D samples/a.txt
+bail_if_zero
+zero_differences
+
+${BIN} -Q samples/missing.txt samples/a.txt
+bail_if_zero
+zero_differences
+
+${BIN} -P .out samples/a.txt
+bail_if_zero
+zero_differences
+
+${BIN} -D -P .out samples/a.txt -o samples/a.out
+bail_if_zero
+zero_differences
+
+${BIN} -C pfb.cache -U u.idx samples/a.txt
+bail_if_zero
+zero_differences
+
+${BIN} -e samples/a.txt samples/b.txt
+bail_if_zero
+zero_differences
+
+${BIN} -b 1 samples/pro.txt samples/19319e73-1a4e-4c84-8202-fc96329a33bc.adlist
+bail_if_zero
+zero_differences
+
+${BIN} -e -D -x samples/a.txt -o a.idx
+bail_if_zero
+zero_differences
+
+${BIN} -D -F bind samples/a.txt
+bail_if_zero
+zero_differences
+
+${BIN} -F hosts samples/a.txt samples/b.txt
+bail_if_zero
+zero_differences
+
+${BIN} -j -1 -D samples/a.txt samples/b.txt -o samples/ab.out
+bail_if_zero
+zero_differences
+
+${BIN} -j 2x -D samples/a.txt samples/b.txt -o samples/ab.out
+bail_if_zero
+zero_differences
+
+${BIN} -z -1 -D samples/a.txt samples/b.txt -o samples/ab.out
+bail_if_zero
+zero_differences
+
+${BIN} -b 32MB -D samples/a.txt samples/b.txt -o samples/ab.out
+bail_if_zero
+zero_differences
+
+# a.txt and a.out would both be written to a.dd; neither is.
+${BIN} -D -P .dd samples/a.txt samples/a.out
+bail_if_zero
+zero_differences
+[ ! -e samples/a.dd ]
+bail_if_nonzero
@@ -28,8 +28,11 @@ typedef struct AdbplusView
 	MatchStrength_t ms;
 	unsigned int len;
 	char const *data;
+	// where the next host name of a hosts line begins; nullptr otherwise.
+	char const *next;
 } AdbplusView_t;
 
 
 extern bool parse_adbplus_line(AdbplusView_t lv[static 1],
 		char const input_line[static 1]);
+extern bool next_hosts_domain(AdbplusView_t lv[static 1]);
@@ -19,6 +19,7 @@
  * limitations under the License.
  */
 #pragma once
+#include <threads.h>
 
 typedef struct ContextPair
 {
@@ -30,4 +31,21 @@ typedef struct ContextPair
 	 * DomainTree. Initialized once. Free'ed in pfb_close_context().
 	 */
 	struct DomainView *dv;
+
+	/**
+	 * Where exception rules are inserted. Exceptions are dropped when
+	 * nullptr.
+	 */
+	struct pfb_allow *allow;
+
+	/**
+	 * Drops lines read before; nullptr without -z.
+	 */
+	struct pfb_prefilter *prefilter;
+
+	/**
+	 * Guards 'allow' while the inputs are read by several threads; nullptr
+	 * otherwise.
+	 */
+	mtx_t *allow_lock;
 } ContextPair_t;
@@ -24,6 +24,7 @@
 #include <stdbool.h>
 #include <limits.h>
 #include <assert.h>
+#include "pfb_log.h"
 
 #define UNUSED(x) (void)(x)
 
@@ -80,15 +81,8 @@ typedef uchar subdomain_len_t;
 // can change to e.g. & to see the full buffer
 extern const char LINE_TERMINAL;
 
-extern void open_globalErrLog();
-FILE *get_globalErrLog();
-extern void close_globalErrLog();
-extern void free_globalErrLog();
-
 #define ELOG_STDERR(fmt, ...) do { \
-	open_globalErrLog(); \
-	fprintf(get_globalErrLog(), fmt, ##__VA_ARGS__); \
-	close_globalErrLog(); \
+	pfb_log_printf(PFB_LOG_ERR, fmt, ##__VA_ARGS__); \
 } while(0)
 
 
@@ -103,6 +103,7 @@ typedef struct SubdomainView
 extern void init_DomainView(DomainView_t dv[static 1]);
 extern bool update_DomainView(DomainView_t dv[static 1], char const *fqd, size_len_t len);
 extern void free_DomainView(DomainView_t dv[static 1]);
+extern bool normalize_domain(char *fqd, size_len_t len, bool folded[static 1]);
 
 extern DomainViewIter_t begin_DomainView(DomainView_t *dv);
 extern bool next_DomainView(DomainViewIter_t *it, SubdomainView_t *sdv);
@@ -20,7 +20,11 @@
  */
 #pragma once
 #include "dedupdomains.h"
+#include "pfb_stats.h"
+// count the expansions of the tables of the tree and of the TLDs.
+#define uthash_expand_fyi(tbl) pfb_stats_count(PFB_STATS_HASH_RESIZES, 1)
 #include "uthash.h"
+#include "domain.h"
 
 typedef struct DomainTree
 {
@@ -49,3 +53,32 @@ extern void transfer_DomainInfo(DomainTree_t **root,
 extern void visit_DomainTree(DomainTree_t **root,
 		void(*visitor_func)(struct DomainInfo **di, void *context),
 		void *context);
+
+extern void visit_below_DomainTree(const struct TLD_implementation tld_impl,
+		DomainView_t dv[static 1],
+		void(*visitor_func)(struct DomainInfo **di, void *context),
+		void *context);
+
+/**
+ * One query of lookup_batch_DomainTree(). 'dv' is set by the caller; 'di' and
+ * 'labels' are the result. The remaining fields are the state of the walk.
+ */
+typedef struct DomainLookup
+{
+	DomainView_t *dv;
+	struct DomainInfo const *di;
+	size_len_t labels;
+
+	DomainViewIter_t it;
+	SubdomainView_t sdv;
+	DomainTree_t *level;
+	UT_hash_bucket *bucket;
+	unsigned hashv;
+} DomainLookup_t;
+
+extern struct DomainInfo const *lookup_DomainTree(
+		const struct TLD_implementation tld_impl, DomainView_t dv[static 1],
+		size_len_t labels[static 1]);
+
+extern void lookup_batch_DomainTree(const struct TLD_implementation tld_impl,
+		DomainLookup_t lookups[], uint count);
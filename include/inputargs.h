@@ -21,8 +21,18 @@
 #pragma once
 #include "dedupdomains.h"
 #include "paths_list.h"
+#include "pfb_differ.h"
 #include <stdio.h>
 
+/**
+ * One further output of -D: a file and the format its entries are written in.
+ */
+typedef struct pfb_out_spec
+{
+	enum pfb_out_format format;
+	const char *fname;
+} pfb_out_spec_t;
+
 typedef struct input_args
 {
 	/**
@@ -32,10 +42,16 @@ typedef struct input_args
 	bool use_shared_buffer;
 	/**
 	 * In conjunction with 'b', specifies the maximum size in MB for each input
-	 * buffer that can be held in memory.
+	 * buffer that can be held in memory. Caps the memory used by 'e'.
 	 */
 	uint in_memory_buffer_size;
 
+	/**
+	 * 'e' de-duplicate the inputs of -D in sorted runs spilled to temporary
+	 * files and merged, for inputs larger than memory.
+	 */
+	bool external_mode;
+
 	/**
 	 * 's' set to false to print or log file (if provided) diagnostics and
 	 * progress.
@@ -66,6 +82,90 @@ typedef struct input_args
 	 */
 	bool deduplicate_mode;
 
+	/**
+	 * 'P' extension of the outputs of -D when each input is de-duplicated on
+	 * its own. Each output is written next to its input.
+	 */
+	const char *out_ext;
+
+	/**
+	 * 'F' format of the output of -D. adbplus unless given.
+	 */
+	enum pfb_out_format out_format;
+	/**
+	 * 'F' with a filename: further outputs of -D, each in its own format. The
+	 * entries are written to all outputs in a single pass.
+	 */
+	pfb_out_spec_t *out_specs;
+	uint num_out_specs;
+
+	/**
+	 * 'N' compute how any number of input sets overlap one another in a single
+	 * pass. Each set is de-duplicated once.
+	 */
+	bool overlap_mode;
+
+	/**
+	 * 'T' write the changes made by two input sets since a common base set.
+	 * Expects exactly three sets: base, ours, theirs.
+	 */
+	bool threeway_mode;
+
+	/**
+	 * 'S' write a clean adlist holding the intersection, A minus B, or the
+	 * symmetric difference, or write a delta, instead of the diff report.
+	 */
+	enum diff_output diff_output;
+
+	/**
+	 * 'A' path to a delta written by '-S delta' to apply to the single input
+	 * set given as the base.
+	 */
+	const char *delta_fname;
+
+	/**
+	 * 'U' path to an index to update with the inputs given as to -D. The
+	 * updated index is written to the output filename, which defaults to this
+	 * path.
+	 */
+	const char *update_fname;
+
+	/**
+	 * 'Q' path to a file of query names, one per line, to look up in the
+	 * inputs given as to -D. Writes the rule blocking each blocked name.
+	 */
+	const char *query_fname;
+
+	/**
+	 * 'C' path to a directory holding the de-duplicated run of each plain
+	 * text input. An input unchanged since its run was written is mapped
+	 * from the run instead of parsed.
+	 */
+	const char *cache_dir;
+
+	/**
+	 * 'R' path of a Unix domain socket to serve requests on. The input sets,
+	 * if any, are the lists loaded at startup.
+	 */
+	const char *socket_fname;
+
+	/**
+	 * 'J' path to write the run's counters and timings to as JSON, or '-'
+	 * for stderr; see pfb_stats.h
+	 */
+	const char *stats_fname;
+
+	/**
+	 * 'z' size in MB of the set of line fingerprints which drops repeated
+	 * lines before they are parsed; see pfb_prefilter.h. 0 for none.
+	 */
+	uint prefilter_size;
+
+	/**
+	 * 'j' threads to run on; see pfb_pool.h. 1 by default, 0 for one per core.
+	 */
+	uint jobs;
+
 	/**
 	 * If true, will make every effort to load all of the input sources into
 	 * memory, compute the de-dup, sort, and difference in memory, and write to
@@ -106,10 +206,12 @@ typedef struct input_args
 	paths_list_t input_paths_B;
 
 	/**
-	 * FILE for writing diagnostics and progress to. default is stdout.
+	 * Used for the overlap, three-way, apply, and serve modes: one list of paths per set, in
+	 * the order given on the command line, and the argument naming each set.
 	 */
-	FILE *outFile;
-	FILE *errFile;
+	paths_list_t *input_paths_sets;
+	char *const *input_sets_names;
+	uint num_sets;
 
 	bool errLog_flag;
 	char const *errLog_fname;
@@ -122,15 +224,11 @@ extern void init_input_args(input_args_t flags[static 1]);
 extern void free_input_args(input_args_t flags[static 1]);
 extern bool silent_mode(const input_args_t flags[static 1]);
 extern bool parse_input_args(int argc, char * const* argv, input_args_t flags[static 1]);
-
-extern bool open_logfile(input_args_t flags[static 1]);
-extern FILE *get_logFile(input_args_t iargs[static 1]);
-extern void close_logfile(input_args_t flags[static 1]);
+extern paths_list_t read_input_paths(const char path[static 1]);
+extern void free_paths_list(paths_list_t pl[static 1]);
 
 #define LOG_IFARGS(args, fmt, ...) do { \
 	if(!silent_mode(args)) { \
-		open_logfile(args); \
-		fprintf(get_logFile(args), fmt, ##__VA_ARGS__); \
-		close_logfile(args); \
+		pfb_log_printf(PFB_LOG_STD, fmt, ##__VA_ARGS__); \
 	} \
 } while(0)
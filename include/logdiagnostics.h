@@ -19,11 +19,9 @@
 
 #define LOG_DIAG(clsname, ptr, fmt, ...) do { \
 BORROW_SPACES; \
-open_globalErrLog(); \
-fprintf(get_globalErrLog(), "[%s:%s] %s %p\n" \
+ELOG_STDERR("[%s:%s] %s %p\n" \
 		" %s   " fmt, \
 		__FILE__, __FUNCTION__, clsname, ptr, \
 		spaces_str, __VA_ARGS__); \
-close_globalErrLog(); \
 RETURN_SPACES; \
 } while(0)
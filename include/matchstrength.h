@@ -31,6 +31,8 @@ typedef enum MatchStrength
 	MATCH_COMMENT = 3,
 	MATCH_HEADER = 4,
 	MATCH_POSSIBLE = 5,
+	// '@@||domain^': allows the domain and its subdomains.
+	MATCH_EXCEPTION = 6,
 } MatchStrength_t;
 
 #endif
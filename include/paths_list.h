@@ -22,6 +22,8 @@
 #include "dedupdomains.h"
 #include <unistd.h>
 
+#define PATH_SEP_CHAR '/'
+
 /**
  * Contains information from a struct stat useful to identify a path.
  */
@@ -30,6 +32,8 @@ typedef struct pfb_stat
 	__off_t file_size;
 	__dev_t st_dev;
 	__ino_t st_ino;
+	// seconds since the epoch of the last modification.
+	__time_t mtime;
 } pfb_stat_t;
 
 /**
@@ -51,6 +55,9 @@ typedef struct path_info
 	// file and read the entire file into memory.
 	// when false, will read the file in chunks.
 	bool use_mem_buffer;
+	// true when the path begins with the binary index magic. such a path is
+	// mapped instead of read and de-duplicated.
+	bool is_index;
 	char *path;
 	pfb_stat_t pfb_s;
 } path_info_t;
@@ -0,0 +1,64 @@
+/**
+ * pfb_allow.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include "domain.h"
+#include "matchstrength.h"
+#include "pfb_context.h"
+#include "tld_context.h"
+
+/**
+ * The exception rules, '@@||domain^', read alongside the blocked entries. Each
+ * allows its domain and the subdomains and is held as a MATCH_FULL entry of a
+ * tree of its own; the DomainInfo of an entry refers to its name in 'names'.
+ */
+typedef struct pfb_allow
+{
+	TLD_implementation_t tld_impl;
+
+	// copies of the allowed domains, each null terminated.
+	char *names;
+	size_t names_used;
+	size_t names_alloc;
+
+	// number of exception rules inserted.
+	size_t count;
+
+	// true to write the exceptions within a blocked MATCH_FULL entry after it;
+	// see pfb_write_allowed().
+	bool write_exceptions;
+
+	// reused by every lookup.
+	DomainView_t dv;
+} pfb_allow_t;
+
+extern pfb_allow_t pfb_init_allow(bool write_exceptions);
+extern void pfb_free_allow(pfb_allow_t allow[static 1]);
+extern void pfb_insert_allow(pfb_allow_t allow[static 1], const char *domain,
+		size_len_t len);
+extern void pfb_insert_allowed(pfb_allow_t allow[static 1],
+		const char *allowed, size_t len);
+extern void pfb_keep_allowed(pfb_allow_t const allow[static 1],
+		pfb_out_buffer_t out_buffer[static 1]);
+extern bool pfb_is_allowed(pfb_allow_t allow[static 1], const char *line,
+		line_len_t line_len, MatchStrength_t ms);
+extern void pfb_write_allowed(pfb_out_context_t out_context[static 1],
+		const char *line, line_len_t line_len, MatchStrength_t ms);
@@ -50,6 +50,18 @@ typedef struct pfb_context
 	 */
 	bool use_mem_buffer;
 	char *mem_buffer;
+	/**
+	 * true if the domain of any entry was lowercased when read; its lines
+	 * are lowercased again as they are written.
+	 */
+	bool folded;
+	// entries dropped for a domain which is not valid.
+	size_t rejected;
+	// lines read, entries inserted into the tree, and entries written; see
+	// pfb_stats.h
+	size_t lines;
+	size_t entries;
+	size_t kept;
 } pfb_context_t;
 
 
@@ -83,8 +95,42 @@ typedef struct pfb_out_buffer
 	size_t alloc_len;
 	// collection of offsets into buffer
 	LiteLineData_t litelines;
+	// when non-null, buffer and litelines are views into this read-only
+	// mapping of a binary index rather than allocations.
+	void *mapping;
+	size_t mapping_len;
+	// the domains of the exception rules read along with the entries, each
+	// null terminated; kept so a list merged with this one is subtracted from
+	// too. see pfb_allow.h. a view into the mapping of an index.
+	char *allowed;
+	size_t allowed_len;
+	// bytes of buffer and litelines counted against the memory budget; see
+	// pfb_memory.h
+	size_t charged;
 } pfb_out_buffer_t;
 
+/**
+ * The format entries are written to an output in. A MATCH_FULL entry blocks
+ * the domain and its subdomains, a MATCH_WEAK entry the domain alone; formats
+ * which cannot tell them apart, i.e., hosts and domains, block the domain
+ * alone.
+ */
+enum pfb_out_format : char
+{
+	// '||domain^' or a raw domain, as read.
+	PFB_FORMAT_ADBPLUS = 0,
+	// one domain per line
+	PFB_FORMAT_DOMAINS = 1,
+	// '0.0.0.0 domain'
+	PFB_FORMAT_HOSTS = 2,
+	// dnsmasq 'address=/domain/'
+	PFB_FORMAT_DNSMASQ = 3,
+	// unbound 'local-zone: "domain." always_nxdomain'
+	PFB_FORMAT_UNBOUND = 4,
+	// a response policy zone
+	PFB_FORMAT_RPZ = 5,
+};
+
 typedef struct pfb_out_context
 {
 	union {
@@ -104,12 +150,26 @@ typedef struct pfb_out_context
 	// how many entries were written. this excludes header lines and comments.
 	size_t counter;
 
+	// when set, the entries collected in out_buffer are written to this FILE
+	// in the binary index format at the end of pfb_consolidate().
+	FILE *index_file;
+
 	// provides ability to direct the output to an alternate construct such as
 	// another in-memory buffer. it might even take the input, parse them into
 	// domainviews, drop comments and header sections, and jazz to prepare for a
 	// subsequent operation e.g. diff.
 	size_t (*writer_cb)(const char *buffer_to_write, size_len_t byte_count,
 			struct pfb_out_context*);
+
+	// the format entries are written in. see pfb_format.h
+	enum pfb_out_format format;
+	// further outputs written in the same pass over the entries; each may be
+	// in its own format. owned by whoever set it.
+	struct pfb_out_context *next;
+
+	// when set, the exception rules subtracted from the entries as they are
+	// written; see pfb_allow.h. owned by whoever set it.
+	struct pfb_allow *allow;
 } pfb_out_context_t;
 
 
@@ -144,6 +204,9 @@ extern void pfb_close_out_context(pfb_out_context_t c[static 1]);
 extern void pfb_open_out_context(pfb_out_context_t c[static 1], bool append_output);
 
 extern pfb_out_context_t pfb_init_out_context(const char *out_fname);
+extern pfb_out_context_t pfb_init_out_context_BUFFER(
+		pfb_out_buffer_t out_buffer[static 1]);
+extern bool pfb_is_out_context_BUFFER(pfb_out_context_t const c[static 1]);
 extern pfb_context_t pfb_context_from_FILE(FILE *tmp);
 extern pfb_context_t pfb_context_from_BUFFER(pfb_out_buffer_t *buffer);
 extern void pfb_free_context(struct pfb_context c[static 1]);
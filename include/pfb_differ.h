@@ -20,12 +20,86 @@
  */
 #pragma once
 #include "pfb_context.h"
+#include "domain.h"
+
+// might also act as indexes into an array holding markers for what symbol(s) to
+// write to output file.
+enum dv_comparison : char
+{
+	dv_A_eq_dv_B = 0,
+	dv_A_blk_dv_B = 1,
+	dv_B_blk_dv_A = 2,
+	dv_A_isblk_dv_B = 3,
+	dv_B_isblk_dv_A = 4,
+	dv_A_exclusive = 5,
+	dv_B_exclusive = 6,
+	dv_A_lt_dv_B_write_A = 7,
+	dv_A_gt_dv_B_write_B = 8,
+};
+
+/**
+ * What a diff writes. DIFF_REPORT is the annotated report of additions and
+ * removals; the others write a clean adlist holding the result of a set
+ * operation on A and B.
+ */
+enum diff_output : char
+{
+	DIFF_REPORT = 0,
+	// entries blocked by both A and B
+	DIFF_INTERSECTION = 1,
+	// entries of A not blocked by B
+	DIFF_A_MINUS_B = 2,
+	// entries of A not blocked by B and entries of B not blocked by A
+	DIFF_SYMMETRIC = 3,
+	// records of the entries to add to and remove from A to produce B. see
+	// pfb_delta.h
+	DIFF_DELTA = 4,
+};
+
+/**
+ * One step of a k-way merge: an entry and every input holding it.
+ */
+typedef struct DV_merge_group
+{
+	// the entry as written in the de-duplicated input of the first owner. null
+	// terminated.
+	const char *line;
+	line_len_t line_len;
+	DomainView_t const *dv;
+
+	// ascending indexes of the inputs holding exactly this entry.
+	uint const *owners;
+	uint owners_used;
+	// index into the litelines of each owner at which it holds this entry;
+	// parallel to 'owners'.
+	size_len_t const *positions;
+
+	// ascending indexes of the inputs holding a MATCH_FULL parent of this
+	// entry, i.e., the inputs that block this entry.
+	uint const *covered_by;
+	uint covered_used;
+} DV_merge_group_t;
+
+extern int compare_dv(DomainView_t const dv_A[static 1],
+		DomainView_t const dv_B[static 1]);
 
 extern void diff_adbplus_adlists_FILE(pfb_context_t pcc_A[static 1],
 		const LiteLineData_t litelines_A[static 1],
 		pfb_context_t pcc_B[static 1], const LiteLineData_t litelines_B[static 1],
-		pfb_out_context_t out_context[static 1]);
+		pfb_out_context_t out_context[static 1], enum diff_output output);
 
 extern void diff_adbplus_adlists_BUFFER(pfb_out_buffer_t pcc_A[static 1],
-		pfb_out_buffer_t pcc_B[static 1], pfb_out_context_t out_context[static 1]);
+		pfb_out_buffer_t pcc_B[static 1], pfb_out_context_t out_context[static 1],
+		enum diff_output output);
+
+extern void merge_adbplus_adlists_BUFFER(pfb_out_buffer_t *const in[],
+		uint count,
+		void (*visitor)(DV_merge_group_t const group[static 1], void *context),
+		void *context);
+
+extern void merge3_adbplus_adlists_BUFFER(pfb_out_buffer_t base[static 1],
+		pfb_out_buffer_t ours[static 1], pfb_out_buffer_t theirs[static 1],
+		pfb_out_context_t out_context[static 1]);
 
+extern void union_adbplus_adlists_BUFFER(pfb_out_buffer_t *const in[],
+		uint count, pfb_out_context_t out_context[static 1]);
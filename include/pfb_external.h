@@ -0,0 +1,32 @@
+/**
+ * pfb_external.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include "paths_list.h"
+
+// budget used by -e when -b is not given
+#define PFB_EXTERNAL_DEFAULT_MB 256
+// a tree and its sorted output take about 14 times the bytes of the text they
+// are built from.
+#define PFB_EXTERNAL_TREE_FACTOR 16
+
+extern bool pfb_dedup_external(paths_list_t in_paths_list,
+		const char *out_fname, uint budget_mb);
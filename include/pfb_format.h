@@ -0,0 +1,32 @@
+/**
+ * pfb_format.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include "matchstrength.h"
+#include "pfb_context.h"
+
+extern bool pfb_parse_format(const char *name, size_t len,
+		enum pfb_out_format format[static 1]);
+extern void pfb_write_format_headers(pfb_out_context_t out_context[static 1]);
+extern void pfb_write_formatted(pfb_out_context_t out_context[static 1],
+		const char *line, line_len_t line_len, MatchStrength_t ms);
+extern void pfb_write_exception(pfb_out_context_t out_context[static 1],
+		const char *domain, size_len_t len);
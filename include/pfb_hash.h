@@ -0,0 +1,28 @@
+/**
+ * pfb_hash.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include <stdint.h>
+
+#define PFB_HASH_INIT 0xcbf29ce484222325ULL
+
+extern uint64_t pfb_hash64(void const *data, size_t len, uint64_t seed);
+extern bool pfb_hash_file(const char path[static 1], uint64_t hash[static 1]);
@@ -0,0 +1,129 @@
+/**
+ * pfb_index.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include "pfb_context.h"
+#include <stdint.h>
+
+/**
+ * A de-duplicated and sorted list stored so it can be mapped into memory and
+ * used as a pfb_out_buffer_t without parsing or building a DomainTree:
+ *
+ * header | sources | pfb_index_entry_t[entry_count] | masks[entry_count] |
+ * pfb_index_entry_t[shadow_count] | masks[shadow_count] |
+ * masks[allowed_count] | string table | allowed domains
+ *
+ * The string table holds each entry once, null terminated, exactly as the
+ * BUFFER writer lays them out; the entry offsets are relative to the start of
+ * the string table. The allowed domains are those of the exception rules read
+ * with the entries, each null terminated; they are already subtracted from the
+ * entries and are kept for the lists the index is merged with. Integers are in
+ * host byte order; an index written on a host of different byte order or
+ * layout is rejected.
+ *
+ * The sources, masks, and shadow entries are optional and only written by an
+ * incremental update (see pfb_update.h): bit i of an entry's mask is set when
+ * source i holds the entry. Shadow entries are held by a source but blocked by
+ * a parent from another source, or allowed by an exception; they are not part
+ * of the de-duplicated list and are kept so the list can be updated when that
+ * parent or exception goes away. The allowed domains then have a mask each,
+ * in the order they are stored.
+ */
+#define PFB_INDEX_MAGIC "PFBINDEX"
+#define PFB_INDEX_MAGIC_LEN 8
+#define PFB_INDEX_VERSION 5
+#define PFB_INDEX_BYTE_ORDER 0x0102
+#define PFB_INDEX_MAX_SOURCES 64
+
+typedef struct pfb_index_header
+{
+	char magic[PFB_INDEX_MAGIC_LEN];
+	uint32_t version;
+	uint16_t byte_order;
+	uint16_t line_info_size;
+	uint64_t entry_count;
+	uint64_t entries_offset;
+	uint64_t strings_offset;
+	uint64_t strings_len;
+	uint64_t source_count;
+	uint64_t sources_offset;
+	uint64_t masks_offset;
+	uint64_t shadow_count;
+	uint64_t shadow_entries_offset;
+	uint64_t shadow_masks_offset;
+	uint64_t allowed_offset;
+	uint64_t allowed_len;
+	uint64_t allowed_count;
+	uint64_t allowed_masks_offset;
+} pfb_index_header_t;
+
+/**
+ * One entry as written: the layout of line_info_t with its padding spelled
+ * out and zeroed, so an index is a function of its entries alone. A mapped
+ * index is read back as line_info_t.
+ */
+typedef struct pfb_index_entry
+{
+	int64_t offset;
+	uint16_t line_len;
+	uint16_t reserved[3];
+} pfb_index_entry_t;
+
+/**
+ * Identifies the content of one input the index was built from.
+ */
+typedef struct pfb_index_source
+{
+	uint64_t st_dev;
+	uint64_t st_ino;
+	uint64_t file_size;
+	uint64_t hash;
+} pfb_index_source_t;
+
+/**
+ * Which sources hold each entry of an index. All members are views into a
+ * mapping or into arrays owned by the caller.
+ */
+typedef struct pfb_index_sources
+{
+	pfb_index_source_t const *sources;
+	uint source_count;
+	// one per entry of the de-duplicated list
+	uint64_t const *masks;
+	// entries blocked by a parent from another source; offsets into the same
+	// string table as the de-duplicated list.
+	LiteLineData_t shadow;
+	uint64_t const *shadow_masks;
+	// one per allowed domain kept with the list
+	uint64_t const *allowed_masks;
+	size_t allowed_count;
+} pfb_index_sources_t;
+
+extern bool pfb_is_index_file(const char path[static 1]);
+extern bool pfb_map_index(const char path[static 1],
+		pfb_out_buffer_t out_buffer[static 1]);
+extern bool pfb_index_sources(pfb_out_buffer_t const mapped[static 1],
+		pfb_index_sources_t sources[static 1]);
+extern bool pfb_write_index(FILE out_file[static 1],
+		pfb_out_buffer_t const in_buffer[static 1]);
+extern bool pfb_write_index_sources(FILE out_file[static 1],
+		pfb_out_buffer_t const in_buffer[static 1],
+		pfb_index_sources_t const sources[static 1]);
@@ -0,0 +1,56 @@
+/**
+ * pfb_log.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <stdbool.h>
+
+/**
+ * The logs of a run. ELOG_STDERR() writes to the error log, -E, or to stderr
+ * without it; LOG_IFARGS() writes to the log, -L, or to stdout. A log file is
+ * opened once and kept open. Its messages are gathered in memory and written
+ * when the buffer fills, once a second, and at exit. Any thread may log.
+ *
+ * While an input is read, a message logged more than PFB_LOG_REPEATS times
+ * for it is counted rather than written; the count is logged once the input
+ * is read. A bad list otherwise logs the same warning for every line.
+ */
+enum pfb_log
+{
+	PFB_LOG_ERR,
+	PFB_LOG_STD,
+	PFB_LOG_COUNT,
+};
+
+#define PFB_LOG_REPEATS 10
+
+extern void pfb_log_open(enum pfb_log log, char const *fname);
+extern bool pfb_log_has_file(enum pfb_log log);
+extern void pfb_log_printf(enum pfb_log log, char const *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+extern void pfb_log_input(char const *name);
+extern void pfb_log_flush();
+extern void pfb_log_close();
+
+// a library session routes the diagnostics of its calls to its own sink; see
+// pfb_session.h
+struct pfb_log_sink;
+extern struct pfb_log_sink const *swap_threadLogSink(
+		struct pfb_log_sink const *sink);
+extern struct pfb_log_sink const *get_threadLogSink();
@@ -0,0 +1,31 @@
+/**
+ * pfb_lookup.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include "pfb_context.h"
+#include "domain.h"
+
+extern bool pfb_query_DomainView(DomainView_t dv[static 1], const char *name,
+		size_len_t len);
+
+extern bool pfb_lookup_BUFFER(pfb_out_buffer_t const sorted[static 1],
+		DomainView_t const query[static 1], DomainView_t scratch[static 1],
+		size_len_t found[static 1]);
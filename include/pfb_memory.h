@@ -0,0 +1,45 @@
+/**
+ * pfb_memory.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include <stddef.h>
+
+/**
+ * Accounts the memory held by the structures growing with the input: the
+ * DomainTree nodes and their DomainInfo, the out buffers with their
+ * litelines, and the chunks and prefilter of -e and -z. With a budget set, a reservation beyond
+ * it is refused so the caller falls back to a strategy using less memory,
+ * and a charge beyond it ends the run rather than the host running out of
+ * memory. Without a budget, the use is only counted. The resident server
+ * makes the budget soft: a charge beyond it is noted, and the request that
+ * made it is refused.
+ */
+extern void pfb_mem_set_budget(size_t bytes);
+extern size_t pfb_mem_budget();
+extern bool pfb_mem_fits(size_t bytes);
+extern bool pfb_mem_reserve(size_t bytes);
+extern void pfb_mem_set_soft(bool soft);
+extern bool pfb_mem_overrun();
+extern void pfb_mem_charge(size_t bytes);
+extern void pfb_mem_release(size_t bytes);
+extern size_t pfb_mem_used();
+extern size_t pfb_mem_peak();
+extern size_t pfb_mem_allocs();
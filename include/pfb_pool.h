@@ -0,0 +1,55 @@
+/**
+ * pfb_pool.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+/**
+ * The threads of a run, -j. Work is spawned as tasks into a group and waited
+ * for; a thread waiting on a group runs tasks meanwhile, so tasks may spawn
+ * and wait on tasks of their own. Every thread has its own deque of tasks: it
+ * pushes and pops its end, and a thread without work steals from the other
+ * end of another's. Threads outside the pool share one deque. Without a pool,
+ * or with -j 1, a task runs as it is spawned.
+ *
+ * A task runs with the log sink of the thread which spawned it, and its stats
+ * counters are added to the totals when it returns.
+ */
+// the most threads -j starts for each core.
+#define PFB_POOL_THREADS_PER_CORE 4
+
+typedef struct pfb_task_group
+{
+	atomic_size_t pending;
+} pfb_task_group_t;
+
+extern void pfb_pool_start(uint threads);
+extern void pfb_pool_stop();
+extern uint pfb_pool_threads();
+extern bool pfb_pool_in_parallel();
+
+extern void pfb_init_task_group(pfb_task_group_t group[static 1]);
+extern void pfb_pool_spawn(pfb_task_group_t group[static 1],
+		void (*fn)(void *arg), void *arg);
+extern void pfb_pool_wait(pfb_task_group_t group[static 1]);
+extern void pfb_pool_for(void (*fn)(void *arg), void *args, size_t size,
+		size_t count);
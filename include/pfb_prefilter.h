@@ -0,0 +1,48 @@
+/**
+ * pfb_prefilter.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A set of 64-bit fingerprints of the lines read, of a size fixed up front
+ * with -z, which drops a line byte-identical to one read before it without
+ * parsing it. Merged lists repeat most of their lines verbatim; the first
+ * occurrence is inserted as usual and keeps its line_info_t. Open addressing
+ * with linear probing; once three quarters full, new lines are only looked up.
+ * Two distinct lines sharing a fingerprint drop the second; at 64 bits this is
+ * not expected for any number of lines a list holds.
+ */
+typedef struct pfb_prefilter
+{
+	// 0 marks an empty slot.
+	uint64_t *slots;
+	size_t mask;
+	size_t used;
+	size_t limit;
+} pfb_prefilter_t;
+
+extern void pfb_prefilter_set_size(size_t bytes);
+extern bool pfb_init_prefilter(pfb_prefilter_t pf[static 1]);
+extern bool pfb_prefilter_seen(pfb_prefilter_t pf[static 1],
+		char const *line, size_t len);
+extern void pfb_free_prefilter(pfb_prefilter_t pf[static 1]);
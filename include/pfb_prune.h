@@ -24,9 +24,14 @@
 #include "tld_context.h"
 
 struct DomainTree;
+struct pfb_allow;
 
 extern char* pfb_strdup(const char *in);
+extern char* outputfilename(const char *input, const char *ext);
 extern void pfb_consolidate(TLD_implementation_t, struct pfb_out_context[static 1]);
-extern void pfb_read_all(TLD_implementation_t tld_impl, pfb_contexts_t cs[static 1]);
+extern void pfb_read_all(TLD_implementation_t tld_impl, struct pfb_allow *allow,
+		pfb_contexts_t cs[static 1]);
 extern void realloc_litelines(LiteLineData_t litelines[static 1]);
 extern void pfb_write_carry_over(pfb_context_collect_t pcc[static 1]);
+extern void sort_adbplus_adlists(TLD_implementation_t tld_impl,
+		pfb_context_collect_t in_pcc[static 1], bool include_carry_over);
@@ -0,0 +1,28 @@
+/**
+ * pfb_query.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include "pfb_context.h"
+#include "paths_list.h"
+
+extern bool pfb_query_adlists(const char query_fname[static 1],
+		paths_list_t in_paths_list, const char *out_fname,
+		bool (*load_set)(paths_list_t, pfb_out_buffer_t[static 1]));
@@ -0,0 +1,87 @@
+/**
+ * pfb_session.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * The embedding interface of libadbplusdedup. A session holds named lists,
+ * each de-duplicated and sorted when ingested, and answers dedup, diff, and
+ * lookup calls from memory. Sessions share no state: any number of them may
+ * be driven from different threads at once. A single session is not to be
+ * used by two threads at the same time.
+ *
+ * Calls returning bool return false on bad input, e.g., an unknown list name;
+ * the reason is written to the session's log sink.
+ */
+typedef struct pfb_session pfb_session_t;
+
+/**
+ * Allocates the session and every result handed to the caller. nullptr
+ * members fall back to malloc() and free().
+ */
+typedef struct pfb_session_allocator
+{
+	void *(*alloc)(size_t size, void *context);
+	void (*free)(void *ptr, void *context);
+	void *context;
+} pfb_session_allocator_t;
+
+/**
+ * Receives every diagnostic of the calls on a session, one message at a time.
+ * A nullptr 'write' falls back to stderr.
+ */
+typedef struct pfb_log_sink
+{
+	void (*write)(const char *message, void *context);
+	void *context;
+} pfb_log_sink_t;
+
+typedef struct pfb_session_config
+{
+	pfb_session_allocator_t allocator;
+	pfb_log_sink_t log;
+} pfb_session_config_t;
+
+/**
+ * Bytes allocated by the session's allocator; freed by pfb_free_result().
+ */
+typedef struct pfb_result
+{
+	char *data;
+	size_t len;
+} pfb_result_t;
+
+extern pfb_session_t *pfb_create_session(pfb_session_config_t const *config);
+extern void pfb_free_session(pfb_session_t *session);
+
+extern bool pfb_session_ingest(pfb_session_t *session, const char *name,
+		const char *data, size_t len);
+extern bool pfb_session_remove(pfb_session_t *session, const char *name);
+
+extern bool pfb_session_dedup(pfb_session_t *session, const char *name,
+		pfb_result_t result[static 1]);
+extern bool pfb_session_diff(pfb_session_t *session, const char *name_A,
+		const char *name_B, pfb_result_t result[static 1]);
+extern bool pfb_session_lookup(pfb_session_t *session, const char *name,
+		const char *domain, size_t len, pfb_result_t result[static 1]);
+
+extern void pfb_free_result(pfb_session_t *session, pfb_result_t result[static 1]);
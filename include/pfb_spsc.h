@@ -0,0 +1,49 @@
+/**
+ * pfb_spsc.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+/**
+ * A bounded ring of pointers passed from one producer thread to one consumer
+ * thread without locks. Only the producer advances the tail and only the
+ * consumer the head; each publishes its side with a release store which the
+ * other reads with an acquire load. The two live on separate cache lines so
+ * the threads do not contend for one.
+ */
+typedef struct pfb_spsc
+{
+	void **slots;
+	size_t mask;
+	// next slot to take; advanced by the consumer.
+	alignas(64) atomic_size_t head;
+	// next slot to fill; advanced by the producer.
+	alignas(64) atomic_size_t tail;
+} pfb_spsc_t;
+
+extern void pfb_init_spsc(pfb_spsc_t q[static 1], size_t capacity);
+extern void pfb_free_spsc(pfb_spsc_t q[static 1]);
+extern bool pfb_spsc_push(pfb_spsc_t q[static 1], void *item);
+extern void *pfb_spsc_pop(pfb_spsc_t q[static 1]);
+extern void pfb_spsc_put(pfb_spsc_t q[static 1], void *item);
+extern void *pfb_spsc_take(pfb_spsc_t q[static 1]);
@@ -0,0 +1,98 @@
+/**
+ * pfb_stats.h
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "dedupdomains.h"
+#include "matchstrength.h"
+#include <stddef.h>
+#include <time.h>
+
+/**
+ * Counters of a run, kept in every build. The hot paths count into counters
+ * of their own thread which are added to the totals every so many lines and
+ * at the end of each phase, so counting costs next to nothing. With -J the
+ * totals are written as one JSON object per line to a file when SIGUSR1 is
+ * received and once more at exit.
+ */
+enum pfb_stats_counter
+{
+	PFB_STATS_LINES_READ,
+	PFB_STATS_BYTES_READ,
+	// lines read by their MatchStrength_t.
+	PFB_STATS_LINES_FULL,
+	PFB_STATS_LINES_WEAK,
+	PFB_STATS_LINES_COMMENT,
+	PFB_STATS_LINES_HEADER,
+	PFB_STATS_LINES_EXCEPTION,
+	// neither a rule nor a comment, e.g., a regex or cosmetic filter.
+	PFB_STATS_LINES_BOGUS,
+	// lines dropped unparsed by -z as repeats of a line read before.
+	PFB_STATS_LINES_PREFILTERED,
+	// entries dropped for a domain which is not valid.
+	PFB_STATS_REJECTED,
+	PFB_STATS_NODES_CREATED,
+	PFB_STATS_NODES_FREED,
+	// subtrees freed when a MATCH_FULL entry covers them.
+	PFB_STATS_SUBTREES_PRUNED,
+	// entries replaced by a stronger entry for the same domain.
+	PFB_STATS_UPGRADES,
+	// expansions of the hash tables of the tree and of the TLDs.
+	PFB_STATS_HASH_RESIZES,
+	PFB_STATS_CARRY_OVER_LINES,
+	// entries written to the outputs asked for, de-duplicated, diffed, or
+	// merged; not to the temporary lists of a diff.
+	PFB_STATS_OUTPUT_LINES,
+	PFB_STATS_COUNTERS,
+};
+
+enum pfb_stats_phase
+{
+	// parse the inputs and insert them into the tree.
+	PFB_PHASE_READ,
+	// flatten the tree and write it.
+	PFB_PHASE_CONSOLIDATE,
+	// two-way diff of sorted lists.
+	PFB_PHASE_DIFF,
+	// k-way merge of sorted lists: overlap, three-way, union of runs.
+	PFB_PHASE_MERGE,
+	PFB_PHASE_COUNT,
+};
+
+typedef struct pfb_phase_clock
+{
+	enum pfb_stats_phase phase;
+	struct timespec wall;
+	struct timespec cpu;
+} pfb_phase_clock_t;
+
+extern void pfb_stats_count(enum pfb_stats_counter counter, size_t n);
+extern void pfb_stats_line(MatchStrength_t ms, size_t bytes);
+extern void pfb_stats_line_prefiltered(size_t bytes);
+extern void pfb_stats_flush();
+
+extern pfb_phase_clock_t pfb_stats_begin(enum pfb_stats_phase phase);
+extern void pfb_stats_end(pfb_phase_clock_t const clock[static 1]);
+
+extern void pfb_stats_input(char const *name, size_t lines, size_t bytes,
+		size_t entries, size_t kept);
+
+extern bool pfb_stats_open(char const *fname);
+extern void pfb_stats_poll();
+extern void pfb_stats_close();
@@ -25,8 +25,9 @@ struct ContextPair;
 
 typedef struct PortLineData
 {
-	// null terminated string
-	char const *data;
+	// null terminated copy of the line; the callback may modify it in place,
+	// e.g., to lowercase the domain.
+	char *data;
 	// length of the null terminated string to avoid strlen(x) calculations
 	line_info_t li;
 } PortLineData_t;
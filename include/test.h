@@ -31,4 +31,6 @@ extern void test_pfb_prune();
 extern void test_rw_pfb_csv();
 extern void test_input_args();
 extern void test_carry_over();
+extern void test_pfb_session();
+extern void test_pfb_spsc();
 #endif
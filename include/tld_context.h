@@ -34,6 +34,9 @@ typedef void* TLD_EntryIter_t;
 typedef struct DomainTree** (*tld_impl_context_sdv_cb)(TLD_context_t,
 		struct SubdomainView);
 
+typedef void (*tld_impl_context_sdv_release_cb)(TLD_context_t,
+		struct SubdomainView);
+
 typedef void (*tld_impl_context_cb)(TLD_context_t);
 typedef struct DomainTree** (*tld_impl_entryitr_entry_cb)(TLD_EntryIter_t);
 
@@ -46,6 +49,13 @@ typedef void (*tld_entryiter_cb)(TLD_EntryIter_t[static 1]);
 typedef struct TLD_func_table
 {
 	tld_impl_context_sdv_cb insert_dt_entry_for_tld;
+	// called once insert_DomainTree() is done with the DomainTree** returned by
+	// insert_dt_entry_for_tld. nullptr for an implementation written by one
+	// thread only; otherwise several threads may insert at once and an entry
+	// read from two lines of equal strength is that of the earlier line.
+	tld_impl_context_sdv_release_cb release_dt_entry_for_tld;
+	// same as insert_dt_entry_for_tld but returns nullptr for a TLD not held.
+	tld_impl_context_sdv_cb find_dt_entry_for_tld;
 	tld_impl_context_cb sort_domain_entries;
 	tld_impl_context_entryiter_dt_cb create_entry_iter;
 	tld_impl_entryitr_entry_cb next_used_tld_entry;
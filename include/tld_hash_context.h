@@ -8,6 +8,7 @@ extern TLD_implementation_t create_tld_hash_impl();
 
 extern void hash_context_sort_entries(TLD_context_t);
 extern struct DomainTree** hash_context_insert_tld(TLD_context_t, struct SubdomainView);
+extern struct DomainTree** hash_context_find_tld(TLD_context_t, struct SubdomainView);
 extern struct DomainTree** hash_context_next_tld_entry(TLD_EntryIter_t);
 extern void hash_context_free_context(TLD_context_t c[static 1]);
 
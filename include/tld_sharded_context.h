@@ -0,0 +1,18 @@
+#pragma once
+#include "tld_context.h"
+
+static constexpr const TLD_type sharded_impl_type = 0x01;
+static const char *const sharded_impl_desc = "Using UTHash shards for the TLD, each with a lock, to insert from several threads.";
+
+extern TLD_implementation_t create_tld_sharded_impl();
+
+extern void sharded_context_sort_entries(TLD_context_t);
+extern struct DomainTree** sharded_context_insert_tld(TLD_context_t, struct SubdomainView);
+extern void sharded_context_release_tld(TLD_context_t, struct SubdomainView);
+extern struct DomainTree** sharded_context_find_tld(TLD_context_t, struct SubdomainView);
+extern struct DomainTree** sharded_context_next_tld_entry(TLD_EntryIter_t);
+extern void sharded_context_free_context(TLD_context_t c[static 1]);
+
+extern void sharded_context_create_entry_iter(TLD_context_t c,
+		TLD_EntryIter_t iter[static 1], struct DomainTree **dt[static 1]);
+extern void sharded_context_free_entry_iter(TLD_EntryIter_t iter[static 1]);
@@ -20,6 +20,209 @@
  */
 #include "dedupdomains.h"
 #include "adbplusline.h"
+#include <string.h>
+
+static bool is_blank(const char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static bool is_digit(const char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static bool is_alnum(const char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c);
+}
+
+static bool is_label_char(const char c)
+{
+	return is_alnum(c) || c == '-' || c == '_';
+}
+
+/**
+ * The characters of an IPv4 or IPv6 address; hosts files lead each line with
+ * one.
+ */
+static bool is_address_char(const char c)
+{
+	return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') ||
+		c == '.' || c == ':';
+}
+
+/**
+ * A comment is set apart from a name by a blank; 'example.com##.ad' is element
+ * hiding in adbplus syntax and not a domain.
+ */
+static bool end_of_name(const char c)
+{
+	return c == LINE_TERMINAL || is_blank(c);
+}
+
+static bool valid_label(const char *begin, const char *end)
+{
+	return end > begin && end - begin <= 63 && is_alnum(*begin) &&
+		is_alnum(end[-1]);
+}
+
+/**
+ * Scan the domain name starting at 'c' up to a blank or the end of the line in
+ * one pass. Returns one past the end of the name or nullptr if it is not a
+ * domain: at least two labels of letters, digits, '-' and '_' where each label
+ * starts and ends with a letter or digit and the last label is not a number,
+ * i.e., an IPv4 address is not a domain.
+ */
+static const char *scan_domain(const char *c)
+{
+	const char *label = c;
+	bool dotted = false;
+	bool numeric = true;
+
+	for(;; c++)
+	{
+		if(is_label_char(*c))
+		{
+			numeric = numeric && is_digit(*c);
+		}
+		else if(*c == '.')
+		{
+			if(!valid_label(label, c))
+			{
+				return nullptr;
+			}
+			dotted = true;
+			numeric = true;
+			label = c + 1;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if(!dotted || numeric || !valid_label(label, c) || !end_of_name(*c))
+	{
+		return nullptr;
+	}
+	return c;
+}
+
+/**
+ * The loopback names hosts files carry alongside the blocked domains.
+ */
+static bool loopback_name(const char *name, size_t len)
+{
+	static const char localdomain[] = "localhost.localdomain";
+	return len == sizeof(localdomain) - 1 && !memcmp(name, localdomain, len);
+}
+
+/**
+ * Find the next host name of a hosts line starting at 'c'. Names which are not
+ * domains are skipped. Sets 'lv' to the name and returns true; false once the
+ * end of the line or a comment is reached.
+ */
+static bool scan_hosts_names(AdbplusView_t lv[static 1], const char *c)
+{
+	while(true)
+	{
+		while(is_blank(*c))
+		{
+			c++;
+		}
+		if(*c == LINE_TERMINAL || *c == '#')
+		{
+			lv->next = nullptr;
+			return false;
+		}
+
+		const char *end = scan_domain(c);
+		if(end && !loopback_name(c, end - c))
+		{
+			lv->ms = MATCH_WEAK;
+			lv->data = c;
+			lv->len = end - c;
+			lv->next = end;
+			return true;
+		}
+
+		while(!end_of_name(*c))
+		{
+			c++;
+		}
+	}
+}
+
+/**
+ * Parse a line which is not in adbplus syntax: a '#' comment, a hosts line,
+ * i.e., an address followed by one or more host names, or a raw domain.
+ * Leading blanks and a trailing comment are allowed. Host names and raw
+ * domains block the exact domain only and are MATCH_WEAK.
+ */
+static bool parse_plain_line(AdbplusView_t lv[static 1], const char *c)
+{
+	while(is_blank(*c))
+	{
+		c++;
+	}
+
+	if(*c == '#')
+	{
+		lv->ms = MATCH_COMMENT;
+		return true;
+	}
+
+	// hosts lines lead with an address; a raw domain made only of hex digits,
+	// e.g., 'cafe.de', is an address only if a blank and names follow it.
+	const char *a = c;
+	bool colon = false;
+	bool dotted_quad = true;
+	for(; is_address_char(*a); a++)
+	{
+		colon = colon || *a == ':';
+		dotted_quad = dotted_quad && (is_digit(*a) || *a == '.');
+	}
+	if(a > c && is_blank(*a) && (colon || dotted_quad))
+	{
+		if(scan_hosts_names(lv, a))
+		{
+			return true;
+		}
+		lv->ms = MATCH_BOGUS;
+		return false;
+	}
+
+	const char *end = scan_domain(c);
+	if(end)
+	{
+		const char *rest = end;
+		while(is_blank(*rest))
+		{
+			rest++;
+		}
+		if(*rest == LINE_TERMINAL || *rest == '#')
+		{
+			lv->ms = MATCH_WEAK;
+			lv->data = c;
+			lv->len = end - c;
+			return true;
+		}
+	}
+
+	lv->ms = MATCH_BOGUS;
+	return false;
+}
+
+/**
+ * Move 'lv' to the next host name of the hosts line it was parsed from.
+ * Returns false if the line holds no more names.
+ */
+bool next_hosts_domain(AdbplusView_t lv[static 1])
+{
+	ASSERT(lv);
+	return lv->next && scan_hosts_names(lv, lv->next);
+}
 
 /**
  * Initial implementation will take short cut: if any line is bogus then the
@@ -41,7 +244,7 @@ bool parse_adbplus_line(AdbplusView_t lv[static 1], const char input_line[static
 	ASSERT(input_line);
 
 	// this function has a lot of work to validate format.
-	// if adbplus syntax, then ! are comments. # are trash.
+	// if adbplus syntax, then ! are comments. # are hosts file comments.
 	// [ is valid for the header first line
 	// ! comments after the initial block are also as good as trash since we're
 	// sorting.
@@ -49,6 +252,7 @@ bool parse_adbplus_line(AdbplusView_t lv[static 1], const char input_line[static
 	const char *c = input_line;
 	const char *prev = input_line;
 	lv->ms = MATCH_BOGUS;
+	lv->next = nullptr;
 
 	switch(*c)
 	{
@@ -67,22 +271,17 @@ bool parse_adbplus_line(AdbplusView_t lv[static 1], const char input_line[static
 				lv->ms = MATCH_POSSIBLE;
 			}
 			break;
-		// TODO support # comments
-		//case '#':
-			//lv->ms = MATCH_COMMENT;
-			//break;
-		default:
-#if 0
-			if((*c >= 'a' && *c <= 'z') || (*c >= '0' && *c <= '9'))
+		case '@':
+			// an exception rule: '@@||domain^'
+			if(c[1] == '@' && c[2] == '|' && c[3] == '|')
 			{
-				printf("it is within %c\n", *c);
-			// assume is a raw domain
-			prev = c;
-			lv->ms = MATCH_WEAK;
+				c += 4;
+				prev = c;
+				lv->ms = MATCH_EXCEPTION;
 			}
-#endif
-			lv->ms = MATCH_BOGUS;
-			return false;
+			break;
+		default:
+			return parse_plain_line(lv, c);
 	}
 
 	// zip to the end of the string
@@ -102,12 +301,15 @@ bool parse_adbplus_line(AdbplusView_t lv[static 1], const char input_line[static
 		return true;
 	}
 
-	if(lv->ms == MATCH_POSSIBLE && peak == '^')
+	if((lv->ms == MATCH_POSSIBLE || lv->ms == MATCH_EXCEPTION) && peak == '^')
 	{
 		lv->data = prev;
 		ASSERT(c - prev > 0);
 		lv->len = c - prev - 1;
-		lv->ms = MATCH_FULL;
+		if(lv->ms == MATCH_POSSIBLE)
+		{
+			lv->ms = MATCH_FULL;
+		}
 		return true;
 	}
 
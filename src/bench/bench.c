@@ -0,0 +1,315 @@
+/**
+ * bench.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// clock_gettime(), getopt() and getrusage() are POSIX; -std=c23 declares only
+// ISO C otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "dedupdomains.h"
+#include "adbplusline.h"
+#include "pfb_context.h"
+#include "pfb_differ.h"
+#include "pfb_memory.h"
+#include "pfb_prune.h"
+#include "rw_pfb_csv.h"
+#include "tld_hash_context.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+/**
+ * Phase-level benchmarks of the de-duplication and the diff. Each input, a
+ * file or a synthetic list of a given number of lines, is benchmarked in four
+ * phases timed on their own:
+ *
+ * ingest		read and tokenize every line; nothing is kept.
+ * read_insert	pfb_read_all() into a tree. The reading overlaps the insertion
+ *				when it is pipelined, so the two are timed as one; ingest
+ *				bounds the share of the reading.
+ * consolidate	pfb_consolidate() of the tree into an in-memory list.
+ * diff			diff_adbplus_adlists_BUFFER() of the list of the input
+ *				benchmarked before it against this one; skipped for the first.
+ *
+ * One JSON object is written per phase per line to stdout with the lines and
+ * bytes processed, the throughput, the allocations the phase counted and the
+ * bytes of the growing structures held (see pfb_memory.h), and the peak
+ * resident set of the process.
+ */
+
+typedef struct bench_input
+{
+	const char *name;
+	pfb_context_t context;
+	size_t lines;
+} bench_input_t;
+
+typedef struct bench_run
+{
+	// the de-duplicated list of the input benchmarked last.
+	pfb_out_buffer_t sorted;
+	bool have_sorted;
+	uint seed;
+} bench_run_t;
+
+static double seconds_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * 'begin' and 'allocs' are seconds_now() and pfb_mem_allocs() at the start of
+ * the phase.
+ */
+static void report(const char *input, const char *phase, double begin,
+		size_t allocs, size_t lines, size_t bytes)
+{
+	const double seconds = seconds_now() - begin;
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	// a phase too short for the clock has no meaningful throughput.
+	const double rate = seconds > 0 ? 1 / seconds : 0;
+	printf("{\"input\":\"%s\",\"phase\":\"%s\",\"lines\":%zu,\"bytes\":%zu,"
+			"\"seconds\":%.6f,\"lines_per_s\":%.0f,\"mb_per_s\":%.2f,"
+			"\"allocs\":%zu,\"mem_used\":%zu,\"mem_peak\":%zu,"
+			"\"rss_peak_kb\":%ld}\n",
+			input, phase, lines, bytes, seconds, lines * rate,
+			bytes * rate / (1024 * 1024), pfb_mem_allocs() - allocs,
+			pfb_mem_used(), pfb_mem_peak(), usage.ru_maxrss);
+	fflush(stdout);
+}
+
+static uint64_t next_random(uint64_t state[static 1])
+{
+	// xorshift64
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+/**
+ * Write a synthetic list of 'lines' lines: a header, a comment in fifty lines,
+ * and otherwise domains of up to three labels below a registered domain, one
+ * in ten a raw domain. The registered domains are drawn from a quarter as
+ * many as there are lines so duplicates and children of blocked parents are
+ * common. Lists of nearby seeds overlap by most of their entries.
+ */
+static FILE *synthetic_list(size_t lines, uint seed)
+{
+	static const char *const tlds[] = {
+		"com", "net", "org", "io", "de", "co.uk", "cn", "ru", "info", "xyz",
+	};
+	const size_t registered = MAX(lines / 4, (size_t)1);
+
+	FILE *out = tmpfile();
+	if(!out)
+	{
+		ELOG_STDERR("ERROR: failed to create a temporary file\n");
+		exit(EXIT_FAILURE);
+	}
+
+	uint64_t state = 0x9e3779b97f4a7c15ull ^ lines;
+	uint64_t variant = 0x2545f4914f6cdd1dull + seed;
+	fputs("[Adblock Plus 2.0]\n", out);
+	for(size_t i = 1; i < lines; i++)
+	{
+		uint64_t r = next_random(&state);
+		// one line in eight differs between seeds.
+		if((r & 7) == 0)
+		{
+			r = next_random(&variant);
+		}
+
+		if(r % 50 == 0)
+		{
+			fprintf(out, "! comment %zu\n", i);
+			continue;
+		}
+
+		const bool raw = (r >> 8) % 10 == 0;
+		fputs(raw ? "" : "||", out);
+		for(uint depth = (r >> 16) % 4; depth > 0; depth--)
+		{
+			fprintf(out, "s%u.", (uint)((r >> (20 + 4 * depth)) % 16));
+		}
+		fprintf(out, "d%zu.%s%s\n", (size_t)((r >> 40) % registered),
+				tlds[(r >> 32) % (sizeof(tlds) / sizeof(tlds[0]))],
+				raw ? "" : "^");
+	}
+
+	if(fflush(out) != 0 || ferror(out))
+	{
+		ELOG_STDERR("ERROR: failed to write a synthetic list\n");
+		exit(EXIT_FAILURE);
+	}
+	return out;
+}
+
+static void count_line(PortLineData_t const *const pld, pfb_context_t*,
+		void *data)
+{
+	size_t *lines = data;
+	AdbplusView_t lv;
+	parse_adbplus_line(&lv, pld->data);
+	(*lines)++;
+}
+
+static void bench_input(bench_run_t run[static 1], bench_input_t in[static 1])
+{
+	const size_t bytes = in->context.file_size;
+	pfb_contexts_t contexts = {&in->context, &in->context + 1};
+
+	size_t allocs = pfb_mem_allocs();
+	double begin = seconds_now();
+	pfb_read_one_context(&in->context, count_line, &in->lines);
+	report(in->name, "ingest", begin, allocs, in->lines, bytes);
+
+	fseek(in->context.in_file, 0L, SEEK_SET);
+	TLD_implementation_t tld_impl = create_tld_hash_impl();
+	ASSERT(tld_impl.context);
+	allocs = pfb_mem_allocs();
+	begin = seconds_now();
+	pfb_read_all(tld_impl, nullptr, &contexts);
+	report(in->name, "read_insert", begin, allocs, in->lines, bytes);
+
+	pfb_out_buffer_t sorted = {
+		.buffer = malloc(4096),
+		.alloc_len = 4096,
+	};
+	CHECK_MALLOC(sorted.buffer);
+	pfb_out_context_t out_context = pfb_init_out_context_BUFFER(&sorted);
+	allocs = pfb_mem_allocs();
+	begin = seconds_now();
+	pfb_consolidate(tld_impl, &out_context);
+	report(in->name, "consolidate", begin, allocs, out_context.counter,
+			sorted.next_idx);
+	free_tld_impl(&tld_impl);
+
+	if(run->have_sorted)
+	{
+		pfb_out_context_t out_diff = pfb_init_out_context("/dev/null");
+		pfb_open_out_context(&out_diff, false);
+		allocs = pfb_mem_allocs();
+		begin = seconds_now();
+		diff_adbplus_adlists_BUFFER(&run->sorted, &sorted, &out_diff,
+				DIFF_REPORT);
+		report(in->name, "diff", begin, allocs,
+				run->sorted.litelines.used + sorted.litelines.used,
+				run->sorted.next_idx + sorted.next_idx);
+		pfb_free_out_context(&out_diff);
+		pfb_free_out_buffer(&run->sorted);
+	}
+
+	run->sorted = sorted;
+	run->have_sorted = true;
+	free(in->context.mem_buffer);
+	in->context.mem_buffer = nullptr;
+}
+
+static void usage(const char *name)
+{
+	ELOG_STDERR("usage: %s [-s seed] [-n lines]... [file]...\n"
+			"Benchmark the phases of the de-duplication and diff of each file\n"
+			"and of a synthetic list of each number of lines given with -n.\n",
+			name);
+}
+
+int main(int argc, char *const argv[])
+{
+	bench_run_t run = {};
+	size_t *synthetic = nullptr;
+	uint synthetic_used = 0;
+
+	int opt;
+	while((opt = getopt(argc, argv, "n:s:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n':
+				CHECK_REALLOC(synthetic, sizeof(size_t) * (synthetic_used + 1));
+				synthetic[synthetic_used] = strtoull(optarg, nullptr, 10);
+				if(synthetic[synthetic_used] == 0)
+				{
+					usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				synthetic_used++;
+				break;
+			case 's':
+				run.seed = strtoul(optarg, nullptr, 10);
+				break;
+			default:
+				usage(argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	for(int i = optind; i < argc; i++)
+	{
+		FILE *file = fopen(argv[i], "rb");
+		if(!file)
+		{
+			ELOG_STDERR("ERROR: failed to open %s for reading\n", argv[i]);
+			exit(EXIT_FAILURE);
+		}
+		bench_input_t in = {
+			.name = argv[i],
+			.context = pfb_context_from_FILE(file),
+		};
+		bench_input(&run, &in);
+		fclose(file);
+	}
+
+	for(uint i = 0; i < synthetic_used; i++)
+	{
+		// each size is diffed against a list of a nearby seed of its own size.
+		for(uint s = 0; s < 2; s++)
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "synthetic-%zu%s", synthetic[i],
+					s ? "-b" : "");
+			FILE *file = synthetic_list(synthetic[i], run.seed + s);
+			bench_input_t in = {
+				.name = name,
+				.context = pfb_context_from_FILE(file),
+			};
+			if(s == 0 && run.have_sorted)
+			{
+				pfb_free_out_buffer(&run.sorted);
+				run.have_sorted = false;
+			}
+			bench_input(&run, &in);
+			fclose(file);
+		}
+	}
+
+	if(run.have_sorted)
+	{
+		pfb_free_out_buffer(&run.sorted);
+	}
+	free(synthetic);
+	return 0;
+}
@@ -25,6 +25,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 static const uint MAX_DOMAIN_LABEL = 63;
 static const uint DOMAIN_INIT_ALLOC = 4;
@@ -260,6 +263,129 @@ bool update_DomainView(DomainView_t dv[static 1], char const *fqd, size_len_t le
 	return true;
 }
 
+/**
+ * Walk the dots of one block of 'len' bytes given as a bitmask, lowest byte
+ * first, and carry the length of the label running into the next block in
+ * 'label'. Returns false on an empty or over-long label.
+ */
+static bool check_labels(uint dots, uint len, uint label[static 1])
+{
+	uint start = 0;
+	while(dots)
+	{
+		const uint dot = __builtin_ctz(dots);
+		const uint label_len = *label + dot - start;
+		if(label_len == 0 || label_len > MAX_DOMAIN_LABEL)
+		{
+			return false;
+		}
+		*label = 0;
+		start = dot + 1;
+		dots &= dots - 1;
+	}
+	*label += len - start;
+	return true;
+}
+
+#ifdef __SSE2__
+static __m128i in_range(__m128i v, char lo, char hi)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+			_mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+
+/**
+ * Lowercase the 16 bytes at 'p' in place. Returns the bitmasks of the bytes
+ * which were upper case, are not in [a-z0-9-._] and are dots.
+ */
+static void normalize_block(char p[static 16], uint upper_bits[static 1],
+		uint invalid_bits[static 1], uint dot_bits[static 1])
+{
+	__m128i v = _mm_loadu_si128((__m128i const*)p);
+
+	// bytes of 0x80 and up are negative and never in a range.
+	const __m128i upper = in_range(v, 'A', 'Z');
+	v = _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+	_mm_storeu_si128((__m128i*)p, v);
+
+	const __m128i dot = _mm_cmpeq_epi8(v, _mm_set1_epi8('.'));
+	const __m128i valid = _mm_or_si128(
+			_mm_or_si128(in_range(v, 'a', 'z'), in_range(v, '0', '9')),
+			_mm_or_si128(_mm_or_si128(dot, _mm_cmpeq_epi8(v, _mm_set1_epi8('-'))),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('_'))));
+
+	*upper_bits = _mm_movemask_epi8(upper);
+	*invalid_bits = ~_mm_movemask_epi8(valid) & 0xffff;
+	*dot_bits = _mm_movemask_epi8(dot);
+}
+#else
+static void normalize_block(char p[static 16], uint upper_bits[static 1],
+		uint invalid_bits[static 1], uint dot_bits[static 1])
+{
+	*upper_bits = *invalid_bits = *dot_bits = 0;
+	for(uint i = 0; i < 16; i++)
+	{
+		const char c = p[i];
+		if(c >= 'A' && c <= 'Z')
+		{
+			p[i] = c | 0x20;
+			*upper_bits |= 1u << i;
+		}
+		else if(c == '.')
+		{
+			*dot_bits |= 1u << i;
+		}
+		else if(!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+					c == '-' || c == '_'))
+		{
+			*invalid_bits |= 1u << i;
+		}
+	}
+}
+#endif
+
+/**
+ * Lowercase the domain of 'len' bytes at 'fqd' in place and validate it in
+ * the same pass, 16 bytes at a time: every byte in [a-z0-9-._] and no label
+ * empty or longer than MAX_DOMAIN_LABEL. 'folded' is set if any byte was
+ * upper case. Returns false if the domain is not valid; it is folded either
+ * way.
+ */
+bool normalize_domain(char *fqd, size_len_t len, bool folded[static 1])
+{
+	ASSERT(fqd);
+
+	uint label = 0;
+	uint upper = 0, invalid = 0, dots = 0;
+	bool valid = len > 0;
+	*folded = false;
+
+	size_len_t i = 0;
+	for(; i + 16 <= len; i += 16)
+	{
+		normalize_block(fqd + i, &upper, &invalid, &dots);
+		*folded = *folded || upper;
+		valid = valid && !invalid && check_labels(dots, 16, &label);
+	}
+
+	if(i < len)
+	{
+		// the tail is padded with valid bytes that are no dots.
+		char tail[16];
+		memset(tail, 'a', sizeof(tail));
+		memcpy(tail, fqd + i, len - i);
+		normalize_block(tail, &upper, &invalid, &dots);
+		memcpy(fqd + i, tail, len - i);
+
+		const uint used = (1u << (len - i)) - 1;
+		*folded = *folded || (upper & used);
+		valid = valid && !(invalid & used) &&
+			check_labels(dots & used, len - i, &label);
+	}
+
+	return valid && label > 0 && label <= MAX_DOMAIN_LABEL;
+}
+
 #ifdef BUILD_TESTS
 DomainView_t parse_Domain(char const *fqd, size_len_t len)
 {
@@ -583,6 +709,42 @@ void info_domain()
 	printf("Sizeof SubdomainView_t: %lu\n", sizeof(SubdomainView_t));
 }
 
+static void test_normalize_domain()
+{
+	bool folded;
+	char mixed[] = "Ads.Example.COM";
+	assert(normalize_domain(mixed, strlen(mixed), &folded));
+	assert(folded);
+	assert(!strcmp(mixed, "ads.example.com"));
+
+	char lower[] = "cdn-1.sub_domain.example.com";
+	assert(normalize_domain(lower, strlen(lower), &folded));
+	assert(!folded);
+
+	char spans[] = "A-VERY-LONG-LABEL-THAT-SPANS-BLOCKS.Example.Com";
+	assert(normalize_domain(spans, strlen(spans), &folded));
+	assert(!strcmp(spans, "a-very-long-label-that-spans-blocks.example.com"));
+
+	char path[] = "example.com/ads";
+	assert(!normalize_domain(path, strlen(path), &folded));
+	char wildcard[] = "ads*.example.com";
+	assert(!normalize_domain(wildcard, strlen(wildcard), &folded));
+	char empty_label[] = "ads..example.com";
+	assert(!normalize_domain(empty_label, strlen(empty_label), &folded));
+	char trailing[] = "example.com.";
+	assert(!normalize_domain(trailing, strlen(trailing), &folded));
+	char utf8[] = "b\xc3\xbc" "cher.de";
+	assert(!normalize_domain(utf8, strlen(utf8), &folded));
+
+	char label63[80], label64[80];
+	memset(label63, 'a', 63);
+	memcpy(label63 + 63, ".com", 5);
+	assert(normalize_domain(label63, strlen(label63), &folded));
+	memset(label64, 'a', 64);
+	memcpy(label64 + 64, ".com", 5);
+	assert(!normalize_domain(label64, strlen(label64), &folded));
+}
+
 void test_domain()
 {
 	printf("Testing 'Domain'\n");
@@ -595,6 +757,7 @@ void test_domain()
 	test_nil_DomainView();
 	test_long_label();
 	test_too_long();
+	test_normalize_domain();
 	printf("Tested 'Domain'\n");
 }
 #endif
@@ -22,6 +22,7 @@
 #include "domaininfo.h"
 #include "domain.h"
 #include "tld_context.h"
+#include "pfb_memory.h"
 
 /**
  * Create and initialize a DomainInfo_t. Returned pointer must be freed with
@@ -29,6 +30,7 @@
  */
 static DomainInfo_t* init_DomainInfo(size_len_t/* len*/)
 {
+	pfb_mem_charge(sizeof(DomainInfo_t));
 	DomainInfo_t *di = calloc(1, sizeof(DomainInfo_t));
 	CHECK_MALLOC(di);
 
@@ -37,6 +39,10 @@ static DomainInfo_t* init_DomainInfo(size_len_t/* len*/)
 
 void free_DomainInfo(DomainInfo_t **di)
 {
+	if(*di)
+	{
+		pfb_mem_release(sizeof(DomainInfo_t));
+	}
 	free(*di);
 	*di = nullptr;
 }
@@ -59,6 +65,11 @@ DomainInfo_t *convert_DomainInfo(DomainView_t *dv)
 
 void free_DomainTreePtr(DomainTree_t **dt)
 {
+	if(*dt)
+	{
+		pfb_mem_release(sizeof(DomainTree_t) + sizeof(char) * (*dt)->len);
+		pfb_stats_count(PFB_STATS_NODES_FREED, 1);
+	}
 	free(*dt);
 	*dt = nullptr;
 }
@@ -129,11 +140,10 @@ void transfer_DomainInfo(DomainTree_t **root,
 	DomainTree_t *current = nullptr, *tmp = nullptr;
 	HASH_ITER(hh, *root, current, tmp)
 	{
-		// must visit each child
-		transfer_DomainInfo(&(*root)->child, collector, context);
-
 		HASH_DEL(*root, current);
 
+		// a parent is collected ahead of its children, the order they are
+		// sorted in; only a MATCH_WEAK parent has any.
 		if(current->di)
 		{
 			ASSERT(current->di->match_strength > MATCH_NOTSET);
@@ -144,6 +154,9 @@ void transfer_DomainInfo(DomainTree_t **root,
 			collector(&(current->di), context);
 			ASSERT(!current->di);
 		}
+
+		// must visit each child
+		transfer_DomainInfo(&current->child, collector, context);
 		free_DomainTreePtr(&current);
 	}
 
@@ -188,6 +201,8 @@ static DomainTree_t *init_DomainTree(SubdomainView_t const *sdv)
 	// the DomainTree_t instance must be memset since it is inserted into a
 	// UT_hash. alternate options available such as defining a hash function and
 	// comparison. default requires all padding be zero'ed.
+	pfb_mem_charge(sizeof(DomainTree_t) + sizeof(char) * sdv->len);
+	pfb_stats_count(PFB_STATS_NODES_CREATED, 1);
 	DomainTree_t *ndt = calloc(1, sizeof(DomainTree_t) + sizeof(char) * sdv->len);
 	CHECK_MALLOC(ndt);
 
@@ -263,21 +278,48 @@ static DomainTree_t* ctor_DomainTree(DomainTree_t **dt, DomainViewIter_t it[stat
 	return ndt;
 }
 
+/**
+ * True if 'dv' is of a line read ahead of that of 'di': of an earlier input
+ * or earlier in the same input. The inputs are contexts of one array.
+ */
+static bool earlier_line(DomainInfo_t const di[static 1],
+		DomainView_t const dv[static 1])
+{
+	if(dv->context != di->context)
+	{
+		return (uintptr_t)dv->context < (uintptr_t)di->context;
+	}
+	return dv->li.offset < di->li.offset;
+}
+
+/**
+ * With 'ordered', an entry of equal strength read from an earlier line
+ * replaces the one held, so the entry kept does not depend on the order
+ * several threads inserted in. Read by one thread, the first line inserted is
+ * already the earliest.
+ */
 static void replace_if_stronger(DomainTree_t entry[static 1],
-		DomainView_t dv[static 1])
+		DomainView_t dv[static 1], bool ordered)
 {
 	ASSERT(entry);
 	ASSERT(dv);
 	ASSERT(dv->match_strength > MATCH_NOTSET);
 	ASSERT(dv->match_strength != MATCH_REGEX);
 
-	if(entry->di == nullptr || dv->match_strength > entry->di->match_strength)
+	if(entry->di == nullptr || dv->match_strength > entry->di->match_strength ||
+			(ordered && dv->match_strength == entry->di->match_strength &&
+			earlier_line(entry->di, dv)))
 	{
+		if(entry->di && dv->match_strength > entry->di->match_strength)
+		{
+			pfb_stats_count(PFB_STATS_UPGRADES, 1);
+		}
 		replace_DomainInfo(entry, dv);
 
 		ASSERT(entry->di);
-		if(entry->di->match_strength == MATCH_FULL)
+		if(entry->di->match_strength == MATCH_FULL && entry->child)
 		{
+			pfb_stats_count(PFB_STATS_SUBTREES_PRUNED, 1);
 			free_DomainTree(&entry->child);
 		}
 		//DEBUG_PRINTF("[%s:%d] %s replace existing entry with stronger match; inserted.\n", __FILE__, __LINE__, __FUNCTION__);
@@ -398,9 +440,15 @@ void insert_DomainTree(const TLD_implementation_t tld_impl,
 	DomainTree_t *entry = find_leaf_Domain(dt, it);
 	// above will return nil if the new entry is already blocked by an existing
 	// entry.
+	const tld_impl_context_sdv_release_cb release =
+		tld_impl.impl_funcs->release_dt_entry_for_tld;
 	if(entry)
 	{
-		replace_if_stronger(entry, dv);
+		replace_if_stronger(entry, dv, release != nullptr);
+	}
+	if(release)
+	{
+		release(tld_impl.context, sdv);
 	}
 }
 
@@ -420,7 +468,7 @@ static void do_visit_DomainTree(DomainTree_t **root,
 	HASH_ITER(hh, *root, dt, tmp)
 	{
 		// must visit each child
-		do_visit_DomainTree(&(*root)->child, visitor_func, context);
+		do_visit_DomainTree(&dt->child, visitor_func, context);
 
 		if(dt->di)
 		{
@@ -440,6 +488,207 @@ void visit_DomainTree(DomainTree_t **root,
 	do_visit_DomainTree(root, visitor_func, context);
 }
 
+static void do_visit_sorted_DomainTree(DomainTree_t **root,
+		void(*visitor_func)(DomainInfo_t **di, void *context),
+		void *context)
+{
+	if(*root == nullptr)
+	{
+		return;
+	}
+
+	HASH_SRT(hh, *root, sort_DomainTree_by_tld);
+
+	DomainTree_t *dt, *tmp;
+	HASH_ITER(hh, *root, dt, tmp)
+	{
+		// a parent ahead of its children as in transfer_DomainInfo().
+		if(dt->di)
+		{
+			(*visitor_func)(&(dt->di), context);
+		}
+		do_visit_sorted_DomainTree(&dt->child, visitor_func, context);
+	}
+}
+
+/**
+ * Visit the entries held below the domain of 'dv', i.e., of its subdomains
+ * and not of the domain itself, in the order transfer_DomainInfo() collects
+ * them. Nothing is visited if the tree holds no such entries.
+ */
+void visit_below_DomainTree(const TLD_implementation_t tld_impl,
+		DomainView_t dv[static 1],
+		void(*visitor_func)(DomainInfo_t **di, void *context),
+		void *context)
+{
+	ASSERT(tld_impl.context);
+	ASSERT(tld_impl.impl_funcs);
+	ASSERT(visitor_func);
+
+	DomainViewIter_t it = begin_DomainView(dv);
+	SubdomainView_t sdv;
+	if(!next_DomainView(&it, &sdv))
+	{
+		return;
+	}
+
+	DomainTree_t **dt = tld_impl.impl_funcs->find_dt_entry_for_tld(
+			tld_impl.context, sdv);
+	while(dt && next_DomainView(&it, &sdv))
+	{
+		DomainTree_t *entry = nullptr;
+		HASH_FIND(hh, *dt, sdv.data, sdv.len, entry);
+		dt = entry ? &entry->child : nullptr;
+	}
+
+	if(dt)
+	{
+		do_visit_sorted_DomainTree(dt, visitor_func, context);
+	}
+}
+
+/**
+ * Find the entry of the tree which blocks the domain held by 'dv': the entry
+ * itself, at any match strength, or its nearest MATCH_FULL parent. The labels
+ * are walked from the TLD down and the walk stops at the first MATCH_FULL
+ * entry. Returns nullptr if nothing blocks it; otherwise 'labels' is the
+ * number of labels, counted from the TLD, of the blocking entry.
+ */
+DomainInfo_t const *lookup_DomainTree(const TLD_implementation_t tld_impl,
+		DomainView_t dv[static 1], size_len_t labels[static 1])
+{
+	DomainLookup_t lookup = {.dv = dv};
+	lookup_batch_DomainTree(tld_impl, &lookup, 1);
+	*labels = lookup.labels;
+	return lookup.di;
+}
+
+/**
+ * Start the walk of one lookup at the table below its TLD. Returns false if
+ * the lookup is finished, i.e., the TLD is not held.
+ */
+static bool begin_lookup(const TLD_implementation_t tld_impl,
+		DomainLookup_t lookup[static 1])
+{
+	lookup->di = nullptr;
+	lookup->labels = 0;
+	lookup->it = begin_DomainView(lookup->dv);
+
+	SubdomainView_t sdv;
+	if(!next_DomainView(&lookup->it, &sdv))
+	{
+		return false;
+	}
+
+	DomainTree_t **dt = tld_impl.impl_funcs->find_dt_entry_for_tld(
+			tld_impl.context, sdv);
+	lookup->level = dt ? *dt : nullptr;
+	return lookup->level != nullptr;
+}
+
+/**
+ * Hash the next label of the lookup and prefetch the bucket of the table it
+ * is to be found in. Returns false if the lookup is finished.
+ */
+static bool hash_lookup(DomainLookup_t lookup[static 1])
+{
+	if(!lookup->level || !next_DomainView(&lookup->it, &lookup->sdv))
+	{
+		return false;
+	}
+
+	HASH_VALUE(lookup->sdv.data, lookup->sdv.len, lookup->hashv);
+
+	unsigned bkt;
+	HASH_TO_BKT(lookup->hashv, lookup->level->hh.tbl->num_buckets, bkt);
+	lookup->bucket = &lookup->level->hh.tbl->buckets[bkt];
+	__builtin_prefetch(lookup->bucket);
+	return true;
+}
+
+/**
+ * Find the hashed label of the lookup and step down to the table of its
+ * children. Finishes the lookup on a miss, a MATCH_FULL entry or the entry of
+ * the domain itself.
+ */
+static void find_lookup(DomainLookup_t lookup[static 1])
+{
+	DomainTree_t *entry = nullptr;
+	HASH_FIND_BYHASHVALUE(hh, lookup->level, lookup->sdv.data,
+			lookup->sdv.len, lookup->hashv, entry);
+
+	lookup->level = nullptr;
+	if(!entry)
+	{
+		return;
+	}
+
+	// a raw domain blocks the domain itself and none of its children.
+	if(entry->di && (entry->di->match_strength == MATCH_FULL ||
+				lookup->it.cur_seg == lookup->dv->segs_used))
+	{
+		lookup->di = entry->di;
+		lookup->labels = lookup->it.cur_seg;
+		return;
+	}
+
+	lookup->level = entry->child;
+}
+
+/**
+ * Run 'count' lookups together one level of the tree at a time. The buckets,
+ * then the first entries of the buckets, of every lookup at a level are
+ * prefetched before the first of them is searched so the cache misses of the
+ * batch overlap rather than follow each other.
+ * Nothing is allocated; a lookup is finished when its 'di' is set or it runs
+ * out of labels or tree.
+ */
+void lookup_batch_DomainTree(const TLD_implementation_t tld_impl,
+		DomainLookup_t lookups[], uint count)
+{
+	ASSERT(tld_impl.context);
+	ASSERT(tld_impl.impl_funcs);
+
+	uint active = 0;
+	for(uint i = 0; i < count; i++)
+	{
+		active += begin_lookup(tld_impl, &lookups[i]);
+	}
+
+	while(active > 0)
+	{
+		active = 0;
+		for(uint i = 0; i < count; i++)
+		{
+			if(hash_lookup(&lookups[i]))
+			{
+				active++;
+			}
+			else
+			{
+				lookups[i].level = nullptr;
+			}
+		}
+
+		// by now the first buckets have arrived; fetch the entries they head.
+		for(uint i = 0; i < count; i++)
+		{
+			if(lookups[i].level)
+			{
+				__builtin_prefetch(lookups[i].bucket->hh_head);
+			}
+		}
+
+		for(uint i = 0; i < count; i++)
+		{
+			if(lookups[i].level)
+			{
+				find_lookup(&lookups[i]);
+			}
+		}
+	}
+}
+
 #ifdef BUILD_TESTS
 typedef struct TestTable
 {
@@ -1104,6 +1353,106 @@ static void test_e2e_discovered2()
 	//free_DomainTree(&root);
 }
 
+static void test_lookup()
+{
+	TLD_implementation_t tld_impl = create_tld_hash_impl();
+	DomainView_t dv;
+	init_DomainView(&dv);
+
+	INSERT_DOMAIN("ads.example.com", MATCH_FULL, true);
+	INSERT_DOMAIN("www.somedomain.com", MATCH_WEAK, true);
+	INSERT_DOMAIN("tracker.co.uk", MATCH_FULL, true);
+
+	DomainView_t queries[6];
+	DomainLookup_t lookups[6] = {};
+	const char *names[6] = {
+		"x.y.ads.example.com",
+		"ads.example.com",
+		"example.com",
+		"www.somedomain.com",
+		"a.tracker.co.uk",
+		"a.www.somedomain.com",
+	};
+	for(uint i = 0; i < 6; i++)
+	{
+		init_DomainView(&queries[i]);
+		assert(update_DomainView(&queries[i], names[i], strlen(names[i])));
+		lookups[i].dv = &queries[i];
+	}
+
+	lookup_batch_DomainTree(tld_impl, lookups, 6);
+	assert(lookups[0].di && lookups[0].labels == 3);
+	assert(lookups[1].di && lookups[1].labels == 3);
+	assert(lookups[0].di == lookups[1].di);
+	assert(!lookups[2].di);
+	// weak entries block themselves and not their children.
+	assert(lookups[3].di && lookups[3].labels == 3);
+	assert(!lookups[5].di);
+	assert(lookups[4].di && lookups[4].labels == 3);
+
+	size_len_t labels = 0;
+	assert(lookup_DomainTree(tld_impl, &queries[4], &labels) == lookups[4].di);
+	assert(labels == 3);
+
+	update_DomainView(&dv, "ads.example.org", strlen("ads.example.org"));
+	assert(!lookup_DomainTree(tld_impl, &dv, &labels));
+
+	for(uint i = 0; i < 6; i++)
+	{
+		free_DomainView(&queries[i]);
+	}
+	free_DomainView(&dv);
+}
+
+typedef struct TestBelow
+{
+	long offsets[4];
+	uint used;
+} TestBelow_t;
+
+static void test_below_visitor(DomainInfo_t **di, void *context)
+{
+	TestBelow_t *below = context;
+	assert(below->used < 4);
+	below->offsets[below->used++] = (*di)->li.offset;
+}
+
+static void test_visit_below()
+{
+	TLD_implementation_t tld_impl = create_tld_hash_impl();
+	DomainView_t dv;
+	init_DomainView(&dv);
+
+	INSERT_DOMAIN("cdn.example.com", MATCH_FULL, true);
+	const long cdn = __LINE__ - 1;
+	INSERT_DOMAIN("x.b.example.com", MATCH_FULL, true);
+	const long xb = __LINE__ - 1;
+	INSERT_DOMAIN("a.example.com", MATCH_FULL, true);
+	const long a = __LINE__ - 1;
+	INSERT_DOMAIN("other.org", MATCH_FULL, true);
+
+	// in sorted order, a parent ahead of its children.
+	TestBelow_t below = {};
+	update_DomainView(&dv, "example.com", strlen("example.com"));
+	visit_below_DomainTree(tld_impl, &dv, test_below_visitor, &below);
+	assert(below.used == 3);
+	assert(below.offsets[0] == a);
+	assert(below.offsets[1] == xb);
+	assert(below.offsets[2] == cdn);
+
+	// the entry of the domain itself is not below it.
+	below.used = 0;
+	update_DomainView(&dv, "a.example.com", strlen("a.example.com"));
+	visit_below_DomainTree(tld_impl, &dv, test_below_visitor, &below);
+	assert(below.used == 0);
+
+	update_DomainView(&dv, "example.net", strlen("example.net"));
+	visit_below_DomainTree(tld_impl, &dv, test_below_visitor, &below);
+	assert(below.used == 0);
+
+	free_DomainView(&dv);
+}
+
 #undef INSERT_DOMAIN
 
 void info_DomainTree()
@@ -1130,6 +1479,8 @@ void test_DomainTree()
 	test_e2e_discovered();
 	test_e2e_discovered2();
 	test_insert_stronger();
+	test_lookup();
+	test_visit_below();
 	printf("Tested DomainTree.\n");
 }
 #endif
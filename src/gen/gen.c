@@ -0,0 +1,862 @@
+/**
+ * gen.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// getopt() is POSIX; -std=c23 declares only ISO C otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "dedupdomains.h"
+#include "adbplusline.h"
+#include "domain.h"
+#include "pfb_context.h"
+#include "rw_pfb_csv.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Synthetic blocklists of any size shaped like the lists they are learned
+ * from. Every domain of the given lists is split into its public suffix, the
+ * registered label left of it, and the labels below that, and the generator
+ * learns:
+ *
+ * - the share of each suffix;
+ * - the number of labels below the suffix;
+ * - the lengths of the registered labels and of the labels below them;
+ * - the characters of the labels;
+ * - the fan-out, i.e., entries per registered domain;
+ * - the share of registered domains with several entries that are themselves
+ *   listed, blocking the other entries;
+ * - the share of duplicate entries, comment lines, and header lines.
+ *
+ * The output is written one registered domain, i.e., group, at a time and
+ * holds nothing but the last few entries, so lists of 100M lines and more
+ * take no more memory than small ones. Each group is drawn from a seed of its
+ * own: the B list takes the group of the A list of the same index for the
+ * requested share of its groups, which sets the A-vs-B overlap.
+ */
+
+#define GEN_MAX_DEPTH 16
+#define GEN_MAX_LABEL 63
+#define GEN_MAX_FANOUT 4096
+#define GEN_MAX_DOMAIN 253
+// recent entries a duplicate is drawn from.
+#define GEN_RECENT 1024
+
+static const char GEN_ALPHABET[] = "abcdefghijklmnopqrstuvwxyz0123456789-";
+#define GEN_CHARS (sizeof(GEN_ALPHABET) - 1)
+
+typedef struct gen_suffix
+{
+	char name[32];
+	size_t count;
+} gen_suffix_t;
+
+typedef struct gen_entry
+{
+	uint64_t domain;
+	// hash of the registered domain; the low bit is set for the registered
+	// domain itself.
+	uint64_t group;
+} gen_entry_t;
+
+/**
+ * The learned distributions. The histograms are counts while learning and
+ * running sums once gen_finish_model() is done.
+ */
+typedef struct gen_model
+{
+	size_t depth[GEN_MAX_DEPTH + 1];
+	size_t registered_len[GEN_MAX_LABEL + 1];
+	size_t sub_len[GEN_MAX_LABEL + 1];
+	size_t fanout[GEN_MAX_FANOUT + 1];
+	size_t chars[GEN_CHARS];
+	gen_suffix_t *suffixes;
+	size_t suffixes_used;
+	gen_entry_t *entries;
+	size_t entries_used;
+	size_t entries_alloc;
+
+	size_t lines;
+	size_t comments;
+	size_t headers;
+	size_t files;
+	// true while the leading comments of a file are read.
+	bool in_header;
+
+	double dup;
+	double rooted;
+	double comment;
+	uint header_lines;
+} gen_model_t;
+
+typedef struct gen_options
+{
+	size_t lines;
+	uint64_t seed;
+	double overlap;
+	bool hosts;
+} gen_options_t;
+
+typedef struct gen_writer
+{
+	FILE *out;
+	gen_model_t const *model;
+	gen_options_t const *options;
+	// seed of the groups of this list and of the A list.
+	uint64_t seed;
+	uint64_t seed_a;
+	bool is_b;
+	uint64_t state;
+
+	// the group being written.
+	size_t group;
+	uint64_t group_state;
+	size_t fanout;
+	size_t next_entry;
+	bool rooted;
+	uint suffix;
+	char registered[GEN_MAX_LABEL + 1];
+
+	char recent[GEN_RECENT][GEN_MAX_DOMAIN + 1];
+	size_t recent_used;
+} gen_writer_t;
+
+static uint64_t splitmix64(uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+static uint64_t next_random(uint64_t state[static 1])
+{
+	*state = splitmix64(*state);
+	return *state;
+}
+
+static double uniform(uint64_t state[static 1])
+{
+	return (next_random(state) >> 11) * 0x1.0p-53;
+}
+
+static uint64_t hash_str(char const *s, size_t len)
+{
+	// FNV-1a
+	uint64_t h = 0xcbf29ce484222325ull;
+	for(size_t i = 0; i < len; i++)
+	{
+		h = (h ^ (unsigned char)s[i]) * 0x100000001b3ull;
+	}
+	return h;
+}
+
+/**
+ * Index of the bucket of a running sum 'cum' of 'n' buckets which a random
+ * draw falls in.
+ */
+static size_t sample(size_t const cum[], size_t n, uint64_t state[static 1])
+{
+	ASSERT(n > 0 && cum[n - 1] > 0);
+	const size_t want = next_random(state) % cum[n - 1];
+	size_t lo = 0;
+	size_t hi = n - 1;
+	while(lo < hi)
+	{
+		const size_t mid = lo + (hi - lo) / 2;
+		if(cum[mid] > want)
+		{
+			hi = mid;
+		}
+		else
+		{
+			lo = mid + 1;
+		}
+	}
+	return lo;
+}
+
+/**
+ * As sample() but limited to the buckets from 'first' on; returns 'first' if
+ * they are all empty.
+ */
+static size_t sample_from(size_t const cum[], size_t n, size_t first,
+		uint64_t state[static 1])
+{
+	const size_t below = first ? cum[first - 1] : 0;
+	if(first >= n || cum[n - 1] == below)
+	{
+		return first;
+	}
+	const size_t want = below + next_random(state) % (cum[n - 1] - below);
+	size_t i = first;
+	while(cum[i] <= want)
+	{
+		i++;
+	}
+	return i;
+}
+
+static char const *last_dot(char const *s, size_t len)
+{
+	while(len-- > 0)
+	{
+		if(s[len] == '.')
+		{
+			return s + len;
+		}
+	}
+	return nullptr;
+}
+
+static void running_sum(size_t hist[], size_t n)
+{
+	for(size_t i = 1; i < n; i++)
+	{
+		hist[i] += hist[i - 1];
+	}
+}
+
+static int cmp_suffix(const void *a, const void *b)
+{
+	return strcmp(((gen_suffix_t const *)a)->name,
+			((gen_suffix_t const *)b)->name);
+}
+
+static void count_suffix(gen_model_t model[static 1], char const *s,
+		size_t len)
+{
+	gen_suffix_t key = {};
+	if(len >= sizeof(key.name))
+	{
+		return;
+	}
+	memcpy(key.name, s, len);
+
+	gen_suffix_t *found = bsearch(&key, model->suffixes,
+			model->suffixes_used, sizeof(key), cmp_suffix);
+	if(found)
+	{
+		found->count++;
+		return;
+	}
+
+	CHECK_REALLOC(model->suffixes,
+			sizeof(gen_suffix_t) * (model->suffixes_used + 1));
+	size_t at = 0;
+	while(at < model->suffixes_used &&
+			strcmp(model->suffixes[at].name, key.name) < 0)
+	{
+		at++;
+	}
+	memmove(&model->suffixes[at + 1], &model->suffixes[at],
+			sizeof(gen_suffix_t) * (model->suffixes_used - at));
+	key.count = 1;
+	model->suffixes[at] = key;
+	model->suffixes_used++;
+}
+
+/**
+ * Length of the public suffix ending 'fqd': the last label, or the last two
+ * if the last is a country code below which names are registered under a
+ * generic second level, e.g., 'co.uk'. Good enough for the shape of a list,
+ * not for policy.
+ */
+static size_t suffix_len(char const *fqd, size_t len)
+{
+	char const *last = last_dot(fqd, len);
+	if(!last)
+	{
+		return 0;
+	}
+	const size_t tld = fqd + len - last - 1;
+	if(tld != 2)
+	{
+		return tld;
+	}
+
+	static const char *const second[] = {
+		"ac", "co", "com", "edu", "gov", "ne", "net", "or", "org",
+	};
+	char const *prev = last_dot(fqd, last - fqd);
+	char const *sld = prev ? prev + 1 : fqd;
+	if(!prev)
+	{
+		return tld;
+	}
+	for(size_t i = 0; i < sizeof(second) / sizeof(second[0]); i++)
+	{
+		if((size_t)(last - sld) == strlen(second[i]) &&
+				memcmp(sld, second[i], last - sld) == 0)
+		{
+			return fqd + len - sld;
+		}
+	}
+	return tld;
+}
+
+static void learn_domain(gen_model_t model[static 1], char *fqd, size_t len)
+{
+	bool folded = false;
+	if(!normalize_domain(fqd, len, &folded))
+	{
+		return;
+	}
+	const size_t suffix = suffix_len(fqd, len);
+	if(suffix == 0 || suffix + 1 >= len)
+	{
+		return;
+	}
+	count_suffix(model, fqd + len - suffix, suffix);
+
+	// the labels below the suffix from right to left; the first is the
+	// registered label.
+	const size_t below = len - suffix - 1;
+	size_t depth = 0;
+	size_t end = below;
+	size_t registered = 0;
+	while(true)
+	{
+		char const *dot = last_dot(fqd, end);
+		const size_t start = dot ? (size_t)(dot - fqd) + 1 : 0;
+		const size_t label = MIN(end - start, (size_t)GEN_MAX_LABEL);
+		if(depth++ == 0)
+		{
+			model->registered_len[label]++;
+			registered = start;
+		}
+		else
+		{
+			model->sub_len[label]++;
+		}
+		for(size_t i = start; i < end; i++)
+		{
+			char const *c = memchr(GEN_ALPHABET, fqd[i], GEN_CHARS);
+			if(c)
+			{
+				model->chars[c - GEN_ALPHABET]++;
+			}
+		}
+		if(!dot)
+		{
+			break;
+		}
+		end = start - 1;
+	}
+	model->depth[MIN(depth, (size_t)GEN_MAX_DEPTH)]++;
+
+	if(model->entries_used == model->entries_alloc)
+	{
+		model->entries_alloc = MAX(model->entries_alloc * 2, (size_t)4096);
+		CHECK_REALLOC(model->entries,
+				sizeof(gen_entry_t) * model->entries_alloc);
+	}
+	model->entries[model->entries_used++] = (gen_entry_t){
+		.domain = hash_str(fqd, len),
+		.group = (hash_str(fqd + registered, len - registered) & ~1ull) |
+			(depth == 1),
+	};
+}
+
+static void learn_line(PortLineData_t const *const pld, pfb_context_t*,
+		void *data)
+{
+	gen_model_t *model = data;
+	AdbplusView_t lv;
+	const bool parsed = parse_adbplus_line(&lv, pld->data);
+	model->lines++;
+
+	if(parsed && (lv.ms == MATCH_COMMENT || lv.ms == MATCH_HEADER))
+	{
+		if(model->in_header)
+		{
+			model->headers++;
+		}
+		else
+		{
+			model->comments++;
+		}
+		return;
+	}
+	model->in_header = false;
+
+	if(!parsed || (lv.ms != MATCH_FULL && lv.ms != MATCH_WEAK))
+	{
+		return;
+	}
+	do
+	{
+		learn_domain(model, (char *)lv.data, lv.len);
+	} while(next_hosts_domain(&lv));
+}
+
+static int cmp_domain(const void *a, const void *b)
+{
+	const uint64_t x = ((gen_entry_t const *)a)->domain;
+	const uint64_t y = ((gen_entry_t const *)b)->domain;
+	return (x > y) - (x < y);
+}
+
+static int cmp_group(const void *a, const void *b)
+{
+	const uint64_t x = ((gen_entry_t const *)a)->group >> 1;
+	const uint64_t y = ((gen_entry_t const *)b)->group >> 1;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Derive the rates from the entries learned and turn the histograms into
+ * running sums. Rates already set, i.e., not negative, are kept.
+ */
+static void gen_finish_model(gen_model_t model[static 1])
+{
+	if(model->entries_used == 0)
+	{
+		ELOG_STDERR("ERROR: no domains to learn from\n");
+		exit(EXIT_FAILURE);
+	}
+
+	qsort(model->entries, model->entries_used, sizeof(gen_entry_t),
+			cmp_domain);
+	size_t distinct = 0;
+	for(size_t i = 0; i < model->entries_used; i++)
+	{
+		if(distinct == 0 ||
+				model->entries[i].domain != model->entries[distinct - 1].domain)
+		{
+			model->entries[distinct++] = model->entries[i];
+		}
+	}
+
+	qsort(model->entries, distinct, sizeof(gen_entry_t), cmp_group);
+	size_t several = 0;
+	size_t rooted = 0;
+	for(size_t i = 0; i < distinct;)
+	{
+		size_t k = 0;
+		bool root = false;
+		const uint64_t group = model->entries[i].group >> 1;
+		for(; i < distinct && model->entries[i].group >> 1 == group; i++, k++)
+		{
+			root = root || (model->entries[i].group & 1);
+		}
+		model->fanout[MIN(k, (size_t)GEN_MAX_FANOUT)]++;
+		if(k > 1)
+		{
+			several++;
+			rooted += root;
+		}
+	}
+
+	if(model->dup < 0)
+	{
+		model->dup = 1.0 - (double)distinct / model->entries_used;
+	}
+	if(model->rooted < 0)
+	{
+		model->rooted = several ? (double)rooted / several : 0.0;
+	}
+	if(model->comment < 0)
+	{
+		model->comment = model->lines > model->headers ?
+			(double)model->comments / (model->lines - model->headers) : 0.0;
+	}
+	model->header_lines = (model->headers + model->files / 2) /
+		MAX(model->files, (size_t)1);
+
+	running_sum(model->depth, GEN_MAX_DEPTH + 1);
+	running_sum(model->registered_len, GEN_MAX_LABEL + 1);
+	running_sum(model->sub_len, GEN_MAX_LABEL + 1);
+	running_sum(model->fanout, GEN_MAX_FANOUT + 1);
+	running_sum(model->chars, GEN_CHARS);
+	for(size_t i = 1; i < model->suffixes_used; i++)
+	{
+		model->suffixes[i].count += model->suffixes[i - 1].count;
+	}
+
+	// a list of one-character labels or none below the registered label
+	// leaves these empty; fall back to something sensible.
+	if(model->sub_len[GEN_MAX_LABEL] == 0)
+	{
+		for(size_t i = 3; i <= GEN_MAX_LABEL; i++)
+		{
+			model->sub_len[i] = i - 2;
+		}
+	}
+
+	DEBUG_PRINTF("learned %zu entries, %zu distinct, %zu suffixes, "
+			"dup %.3f rooted %.3f comment %.3f headers %u\n",
+			model->entries_used, distinct, model->suffixes_used, model->dup,
+			model->rooted, model->comment, model->header_lines);
+
+	free(model->entries);
+	model->entries = nullptr;
+	model->entries_used = 0;
+}
+
+static size_t sample_suffix(gen_model_t const model[static 1],
+		uint64_t state[static 1])
+{
+	const size_t want = next_random(state) %
+		model->suffixes[model->suffixes_used - 1].count;
+	size_t lo = 0;
+	size_t hi = model->suffixes_used - 1;
+	while(lo < hi)
+	{
+		const size_t mid = lo + (hi - lo) / 2;
+		if(model->suffixes[mid].count > want)
+		{
+			hi = mid;
+		}
+		else
+		{
+			lo = mid + 1;
+		}
+	}
+	return lo;
+}
+
+/**
+ * Write a label drawn from 'state' with a length from 'lengths' to 'out';
+ * returns its length. Labels neither begin nor end with '-'.
+ */
+static size_t random_label(gen_model_t const model[static 1],
+		size_t const lengths[static GEN_MAX_LABEL + 1], uint64_t state,
+		char out[static GEN_MAX_LABEL + 1])
+{
+	const size_t len = MAX(sample(lengths, GEN_MAX_LABEL + 1, &state),
+			(size_t)1);
+	for(size_t i = 0; i < len; i++)
+	{
+		char c = GEN_ALPHABET[sample(model->chars, GEN_CHARS, &state)];
+		if(c == '-' && (i == 0 || i + 1 == len))
+		{
+			c = 'a' + next_random(&state) % 26;
+		}
+		out[i] = c;
+	}
+	return len;
+}
+
+static void start_group(gen_writer_t w[static 1])
+{
+	gen_model_t const *model = w->model;
+
+	uint64_t state = splitmix64(w->seed ^ splitmix64(w->group));
+	if(w->is_b && uniform(&state) < w->options->overlap)
+	{
+		state = splitmix64(w->seed_a ^ splitmix64(w->group));
+	}
+	w->group++;
+	w->group_state = state;
+
+	w->fanout = MAX(sample(model->fanout, GEN_MAX_FANOUT + 1, &state),
+			(size_t)1);
+	w->rooted = w->fanout > 1 && uniform(&state) < model->rooted;
+	w->suffix = sample_suffix(model, &state);
+	const size_t len = random_label(model, model->registered_len,
+			next_random(&state), w->registered);
+	w->registered[len] = '\0';
+	w->next_entry = 0;
+}
+
+/**
+ * Write entry 'j' of the current group to 'out'; returns its length. The
+ * labels between the registered label and the leftmost label are drawn from
+ * a handful per level of the group half the time so siblings share parents
+ * as real lists do; the leftmost label is always drawn anew so entries are
+ * neither duplicates nor below one another but by the rates asked for.
+ */
+static size_t group_entry(gen_writer_t w[static 1], size_t j,
+		char out[static GEN_MAX_DOMAIN + 1])
+{
+	gen_model_t const *model = w->model;
+	uint64_t state = splitmix64(w->group_state ^ splitmix64(j + 1));
+
+	size_t depth;
+	if(w->fanout == 1)
+	{
+		depth = sample(model->depth, GEN_MAX_DEPTH + 1, &state);
+	}
+	else if(w->rooted && j == 0)
+	{
+		depth = 1;
+	}
+	else
+	{
+		depth = sample_from(model->depth, GEN_MAX_DEPTH + 1, 2, &state);
+	}
+	depth = MAX(depth, (size_t)1);
+
+	char label[GEN_MAX_LABEL + 1];
+	char const *suffix = model->suffixes[w->suffix].name;
+	const size_t suffix_len = strlen(suffix);
+	const size_t registered_len = strlen(w->registered);
+
+	// build from the right: the suffix, the registered label, then the
+	// labels below it for as long as they fit.
+	size_t at = GEN_MAX_DOMAIN - suffix_len;
+	memcpy(out + at, suffix, suffix_len);
+	out[--at] = '.';
+	at -= registered_len;
+	memcpy(out + at, w->registered, registered_len);
+	for(size_t level = 1; level < depth; level++)
+	{
+		uint64_t label_state = next_random(&state);
+		if(level + 1 < depth && (label_state & 1))
+		{
+			label_state = splitmix64(w->group_state ^ (level << 8) ^
+					(label_state >> 1) % 4);
+		}
+		const size_t len = random_label(model, model->sub_len, label_state,
+				label);
+		if(len + 1 > at)
+		{
+			break;
+		}
+		out[--at] = '.';
+		at -= len;
+		memcpy(out + at, label, len);
+	}
+
+	const size_t len = GEN_MAX_DOMAIN - at;
+	memmove(out, out + at, len);
+	out[len] = '\0';
+	return len;
+}
+
+static void write_entry(gen_writer_t w[static 1], char const *domain)
+{
+	if(w->options->hosts)
+	{
+		fprintf(w->out, "0.0.0.0 %s\n", domain);
+	}
+	else
+	{
+		fprintf(w->out, "||%s^\n", domain);
+	}
+}
+
+static void write_list(gen_writer_t w[static 1])
+{
+	gen_model_t const *model = w->model;
+	const char comment = w->options->hosts ? '#' : '!';
+	size_t lines = 0;
+
+	// an adbplus list opens with its '[Adblock Plus 2.0]' line.
+	const uint header_lines = MAX(model->header_lines,
+			(uint)!w->options->hosts);
+	const uint title = !w->options->hosts;
+	for(uint i = 0; i < header_lines && lines < w->options->lines;
+			i++, lines++)
+	{
+		if(i < title)
+		{
+			fputs("[Adblock Plus 2.0]\n", w->out);
+		}
+		else if(i == title)
+		{
+			fprintf(w->out, "%c Title: Synthetic list %s\n", comment,
+					w->is_b ? "B" : "A");
+		}
+		else
+		{
+			fprintf(w->out, "%c Header line %u\n", comment, i);
+		}
+	}
+
+	char domain[GEN_MAX_DOMAIN + 1];
+	for(; lines < w->options->lines; lines++)
+	{
+		if(uniform(&w->state) < model->comment)
+		{
+			fprintf(w->out, "%c comment %zu\n", comment, lines);
+			continue;
+		}
+		if(w->recent_used && uniform(&w->state) < model->dup)
+		{
+			const size_t pick = next_random(&w->state) %
+				MIN(w->recent_used, (size_t)GEN_RECENT);
+			write_entry(w, w->recent[pick]);
+			continue;
+		}
+
+		if(w->next_entry == w->fanout)
+		{
+			start_group(w);
+		}
+		group_entry(w, w->next_entry++, domain);
+		write_entry(w, domain);
+		strcpy(w->recent[w->recent_used++ % GEN_RECENT], domain);
+	}
+
+	if(fflush(w->out) != 0 || ferror(w->out))
+	{
+		ELOG_STDERR("ERROR: failed to write a synthetic list\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void generate(gen_model_t const model[static 1],
+		gen_options_t const options[static 1], const char *path, bool is_b)
+{
+	FILE *out = path ? fopen(path, "wb") : stdout;
+	if(!out)
+	{
+		ELOG_STDERR("ERROR: failed to open %s for writing\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	gen_writer_t *w = calloc(1, sizeof(gen_writer_t));
+	CHECK_MALLOC(w);
+	w->out = out;
+	w->model = model;
+	w->options = options;
+	w->seed_a = splitmix64(options->seed);
+	w->seed = is_b ? splitmix64(options->seed + 1) : w->seed_a;
+	w->is_b = is_b;
+	w->state = w->seed ^ 0x5851f42d4c957f2dull;
+	write_list(w);
+	free(w);
+
+	if(path && fclose(out) != 0)
+	{
+		ELOG_STDERR("ERROR: failed to close %s\n", path);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static double parse_rate(const char *name, const char *arg)
+{
+	char *end;
+	const double rate = strtod(arg, &end);
+	if(*end != '\0' || !(rate >= 0.0 && rate <= 1.0))
+	{
+		ELOG_STDERR("ERROR: %s must be within 0 and 1: %s\n", name, arg);
+		exit(EXIT_FAILURE);
+	}
+	return rate;
+}
+
+static void usage(const char *name)
+{
+	ELOG_STDERR("usage: %s [-n lines] [-s seed] [-t adbplus|hosts]\n"
+			"\t[-d dup] [-p parent] [-c comment] [-o A] [-b B [-x overlap]]\n"
+			"\tlist...\n"
+			"Write a synthetic list of 'lines' lines shaped like the lists\n"
+			"given, to A or stdout, and a second list B sharing 'overlap' of\n"
+			"its registered domains with A. The rates of duplicate entries,\n"
+			"of registered domains listed above their subdomains, and of\n"
+			"comment lines are learned unless given.\n", name);
+}
+
+int main(int argc, char *const argv[])
+{
+	gen_options_t options = {
+		.lines = 1000000,
+		.overlap = 0.9,
+	};
+	gen_model_t model = {
+		.dup = -1.0,
+		.rooted = -1.0,
+		.comment = -1.0,
+	};
+	const char *out_a = nullptr;
+	const char *out_b = nullptr;
+
+	int opt;
+	while((opt = getopt(argc, argv, "n:s:t:d:p:c:o:b:x:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n':
+				options.lines = strtoull(optarg, nullptr, 10);
+				break;
+			case 's':
+				options.seed = strtoull(optarg, nullptr, 10);
+				break;
+			case 't':
+				if(strcmp(optarg, "hosts") == 0)
+				{
+					options.hosts = true;
+				}
+				else if(strcmp(optarg, "adbplus") != 0)
+				{
+					usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'd':
+				model.dup = parse_rate("-d", optarg);
+				break;
+			case 'p':
+				model.rooted = parse_rate("-p", optarg);
+				break;
+			case 'c':
+				model.comment = parse_rate("-c", optarg);
+				break;
+			case 'o':
+				out_a = optarg;
+				break;
+			case 'b':
+				out_b = optarg;
+				break;
+			case 'x':
+				options.overlap = parse_rate("-x", optarg);
+				break;
+			default:
+				usage(argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	if(optind == argc || options.lines == 0 || (out_b && !out_a))
+	{
+		usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	for(int i = optind; i < argc; i++)
+	{
+		FILE *file = fopen(argv[i], "rb");
+		if(!file)
+		{
+			ELOG_STDERR("ERROR: failed to open %s for reading\n", argv[i]);
+			exit(EXIT_FAILURE);
+		}
+		pfb_context_t context = pfb_context_from_FILE(file);
+		model.in_header = true;
+		model.files++;
+		pfb_read_one_context(&context, learn_line, &model);
+		free(context.mem_buffer);
+		fclose(file);
+	}
+	gen_finish_model(&model);
+
+	generate(&model, &options, out_a, false);
+	if(out_b)
+	{
+		generate(&model, &options, out_b, true);
+	}
+
+	free(model.suffixes);
+	return 0;
+}
@@ -23,6 +23,9 @@
 #include <stdlib.h>
 #include "inputargs.h"
 #include "pfb_prune.h"
+#include "pfb_format.h"
+#include "pfb_index.h"
+#include "pfb_session.h"
 #include "version.nogit.h"
 #include <unistd.h>
 #include <getopt.h>
@@ -32,129 +35,16 @@
 #include <string.h>
 #include <errno.h>
 
+// errors in the arguments go to the log when one is given.
 #define ELOG_IFARGS(args, fmt, ...) do { \
-	open_logfile(args); \
-	fprintf(get_elogFile(args), fmt, ##__VA_ARGS__); \
-	close_logfile(args); \
+	pfb_log_printf(pfb_log_has_file(PFB_LOG_STD) ? PFB_LOG_STD : PFB_LOG_ERR, \
+			fmt, ##__VA_ARGS__); \
 } while(0)
 
 #ifdef BUILD_TESTS
 #define TESTS_PRINTF
 #endif
 
-#define PATH_SEP_CHAR '/'
-
-
-bool open_logfile(input_args_t iargs[static 1])
-{
-	assert(iargs && "tests only");
-	if(iargs->log_fname)
-	{
-		iargs->outFile = fopen(iargs->log_fname, "ab");
-		if(!iargs->outFile)
-		{
-			iargs->outFile = stdout;
-			fprintf(stderr, "ERROR: Unable to open %s for append writing.\n", iargs->log_fname);
-		}
-		else
-		{
-			iargs->errFile = iargs->outFile;
-			return true;
-		}
-	}
-	return false;
-}
-
-void close_logfile(input_args_t iargs[static 1])
-{
-	assert(iargs && "tests only");
-	if(iargs->log_fname)
-	{
-		ASSERT(iargs->outFile);
-		ASSERT(iargs->errFile);
-		ASSERT(iargs->outFile != stdout);
-		ASSERT(iargs->errFile != stderr);
-		fclose(iargs->outFile);
-		iargs->outFile = stdout;
-		iargs->errFile = stderr;
-	}
-}
-
-FILE *get_logFile(input_args_t iargs[static 1])
-{
-	assert(iargs && "tests only");
-#ifdef BUILD_TESTS
-	UNUSED(iargs);
-	return stdout;
-#else
-	return iargs->errFile == nullptr ? stderr : iargs->errFile;
-#endif
-}
-
-static FILE *get_elogFile(input_args_t iargs[static 1])
-{
-	assert(iargs && "tests only");
-#ifdef BUILD_TESTS
-	UNUSED(iargs);
-	return stderr;
-#else
-	return iargs->errFile == nullptr ? stderr : iargs->errFile;
-#endif
-}
-
-typedef struct globalLog
-{
-	const char *log_fname;
-	FILE *file;
-} globalLog_t;
-
-static globalLog_t *global_errLog = nullptr;
-static globalLog_t *global_stdLog = nullptr;
-
-void open_globalErrLog()
-{
-	if(global_errLog)
-	{
-		if(global_errLog->log_fname && global_errLog->file == nullptr)
-		{
-			global_errLog->file = fopen(global_errLog->log_fname, "ab");
-			if(!global_errLog->file)
-			{
-				fprintf(stderr, "ERROR: Unable to open %s for append writing.\n", global_errLog->log_fname);
-			}
-		}
-	}
-}
-
-void close_globalErrLog()
-{
-	if(global_errLog && global_errLog->log_fname && global_errLog->file &&
-			global_errLog->file != stderr)
-	{
-		fclose(global_errLog->file);
-		global_errLog->file = nullptr;
-	}
-}
-
-FILE *get_globalErrLog()
-{
-	if(global_errLog && global_errLog->log_fname && global_errLog->file)
-	{
-		return global_errLog->file;
-	}
-
-	return stderr;
-}
-
-void free_globalErrLog()
-{
-	if(global_errLog)
-	{
-		free(global_errLog);
-		global_errLog = nullptr;
-	}
-}
-
 void append_filename_array(char ***filenames, size_t num_files[static 1],
 		char entry[static 1])
 {
@@ -177,23 +67,30 @@ void append_filename_array(char ***filenames, size_t num_files[static 1],
 void init_input_args(input_args_t iargs[static 1])
 {
 	memset(iargs, 0, sizeof(input_args_t));
-	iargs->outFile = stdout;
-	iargs->errFile = stderr;
+	iargs->jobs = 1;
 }
 
-void free_input_args(input_args_t iargs[static 1])
+void free_paths_list(paths_list_t pl[static 1])
 {
-	for(uint i = 0; i < iargs->input_paths_A.len; i++)
+	for(uint i = 0; i < pl->len; i++)
 	{
-		free(iargs->input_paths_A.paths[i].path);
+		free(pl->paths[i].path);
 	}
-	free(iargs->input_paths_A.paths);
+	free(pl->paths);
+	*pl = (paths_list_t){};
+}
+
+void free_input_args(input_args_t iargs[static 1])
+{
+	free_paths_list(&iargs->input_paths_A);
+	free_paths_list(&iargs->input_paths_B);
 
-	for(uint i = 0; i < iargs->input_paths_B.len; i++)
+	for(uint s = 0; s < iargs->num_sets; s++)
 	{
-		free(iargs->input_paths_B.paths[i].path);
+		free_paths_list(&iargs->input_paths_sets[s]);
 	}
-	free(iargs->input_paths_B.paths);
+	free(iargs->input_paths_sets);
+	free(iargs->out_specs);
 
 	memset(iargs, 0, sizeof(input_args_t));
 }
@@ -208,6 +105,7 @@ static int extract_stat_info(const char path[static 1], pfb_stat_t pfb_s[static
 		pfb_s->file_size = s.st_size;
 		pfb_s->st_dev = s.st_dev;
 		pfb_s->st_ino = s.st_ino;
+		pfb_s->mtime = s.st_mtime;
 		return true;
 	}
 	
@@ -216,6 +114,7 @@ static int extract_stat_info(const char path[static 1], pfb_stat_t pfb_s[static
 		pfb_s->file_size = 0;
 		pfb_s->st_dev = 0;
 		pfb_s->st_ino = 0;
+		pfb_s->mtime = 0;
 		return true;
 	}
 
@@ -233,6 +132,64 @@ bool silent_mode(const input_args_t iargs[static 1])
 	return (iargs->silent_flag && !iargs->log_flag);
 }
 
+/**
+ * Parse the operand of -F: <format> sets the format of the output; with
+ * :<file> a further output is added.
+ */
+static bool parse_out_spec(input_args_t iargs[static 1], const char *spec)
+{
+	const char *colon = strchr(spec, ':');
+	const size_t len = colon ? (size_t)(colon - spec) : strlen(spec);
+
+	enum pfb_out_format format;
+	if(!pfb_parse_format(spec, len, &format))
+	{
+		ELOG_IFARGS(iargs, "ERROR: unknown output format '%.*s'; expecting adbplus, domains, hosts, dnsmasq, unbound, or rpz\n",
+				(int)len, spec);
+		return false;
+	}
+
+	if(!colon)
+	{
+		iargs->out_format = format;
+		return true;
+	}
+
+	if(colon[1] == '\0')
+	{
+		ELOG_IFARGS(iargs, "ERROR: -F %s names no file\n", spec);
+		return false;
+	}
+
+	iargs->num_out_specs++;
+	CHECK_REALLOC(iargs->out_specs, sizeof(pfb_out_spec_t) * iargs->num_out_specs);
+	iargs->out_specs[iargs->num_out_specs - 1] = (pfb_out_spec_t){
+		.format = format,
+		.fname = colon + 1,
+	};
+	return true;
+}
+
+/**
+ * Parse the operand 'arg' of option 'opt' into 'count', a non-negative
+ * integer. 'what' names the count in the error.
+ */
+static bool parse_count(char opt, const char arg[static 1],
+		const char what[static 1], uint count[static 1])
+{
+	char *end;
+	errno = 0;
+	const long value = strtol(arg, &end, 10);
+	if(errno != 0 || end == arg || *end != '\0' || value < 0 || value > UINT_MAX)
+	{
+		ELOG_IFARGS(nullptr, "ERROR: -%c %s is not %s\n", opt, arg, what);
+		return false;
+	}
+
+	*count = value;
+	return true;
+}
+
 /**
  * getopt() dictates const-signature of 'argv'.
  */
@@ -243,7 +200,7 @@ static bool do_parse_input_args(int argc, char * const* argv,
 	char opt;
 
 	// getopt(int, char * const *, char const *);
-	while(errorFlag == 0 && (opt = getopt(argc, argv, ":vsL:tbaDMxo:E:")) != -1)
+	while(errorFlag == 0 && (opt = getopt(argc, argv, ":vsL:tb:aA:DNTMS:U:Q:R:P:C:F:J:z:j:exo:E:")) != -1)
 	{
 
 		// without -D, the behavior is a differ: diff two input sets and write
@@ -262,6 +219,7 @@ static bool do_parse_input_args(int argc, char * const* argv,
 			case 'L':
 				iargs->log_flag = true;
 				iargs->log_fname = optarg;
+				pfb_log_open(PFB_LOG_STD, optarg);
 				break;
 			case 't':
 #ifndef BUILD_TESTS
@@ -272,13 +230,27 @@ static bool do_parse_input_args(int argc, char * const* argv,
 				break;
 			case 'b':
 				iargs->use_shared_buffer = true;
-				// argument to set the maximum in-memory buffer size for input
-				// files in MB. for example, 100MB.
-				iargs->in_memory_buffer_size = atoi(optarg);
+				// the memory budget of the run in MB, e.g., 100; see
+				// pfb_memory.h.
+				if(!parse_count(opt, optarg, "a size in MB",
+							&iargs->in_memory_buffer_size))
+				{
+					errorFlag++;
+				}
+				break;
+			case 'e':
+				// de-duplicate in bounded sorted runs spilled to disk and
+				// merged. the memory used is capped by -b.
+				iargs->external_mode = true;
 				break;
 			case 'a':
 				iargs->algorithm = optarg;
 				break;
+			case 'A':
+				// apply the delta to the single input set given as the base
+				// and write the resulting adlist.
+				iargs->delta_fname = optarg;
+				break;
 			case 'D':
 				// de-duplicate and sort one or more files or directories
 				// containing files. no validation on files other than the
@@ -294,15 +266,112 @@ static bool do_parse_input_args(int argc, char * const* argv,
 				// in the header and file and write the file to disk w/o the
 				// binary header.
 				break;
+			case 'N':
+				// the remaining arguments are two or more input sets; each may
+				// be a file or a directory. writes how each set overlaps the
+				// others instead of a diff.
+				iargs->overlap_mode = true;
+				break;
+			case 'T':
+				// the remaining arguments are three input sets: base, ours,
+				// and theirs. writes what each side changed since base.
+				iargs->threeway_mode = true;
+				break;
 			case 'M':
 				iargs->in_memory_mode = true;
 				break;
+			case 'S':
+				// write the result of a set operation on the two input sets
+				// as a clean adlist instead of the diff report.
+				if(strcmp(optarg, "intersect") == 0)
+				{
+					iargs->diff_output = DIFF_INTERSECTION;
+				}
+				else if(strcmp(optarg, "minus") == 0)
+				{
+					iargs->diff_output = DIFF_A_MINUS_B;
+				}
+				else if(strcmp(optarg, "symdiff") == 0)
+				{
+					iargs->diff_output = DIFF_SYMMETRIC;
+				}
+				else if(strcmp(optarg, "delta") == 0)
+				{
+					iargs->diff_output = DIFF_DELTA;
+				}
+				else
+				{
+					ELOG_IFARGS(iargs, "ERROR: unknown set operation '%s'; expecting intersect, minus, symdiff, or delta\n", optarg);
+					errorFlag++;
+				}
+				break;
+			case 'U':
+				// update the given index with the remaining arguments which
+				// are the same inputs as given to -D. only the new or
+				// changed inputs are read. writes to the index unless -o is
+				// given.
+				iargs->update_fname = optarg;
+				break;
+			case 'Q':
+				// look up every name of the given file in the remaining
+				// arguments which are the same inputs as given to -D. writes
+				// the rule blocking each blocked name.
+				iargs->query_fname = optarg;
+				break;
+			case 'R':
+				// serve requests on the given Unix domain socket until
+				// signaled. the remaining arguments are lists to load at
+				// startup; each may be a file or a directory and is named by
+				// its argument.
+				iargs->socket_fname = optarg;
+				break;
+			case 'P':
+				// de-duplicate each input of -D on its own and write it next
+				// to the input with the given extension. with -j, the inputs
+				// are processed in parallel.
+				iargs->out_ext = optarg;
+				break;
+			case 'C':
+				// keep the de-duplicated run of each plain text input in the
+				// given directory. an input unchanged since the previous run
+				// is mapped from its run instead of parsed.
+				iargs->cache_dir = optarg;
+				break;
+			case 'F':
+				// write the de-duplicated output of -D in the given format.
+				// with a filename, i.e., -F <format>:<file>, write a further
+				// output in that format; may be repeated.
+				if(!parse_out_spec(iargs, optarg))
+				{
+					errorFlag++;
+				}
+				break;
+			case 'J':
+				// write the counters and timings of the run as JSON to the
+				// given file at exit and whenever SIGUSR1 is received.
+				iargs->stats_fname = optarg;
+				break;
+			case 'z':
+				// drop lines repeated verbatim before parsing them, with a set
+				// of fingerprints of the given size in MB.
+				if(!parse_count(opt, optarg, "a size in MB",
+							&iargs->prefilter_size))
+				{
+					errorFlag++;
+				}
+				break;
+			case 'j':
+				// threads to run on; 1 by default and 0 for one per core.
+				if(!parse_count(opt, optarg, "a count of threads",
+							&iargs->jobs))
+				{
+					errorFlag++;
+				}
+				break;
 			case 'x':
-				// default will export to the binary format unless -o is omitted
-				// and then stdout is used and only plaintext output.
-				// or reverse this: default is plaintext. and the fancy programs
-				// will specify binary when it is in control to output to the
-				// protected location.
+				// write the de-duplicated output of -D to the binary index
+				// format. when -o is omitted, stdout is used and the output
+				// remains plain text.
 				iargs->export_binary_fmt = true;
 				break;
 			case 'o':
@@ -325,12 +394,24 @@ static bool do_parse_input_args(int argc, char * const* argv,
 			case '?':
 			default:
 				ELOG_IFARGS(iargs, "Usage: %s "
-						"[-vstb] "
+						"[-vst] "
+						"[-b <MB>] "
 						"[-L <log file>] "
 						"[-E <errlog file>] "
+						"[-C <cache directory>] "
+						"[-J <stats file>] "
+						"[-z <MB>] "
+						"[-j <threads>] "
 						"[-i <NUMBER>] "
 						"[-r <NUMBER>] "
-						"[-D <filename>|<directory>] "
+						"[-D [-e] [-x|-P <ext>] [-F <format>[:<file>] ...] <filename>|<directory>] "
+						"[-U <index> <filename>|<directory>] "
+						"[-Q <queries> <filename>|<directory>] "
+						"[-R <socket> [<file>|<directory> ...]] "
+						"[-N <file1>|<directory1> <file2>|<directory2> ...] "
+						"[-S intersect|minus|symdiff|delta] "
+						"[-A <delta> <file>|<directory>] "
+						"[-T <base> <ours> <theirs>] "
 						"[<file1>|<directory1>, <file2>|<directory2>] "
 						"[-o <filename.out>] "
 						"\n", argv[0]);
@@ -346,12 +427,16 @@ static bool do_parse_input_args(int argc, char * const* argv,
 
 	if(iargs->log_flag)
 	{
-		if(!open_logfile(iargs))
+		// the log is written from a buffer later on; fail now rather than
+		// at the first write when it cannot be opened.
+		FILE *log_file = fopen(iargs->log_fname, "ab");
+		if(!log_file)
 		{
+			fprintf(stderr, "ERROR: Unable to open %s for append writing.\n", iargs->log_fname);
 			errorFlag++;
 			return false;
 		}
-		close_logfile(iargs);
+		fclose(log_file);
 
 		struct stat s;
 		if(stat(iargs->log_fname, &s) == 0)
@@ -369,17 +454,11 @@ static bool do_parse_input_args(int argc, char * const* argv,
 			errorFlag++;
 			return false;
 		}
-
-		global_stdLog = calloc(1, sizeof(globalLog_t));
-		CHECK_MALLOC(global_stdLog);
-		global_stdLog->log_fname = iargs->log_fname;
 	}
 
 	if(iargs->errLog_flag)
 	{
-		global_errLog = calloc(1, sizeof(globalLog_t));
-		CHECK_MALLOC(global_errLog);
-		global_errLog->log_fname = iargs->errLog_fname;
+		pfb_log_open(PFB_LOG_ERR, iargs->errLog_fname);
 	}
 
 #ifdef BUILD_TESTS
@@ -576,10 +655,12 @@ static void paths_list_add(paths_list_t list[static 1], const char* path,
 
 	// TODO toggle use_mem_buffer here
 	list->paths[list->len].use_mem_buffer = false;
+	list->paths[list->len].is_index = pfb_is_index_file(path);
 	list->paths[list->len].path = pfb_strdup(path);
 	list->paths[list->len].pfb_s.file_size = s->st_size;
 	list->paths[list->len].pfb_s.st_dev = s->st_dev;
 	list->paths[list->len].pfb_s.st_ino = s->st_ino;
+	list->paths[list->len].pfb_s.mtime = s->st_mtime;
 	DEBUG_PRINTF("entry[%d]=%s\n", list->len, list->paths[list->len].path);
 	list->len++;
 }
@@ -612,6 +693,11 @@ static void read_argv_path_append(const pfb_stat_t pfb_s,
 			{
 				ELOG_STDERR("WARNING: IGNORING input %s which is identical to the output path\n", argv);
 			}
+			else if(pfb_is_index_file(argv))
+			{
+				DEBUG_PRINTF("adding index %s to the list\n", argv);
+				paths_list_add(pl, argv, &s);
+			}
 			else
 			{
 				FILE *f = fopen(argv, "rb");
@@ -707,6 +793,18 @@ static void read_argv_path_append(const pfb_stat_t pfb_s,
 	}
 }
 
+/**
+ * Collect the readable files at 'path', a file or a directory, the same as
+ * for an input set given on the command line. The list is empty if there are
+ * none.
+ */
+paths_list_t read_input_paths(const char path[static 1])
+{
+	paths_list_t pl = create_paths_list(2);
+	read_argv_path_append((pfb_stat_t){}, path, &pl);
+	return pl;
+}
+
 static void read_argv_path(const char *const argv, paths_list_t pl[static 1])
 {
 	ASSERT(pl);
@@ -745,7 +843,113 @@ bool parse_input_args(int argc, char *const * argv, input_args_t iargs[static 1]
 	// will diff two sets of inputs and generate that diff. it can optionally
 	// store de-duplicated sets of inputs for future diffing.
 
-	if(iargs->deduplicate_mode)
+	const bool apply_mode = iargs->delta_fname != nullptr;
+	const bool update_mode = iargs->update_fname != nullptr;
+	const bool serve_mode = iargs->socket_fname != nullptr;
+	const bool query_mode = iargs->query_fname != nullptr;
+	if(iargs->export_binary_fmt && !iargs->deduplicate_mode)
+	{
+		ELOG_STDERR("ERROR: -x applies only to the de-duplicated output of -D\n");
+		return false;
+	}
+
+	if(iargs->out_ext && !iargs->deduplicate_mode)
+	{
+		ELOG_STDERR("ERROR: -P applies only to the de-duplicated output of -D\n");
+		return false;
+	}
+
+	if(iargs->out_ext && (iargs->write_to_output_file || iargs->export_binary_fmt))
+	{
+		ELOG_STDERR("ERROR: -P writes one output per input; it excludes -o and -x\n");
+		return false;
+	}
+
+	if(iargs->external_mode && !iargs->deduplicate_mode)
+	{
+		ELOG_STDERR("ERROR: -e applies only to the de-duplicated output of -D\n");
+		return false;
+	}
+
+	if(iargs->external_mode && (iargs->export_binary_fmt || iargs->out_ext))
+	{
+		ELOG_STDERR("ERROR: -e streams plain text to one output; it excludes -x and -P\n");
+		return false;
+	}
+
+	const bool format_mode = iargs->out_format != PFB_FORMAT_ADBPLUS ||
+		iargs->num_out_specs > 0;
+	if(format_mode && (!iargs->deduplicate_mode || iargs->export_binary_fmt ||
+				iargs->out_ext || iargs->external_mode))
+	{
+		ELOG_STDERR("ERROR: -F applies only to the de-duplicated output of -D; it excludes -e, -x, and -P\n");
+		return false;
+	}
+
+	if(iargs->cache_dir && (update_mode || iargs->out_ext))
+	{
+		ELOG_STDERR("ERROR: -C does not apply to -P or -U\n");
+		return false;
+	}
+
+	if(iargs->export_binary_fmt && !iargs->write_to_output_file)
+	{
+		LOG_IFARGS(iargs, "NOTICE: option -x is ignored when writing to stdout; the output is plain text.\n");
+		iargs->export_binary_fmt = false;
+	}
+
+	if(iargs->deduplicate_mode + iargs->overlap_mode + iargs->threeway_mode +
+			apply_mode + update_mode + serve_mode + query_mode > 1)
+	{
+		ELOG_STDERR("ERROR: -A, -D, -N, -Q, -R, -T, and -U are mutually exclusive\n");
+		return false;
+	}
+
+	if(iargs->diff_output != DIFF_REPORT &&
+			(iargs->deduplicate_mode || iargs->overlap_mode ||
+			 iargs->threeway_mode || apply_mode || update_mode || serve_mode ||
+			 query_mode))
+	{
+		ELOG_STDERR("ERROR: -S applies only to the difference of two inputs\n");
+		return false;
+	}
+
+	if(iargs->overlap_mode)
+	{
+		DEBUG_PRINTF("overlap mode\n");
+		DEBUG_PRINTF("remaining args count=%d\n", remainder);
+		if(remainder < 2)
+		{
+			ELOG_STDERR("ERROR: expecting at least two path arguments\n");
+			return false;
+		}
+	}
+	else if(serve_mode)
+	{
+		DEBUG_PRINTF("serve mode\n");
+		DEBUG_PRINTF("remaining args count=%d\n", remainder);
+	}
+	else if(apply_mode)
+	{
+		DEBUG_PRINTF("apply mode\n");
+		DEBUG_PRINTF("remaining args count=%d\n", remainder);
+		if(remainder != 1)
+		{
+			ELOG_STDERR("ERROR: expecting exactly one path argument to apply the delta to\n");
+			return false;
+		}
+	}
+	else if(iargs->threeway_mode)
+	{
+		DEBUG_PRINTF("three-way mode\n");
+		DEBUG_PRINTF("remaining args count=%d\n", remainder);
+		if(remainder != 3)
+		{
+			ELOG_STDERR("ERROR: expecting exactly three path arguments: base, ours, theirs\n");
+			return false;
+		}
+	}
+	else if(iargs->deduplicate_mode || update_mode || query_mode)
 	{
 		DEBUG_PRINTF("dedup mode\n");
 		DEBUG_PRINTF("remaining args count=%d\n", remainder);
@@ -766,6 +970,13 @@ bool parse_input_args(int argc, char *const * argv, input_args_t iargs[static 1]
 		}
 	}
 
+	if(update_mode && !iargs->write_to_output_file)
+	{
+		// the index is rewritten in place.
+		iargs->write_to_output_file = true;
+		iargs->output_filename = iargs->update_fname;
+	}
+
 	// read ascii plain text input and write a de-duplicated sorted output.
 	//
 	// has a binary header containing a version number, size of file without the
@@ -804,7 +1015,29 @@ bool parse_input_args(int argc, char *const * argv, input_args_t iargs[static 1]
 		}
 	}
 
-	if(iargs->deduplicate_mode)
+	if(iargs->overlap_mode || iargs->threeway_mode || apply_mode || serve_mode)
+	{
+		ASSERT(remainder >= 1 || serve_mode);
+		iargs->num_sets = remainder;
+		iargs->input_sets_names = argv + optind;
+		iargs->input_paths_sets = calloc(MAX(remainder, 1), sizeof(paths_list_t));
+		CHECK_MALLOC(iargs->input_paths_sets);
+
+		// unlike the diff mode, each set may be a directory of files which are
+		// de-duplicated together as one set.
+		for(int i = 0; i < remainder; i++)
+		{
+			iargs->input_paths_sets[i] = create_paths_list(2);
+			read_argv_path_append(output_path_info.pfb_s, argv[optind + i],
+					&iargs->input_paths_sets[i]);
+			if(iargs->input_paths_sets[i].len == 0)
+			{
+				ELOG_STDERR("ERROR: no readable input in %s\n", argv[optind + i]);
+				return false;
+			}
+		}
+	}
+	else if(iargs->deduplicate_mode || update_mode || query_mode)
 	{
 		ASSERT(remainder > 0);
 		// have to take the args determine if directory or file and add all
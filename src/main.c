@@ -32,7 +32,25 @@
 #include "pfb_prune.h"
 #include "rw_pfb_csv.h"
 #include "pfb_differ.h"
+#include "pfb_overlap.h"
+#include "pfb_delta.h"
+#include "pfb_index.h"
+#include "pfb_update.h"
+#include "pfb_daemon.h"
+#include "pfb_query.h"
+#include "pfb_perfile.h"
+#include "pfb_cache.h"
+#include "pfb_external.h"
+#include "pfb_allow.h"
+#include "pfb_format.h"
+#include "adbplusline.h"
+#include "pfb_memory.h"
+#include "pfb_pool.h"
+#include "pfb_prefilter.h"
+#include "pfb_stats.h"
+#include "tld_sharded_context.h"
 #include <time.h>
+#include <sys/resource.h>
 
 // when this is used, the line_info_t array on LiteLineData_t is allocated to
 // hold the entire set of line_info_t.
@@ -59,45 +77,262 @@ static void collect_litelines(PortLineData_t const *const pld,
 	litelines->used++;
 }
 
+static pfb_out_buffer_t create_out_buffer()
+{
+	const uint out_buffer_size = 4096;
+	pfb_out_buffer_t ret = {
+		.buffer = malloc(out_buffer_size),
+		.alloc_len = out_buffer_size,
+		.next_idx = 0,
+		.litelines = {},
+	};
+	CHECK_MALLOC(ret.buffer);
+	return ret;
+}
+
+static bool has_index_path(paths_list_t in_paths_list)
+{
+	for(uint i = 0; i < in_paths_list.len; i++)
+	{
+		if(in_paths_list.paths[i].is_index)
+			return true;
+	}
+	return false;
+}
+
 /**
- * de-duplicate, sort, and write the final adlist to the specified output
- * context.
- *
- * this will eventually support reading inputs that have been sorted alongside
- * raw unsorted inputs.
+ * de-duplicate and sort one set of inputs into the given in-memory buffer.
+ * Plain text inputs always load; returns true.
  */
-static void sort_adbplus_adlists(TLD_implementation_t tld_impl,
-		pfb_context_collect_t in_pcc[static 1], bool include_carry_over)
+static bool sort_adbplus_adlists_BUFFER(paths_list_t in_paths_list,
+		pfb_out_buffer_t out_buffer[static 1])
 {
+	*out_buffer = create_out_buffer();
+
+	pfb_context_collect_t pcc = pfb_init_contexts_BUFFER(in_paths_list,
+			out_buffer);
+
+	TLD_implementation_t tld_impl = create_tld_hash_impl();
 	ASSERT(tld_impl.context);
 
-	// in a world where many more file handles are involved than can be opened
-	// simultaneously... opening what is necessary and closing afterwards makes
-	// sense.
-	pfb_open_contexts(&in_pcc->in_contexts);
+	sort_adbplus_adlists(tld_impl, &pcc, false);
+
+	pfb_free_context_collect(&pcc);
+	ASSERT(pcc.out_context.out_buffer == nullptr);
+
+	free_tld_impl(&tld_impl);
+	ASSERT(!tld_impl.context);
+	return true;
+}
+
+/**
+ * de-duplicate and sort one set of inputs into the given in-memory buffer. a
+ * set holding a single binary index is mapped as-is without parsing. indexes
+ * in a larger set are merged with the de-duplicated plain text inputs.
+ * Returns false, leaving nothing in 'out_buffer' to free, if an index cannot
+ * be used; the resident server answers that rather than exit.
+ */
+static bool load_adbplus_adlists_BUFFER(paths_list_t in_paths_list,
+		pfb_out_buffer_t out_buffer[static 1])
+{
+	if(!has_index_path(in_paths_list))
+	{
+		return sort_adbplus_adlists_BUFFER(in_paths_list, out_buffer);
+	}
+
+	if(in_paths_list.len == 1)
+	{
+		return pfb_map_index(in_paths_list.paths[0].path, out_buffer);
+	}
+
+	// one buffer per index plus one for all plain text inputs together.
+	pfb_out_buffer_t *sets = calloc(in_paths_list.len, sizeof(pfb_out_buffer_t));
+	CHECK_MALLOC(sets);
+	pfb_out_buffer_t **in = calloc(in_paths_list.len, sizeof(pfb_out_buffer_t*));
+	CHECK_MALLOC(in);
+	// shallow copy; the paths remain owned by in_paths_list.
+	paths_list_t text_paths = {
+		.paths = calloc(in_paths_list.len, sizeof(path_info_t)),
+		.len = 0,
+		.alloced = in_paths_list.len,
+	};
+	CHECK_MALLOC(text_paths.paths);
+
+	uint used = 0;
+	for(uint i = 0; i < in_paths_list.len; i++)
+	{
+		if(!in_paths_list.paths[i].is_index)
+		{
+			text_paths.paths[text_paths.len++] = in_paths_list.paths[i];
+		}
+		else if(pfb_map_index(in_paths_list.paths[i].path, &sets[used]))
+		{
+			in[used] = &sets[used];
+			used++;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if(used + text_paths.len < in_paths_list.len)
+	{
+		for(uint i = 0; i < used; i++)
+		{
+			pfb_free_out_buffer(&sets[i]);
+		}
+		free(text_paths.paths);
+		free(in);
+		free(sets);
+		return false;
+	}
+
+	if(text_paths.len > 0)
+	{
+		sort_adbplus_adlists_BUFFER(text_paths, &sets[used]);
+		in[used] = &sets[used];
+		used++;
+	}
+	free(text_paths.paths);
+
+	*out_buffer = create_out_buffer();
+	pfb_out_context_t out_context = pfb_init_out_context_BUFFER(out_buffer);
+	union_adbplus_adlists_BUFFER(in, used, &out_context);
+
+	for(uint i = 0; i < used; i++)
+	{
+		pfb_free_out_buffer(&sets[i]);
+	}
+	free(in);
+	free(sets);
+	return true;
+}
+
+/**
+ * The tree for de-duplicating 'in_paths_list'. With -j, several inputs are
+ * read at once into a tree sharded by TLD; a single thread keeps the plain
+ * hash of TLDs with no locks.
+ */
+static TLD_implementation_t create_tld_impl_for(paths_list_t in_paths_list)
+{
+	if(pfb_pool_threads() > 1 && in_paths_list.len > 1)
+	{
+		return create_tld_sharded_impl();
+	}
+	return create_tld_hash_impl();
+}
+
+/**
+ * One set of inputs to de-duplicate and sort on the pool. The contexts are
+ * freed as soon as the set is written, as they were before the sets were
+ * sorted at once.
+ */
+typedef struct sort_job
+{
+	TLD_implementation_t tld_impl;
+	pfb_context_collect_t *pcc;
+	size_t count;
+} sort_job_t;
+
+static void sort_job(void *arg)
+{
+	sort_job_t *job = arg;
+	sort_adbplus_adlists(job->tld_impl, job->pcc, false);
+	job->count = job->pcc->out_context.counter;
+	pfb_free_context_collect(job->pcc);
+}
+
+typedef struct load_job
+{
+	paths_list_t in_paths_list;
+	pfb_out_buffer_t *out_buffer;
+	bool loaded;
+} load_job_t;
 
-	// open the files to verify all files can be read. open output file to
-	// verify those can be written.
-	pfb_read_all(tld_impl, &in_pcc->in_contexts);
+static void load_job(void *arg)
+{
+	load_job_t *job = arg;
+	job->loaded = load_adbplus_adlists_BUFFER(job->in_paths_list,
+			job->out_buffer);
+}
 
-	// append mode: if writing header and comments and regexes outside of this
-	// area, then it needs to be true(?) otherwise it's always create a new
-	// file.
-	pfb_open_out_context(&in_pcc->out_context, false);
+/**
+ * replace the plain text inputs of every set with their cached runs.
+ */
+static bool cache_input_paths(input_args_t flags[static 1])
+{
+	if(!pfb_cache_inputs(flags->cache_dir, &flags->input_paths_A,
+				sort_adbplus_adlists_BUFFER) ||
+			!pfb_cache_inputs(flags->cache_dir, &flags->input_paths_B,
+				sort_adbplus_adlists_BUFFER))
+	{
+		return false;
+	}
 
-	// one input context means the carry over can be written to the output
-	// context. when multiple inputs are independently de-duplicated, this would
-	// have multiple input contexts to deal with paired with a single output
-	// context.
-	if(include_carry_over)
+	for(uint i = 0; i < flags->num_sets; i++)
 	{
-		pfb_write_carry_over(in_pcc);
+		if(!pfb_cache_inputs(flags->cache_dir, &flags->input_paths_sets[i],
+					sort_adbplus_adlists_BUFFER))
+		{
+			return false;
+		}
 	}
+	return true;
+}
 
-	pfb_consolidate(tld_impl, &in_pcc->out_context);
+/**
+ * true if a tree of the plain text inputs is expected to fit the memory
+ * budget. indexes are mapped and not counted.
+ */
+static bool fits_in_memory(paths_list_t in_paths_list)
+{
+	size_t text_size = 0;
+	for(uint i = 0; i < in_paths_list.len; i++)
+	{
+		if(!in_paths_list.paths[i].is_index)
+		{
+			text_size += in_paths_list.paths[i].pfb_s.file_size;
+		}
+	}
+	return pfb_mem_fits(text_size * PFB_EXTERNAL_TREE_FACTOR);
+}
+
+/**
+ * Open the further outputs given by -F, chained to one another, or return
+ * nullptr if there are none. Exits if one cannot be opened.
+ */
+static pfb_out_context_t *open_format_outputs(input_args_t flags[static 1])
+{
+	if(flags->num_out_specs == 0)
+	{
+		return nullptr;
+	}
+
+	pfb_out_context_t *outs = calloc(flags->num_out_specs,
+			sizeof(pfb_out_context_t));
+	CHECK_MALLOC(outs);
+	for(uint i = 0; i < flags->num_out_specs; i++)
+	{
+		outs[i] = pfb_init_out_context(flags->out_specs[i].fname);
+		outs[i].format = flags->out_specs[i].format;
+		outs[i].next = i + 1 < flags->num_out_specs ? &outs[i + 1] : nullptr;
+		pfb_open_out_context(&outs[i], false);
+		if(!outs[i].out_file)
+		{
+			exit(EXIT_FAILURE);
+		}
+	}
+	return outs;
+}
 
-	pfb_close_contexts(&in_pcc->in_contexts);
-	pfb_close_out_context(&in_pcc->out_context);
+static void free_format_outputs(pfb_out_context_t *outs)
+{
+	for(pfb_out_context_t *c = outs; c; c = c->next)
+	{
+		pfb_free_out_context(c);
+	}
+	free(outs);
 }
 
 static void free_litelines(LiteLineData_t c[static 1])
@@ -210,35 +445,294 @@ int main(int argc, char *const * argv)
 		exit(EXIT_FAILURE);
 	}
 
-	if(!silent_mode(&flags))
-	{
-		open_logfile(&flags);
-		fprintf(get_logFile(&flags), "Prune duplicate entries from the following files:\n");
-		//for(size_t i = 0; i < flags.num_files; i++)
-		{
-			//fprintf(get_logFile(&flags), "  %s\n", flags.filenames[i]);
-		}
-
-		close_logfile(&flags);
-	}
+	LOG_IFARGS(&flags, "Prune duplicate entries from the following files:\n");
 
 #ifdef BUILD_TESTS
 	if(flags.runtests)
 	{
 		extern void run_tests();
 		run_tests();
-		free_globalErrLog();
+		pfb_log_close();
 		return 0;
 	}
 #endif
 
-	if(flags.deduplicate_mode)
+	if(flags.stats_fname && !pfb_stats_open(flags.stats_fname))
+	{
+		free_input_args(&flags);
+		exit(EXIT_FAILURE);
+	}
+
+	if(flags.in_memory_buffer_size > 0)
+	{
+		pfb_mem_set_budget((size_t)flags.in_memory_buffer_size << 20);
+	}
+	pfb_pool_start(flags.jobs);
+
+	if(flags.prefilter_size > 0)
+	{
+		pfb_prefilter_set_size((size_t)flags.prefilter_size << 20);
+	}
+	const bool report_memory = flags.in_memory_buffer_size > 0 &&
+		!silent_mode(&flags);
+
+	if(flags.cache_dir && !cache_input_paths(&flags))
+	{
+		free_input_args(&flags);
+		exit(EXIT_FAILURE);
+	}
+
+	if(flags.deduplicate_mode && !flags.external_mode &&
+			!flags.export_binary_fmt && !flags.out_ext &&
+			flags.out_format == PFB_FORMAT_ADBPLUS && flags.num_out_specs == 0 &&
+			!fits_in_memory(flags.input_paths_list))
+	{
+		// said even with -s; the run then takes temporary space on disk.
+		ELOG_STDERR("NOTICE: the inputs exceed the memory budget; de-duplicating in sorted runs on disk as with -e\n");
+		flags.external_mode = true;
+	}
+
+	if(flags.overlap_mode || flags.threeway_mode || flags.delta_fname)
+	{
+		// each set is de-duplicated once into memory; a single k-way merge
+		// over all of them replaces a diff of every pair.
+		const bool threeway_mode = flags.threeway_mode;
+		const uint num_sets = flags.num_sets;
+		char *const *names = flags.input_sets_names;
+
+		FILE *delta = nullptr;
+		if(flags.delta_fname)
+		{
+			delta = fopen(flags.delta_fname, "rb");
+			if(!delta)
+			{
+				ELOG_STDERR("ERROR: failed to open delta %s for reading\n",
+						flags.delta_fname);
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		pfb_out_buffer_t *sets = calloc(num_sets, sizeof(pfb_out_buffer_t));
+		CHECK_MALLOC(sets);
+		pfb_out_buffer_t **in = calloc(num_sets, sizeof(pfb_out_buffer_t*));
+		CHECK_MALLOC(in);
+
+		load_job_t *loads = calloc(num_sets, sizeof(load_job_t));
+		CHECK_MALLOC(loads);
+		for(uint i = 0; i < num_sets; i++)
+		{
+			loads[i] = (load_job_t){flags.input_paths_sets[i], &sets[i], false};
+			in[i] = &sets[i];
+		}
+		// the sets share nothing; with -j they are loaded at once.
+		pfb_pool_for(load_job, loads, sizeof(load_job_t), num_sets);
+		for(uint i = 0; i < num_sets; i++)
+		{
+			if(!loads[i].loaded)
+			{
+				exit(EXIT_FAILURE);
+			}
+		}
+		free(loads);
+
+		pfb_out_context_t out_merge = pfb_init_out_context(flags.output_filename);
+
+		free_input_args(&flags);
+
+		pfb_open_out_context(&out_merge, false);
+
+		if(delta)
+		{
+			ASSERT(num_sets == 1);
+			pfb_apply_delta_BUFFER(in[0], delta, &out_merge);
+			fclose(delta);
+		}
+		else if(threeway_mode)
+		{
+			ASSERT(num_sets == 3);
+			merge3_adbplus_adlists_BUFFER(in[0], in[1], in[2], &out_merge);
+		}
+		else
+		{
+			overlap_adbplus_adlists_BUFFER(in, (char const *const *)names,
+					num_sets, &out_merge);
+		}
+
+		pfb_free_out_context(&out_merge);
+
+		for(uint i = 0; i < num_sets; i++)
+		{
+			pfb_free_out_buffer(&sets[i]);
+		}
+		free(in);
+		free(sets);
+	}
+	else if(flags.socket_fname)
+	{
+		// the lists stay resident; every request is answered from memory.
+		const bool ok = pfb_serve(flags.socket_fname, flags.input_paths_sets,
+				(char const *const *)flags.input_sets_names, flags.num_sets,
+				load_adbplus_adlists_BUFFER);
+
+		free_input_args(&flags);
+
+		if(!ok)
+		{
+			exit(EXIT_FAILURE);
+		}
+	}
+	else if(flags.update_fname)
+	{
+		// only the inputs that changed since the index was written are
+		// de-duplicated; each on its own so the index can tell them apart.
+		const bool ok = pfb_update_index(flags.update_fname,
+				flags.input_paths_list, flags.output_filename,
+				load_adbplus_adlists_BUFFER);
+
+		free_input_args(&flags);
+
+		if(!ok)
+		{
+			exit(EXIT_FAILURE);
+		}
+	}
+	else if(flags.query_fname)
+	{
+		// the lists are held in a tree; the queries are looked up in batches.
+		const bool ok = pfb_query_adlists(flags.query_fname,
+				flags.input_paths_list, flags.output_filename,
+				load_adbplus_adlists_BUFFER);
+
+		free_input_args(&flags);
+
+		if(!ok)
+		{
+			exit(EXIT_FAILURE);
+		}
+	}
+	else if(flags.deduplicate_mode && flags.out_ext)
+	{
+		// each input is its own set; the inputs are tasks of the pool.
+		const bool ok = pfb_dedup_each_file(flags.input_paths_list,
+				flags.out_ext);
+
+		free_input_args(&flags);
+
+		if(!ok)
+		{
+			exit(EXIT_FAILURE);
+		}
+	}
+	else if(flags.deduplicate_mode && flags.external_mode)
+	{
+		// sorted runs of bounded size are spilled to disk and merged.
+		const bool ok = pfb_dedup_external(flags.input_paths_list,
+				flags.output_filename, flags.in_memory_buffer_size > 0 ?
+				flags.in_memory_buffer_size : PFB_EXTERNAL_DEFAULT_MB);
+
+		free_input_args(&flags);
+
+		if(!ok)
+		{
+			exit(EXIT_FAILURE);
+		}
+	}
+	else if(flags.deduplicate_mode && has_index_path(flags.input_paths_list))
+	{
+		// the indexes are already de-duplicated and sorted; only the plain
+		// text inputs are parsed and inserted into a tree.
+		pfb_out_buffer_t sorted;
+		if(!load_adbplus_adlists_BUFFER(flags.input_paths_list, &sorted))
+		{
+			exit(EXIT_FAILURE);
+		}
+
+		pfb_out_context_t out_context = pfb_init_out_context(flags.output_filename);
+		out_context.format = flags.out_format;
+		out_context.next = open_format_outputs(&flags);
+		const bool export_binary_fmt = flags.export_binary_fmt;
+
+		free_input_args(&flags);
+
+		pfb_open_out_context(&out_context, false);
+		if(export_binary_fmt)
+		{
+			pfb_write_index(out_context.out_file, &sorted);
+		}
+		else
+		{
+			// the entries are already subtracted from; the exceptions within
+			// a MATCH_FULL entry follow it as they do for plain text inputs.
+			pfb_allow_t allow = pfb_init_allow(true);
+			pfb_insert_allowed(&allow, sorted.allowed, sorted.allowed_len);
+			if(allow.count > 0)
+			{
+				out_context.allow = &allow;
+			}
+
+			pfb_write_format_headers(&out_context);
+			for(size_len_t i = 0; i < sorted.litelines.used; i++)
+			{
+				const char *line = sorted.buffer + sorted.litelines.li[i].offset;
+				const line_len_t line_len = sorted.litelines.li[i].line_len;
+				AdbplusView_t lv;
+				parse_adbplus_line(&lv, line);
+				if(out_context.allow)
+				{
+					pfb_write_allowed(&out_context, line, line_len, lv.ms);
+				}
+				else
+				{
+					pfb_write_formatted(&out_context, line, line_len, lv.ms);
+				}
+			}
+
+			out_context.allow = nullptr;
+			pfb_free_allow(&allow);
+		}
+		free_format_outputs(out_context.next);
+		pfb_free_out_context(&out_context);
+		pfb_free_out_buffer(&sorted);
+	}
+	else if(flags.deduplicate_mode && flags.export_binary_fmt)
+	{
+		TLD_implementation_t tld_impl = create_tld_impl_for(
+				flags.input_paths_list);
+		ASSERT(tld_impl.context);
+
+		// collect the entries in memory; pfb_consolidate() writes them to the
+		// index file once the tree is flattened.
+		pfb_out_buffer_t sorted = create_out_buffer();
+		pfb_context_collect_t pcc = pfb_init_contexts_BUFFER(flags.input_paths_list,
+				&sorted);
+		pfb_out_context_t out_index = pfb_init_out_context(flags.output_filename);
+
+		free_input_args(&flags);
+
+		pfb_open_out_context(&out_index, false);
+		pcc.out_context.index_file = out_index.out_file;
+
+		sort_adbplus_adlists(tld_impl, &pcc, false);
+
+		pfb_free_context_collect(&pcc);
+		pfb_free_out_context(&out_index);
+		pfb_free_out_buffer(&sorted);
+
+		free_tld_impl(&tld_impl);
+		ASSERT(!tld_impl.context);
+	}
+	else if(flags.deduplicate_mode)
 	{
-		TLD_implementation_t tld_impl = create_tld_hash_impl();
+		TLD_implementation_t tld_impl = create_tld_impl_for(
+				flags.input_paths_list);
 		ASSERT(tld_impl.context);
 
 		pfb_context_collect_t pcc = pfb_init_contexts(flags.input_paths_list,
 				flags.output_filename);
+		// the outputs of -F are written in the same pass over the tree.
+		pcc.out_context.format = flags.out_format;
+		pfb_out_context_t *format_outputs = open_format_outputs(&flags);
+		pcc.out_context.next = format_outputs;
 
 		free_input_args(&flags);
 
@@ -247,6 +741,7 @@ int main(int argc, char *const * argv)
 		sort_adbplus_adlists(tld_impl, &pcc, true);
 
 		pfb_free_context_collect(&pcc);
+		free_format_outputs(format_outputs);
 
 		ASSERT(!pcc.in_contexts.begin_context);
 		ASSERT(!pcc.in_contexts.end_context);
@@ -254,6 +749,34 @@ int main(int argc, char *const * argv)
 		free_tld_impl(&tld_impl);
 		ASSERT(!tld_impl.context);
 	}
+	else if(has_index_path(flags.input_paths_A) ||
+			has_index_path(flags.input_paths_B))
+	{
+		// an index is mapped as-is; only a plain text side is de-duplicated.
+		pfb_out_buffer_t sortedA;
+		pfb_out_buffer_t sortedB;
+		load_job_t loads[2] = {
+			{flags.input_paths_A, &sortedA, false},
+			{flags.input_paths_B, &sortedB, false},
+		};
+		pfb_pool_for(load_job, loads, sizeof(load_job_t), 2);
+		if(!loads[0].loaded || !loads[1].loaded)
+		{
+			exit(EXIT_FAILURE);
+		}
+
+		pfb_out_context_t out_AvsB = pfb_init_out_context(flags.output_filename);
+		const enum diff_output diff_output = flags.diff_output;
+
+		free_input_args(&flags);
+
+		pfb_open_out_context(&out_AvsB, false);
+		diff_adbplus_adlists_BUFFER(&sortedA, &sortedB, &out_AvsB, diff_output);
+
+		pfb_free_out_context(&out_AvsB);
+		pfb_free_out_buffer(&sortedA);
+		pfb_free_out_buffer(&sortedB);
+	}
 	else if(!flags.in_memory_mode) // if use temp files
 	{
 		// temporary files to hold the deduplicated and sorted output of the two
@@ -272,35 +795,29 @@ int main(int argc, char *const * argv)
 		// final output context created with the specified output filename. when
 		// output filename is nullptr, it falls back to stdout.
 		pfb_out_context_t out_AvsB = pfb_init_out_context(flags.output_filename);
+		const enum diff_output diff_output = flags.diff_output;
 
 		// now safe to free the input arguments
 		free_input_args(&flags);
 
-		TLD_implementation_t tld_implA = create_tld_hash_impl();
-		ASSERT(tld_implA.context);
-
-		// deduplicate and sort set A; write to temporary file tmpA.
-		sort_adbplus_adlists(tld_implA, &pccA, false);
-		const size_t pccA_count = pccA.out_context.counter;
-		UNUSED(pccA_count);
-		pfb_free_context_collect(&pccA);
+		// deduplicate and sort set A to temporary file tmpA and set B to tmpB.
+		// the two share nothing; with -j they are sorted at once.
+		sort_job_t jobs[2] = {
+			{.tld_impl = create_tld_hash_impl(), .pcc = &pccA},
+			{.tld_impl = create_tld_hash_impl(), .pcc = &pccB},
+		};
+		ASSERT(jobs[0].tld_impl.context);
+		ASSERT(jobs[1].tld_impl.context);
+		pfb_pool_for(sort_job, jobs, sizeof(sort_job_t), 2);
+		const size_t pccA_count = jobs[0].count;
+		const size_t pccB_count = jobs[1].count;
 		DEBUG_PRINTF("pccA count=%lu\n", pccA_count);
-
-		TLD_implementation_t tld_implB = create_tld_hash_impl();
-		ASSERT(tld_implB.context);
-
-		// deduplicate and sort set B; write to temporary file tmpB.
-		sort_adbplus_adlists(tld_implB, &pccB, false);
-
-		const size_t pccB_count = pccB.out_context.counter;
-		UNUSED(pccB_count);
-		pfb_free_context_collect(&pccB);
 		DEBUG_PRINTF("pccB count=%lu\n", pccB_count);
 
-		free_tld_impl(&tld_implA);
-		free_tld_impl(&tld_implB);
-		ASSERT(!tld_implA.context);
-		ASSERT(!tld_implB.context);
+		free_tld_impl(&jobs[0].tld_impl);
+		free_tld_impl(&jobs[1].tld_impl);
+		ASSERT(!jobs[0].tld_impl.context);
+		ASSERT(!jobs[1].tld_impl.context);
 
 		// output of the above is the number of domains - this gives a chance to
 		// allocate ahead of time an array for the collection of line/offsets to
@@ -354,7 +871,8 @@ int main(int argc, char *const * argv)
 
 		// diff the final output of the two input sets. the output of this is to
 		// the FILE specified by the output context.
-		diff_adbplus_adlists_FILE(&in_A, &litelines_A, &in_B, &litelines_B, &out_AvsB);
+		diff_adbplus_adlists_FILE(&in_A, &litelines_A, &in_B, &litelines_B, &out_AvsB,
+				diff_output);
 
 		free_litelines(&litelines_A);
 		free_litelines(&litelines_B);
@@ -398,15 +916,24 @@ int main(int argc, char *const * argv)
 		// final output context created with the specified output filename. when
 		// output filename is nullptr, it falls back to stdout.
 		pfb_out_context_t out_AvsB = pfb_init_out_context(flags.output_filename);
+		const enum diff_output diff_output = flags.diff_output;
 
 		// now safe to free the input arguments
 		free_input_args(&flags);
 
-		TLD_implementation_t tld_implA = create_tld_hash_impl();
-		ASSERT(tld_implA.context);
+		// deduplicate and sort set A to in-memory buffer tmpA and set B to
+		// tmpB. separate implementations; after de-dup and sort, they're
+		// dangling pointers. TODO fix dangling pointer issue.
+		sort_job_t jobs[2] = {
+			{.tld_impl = create_tld_hash_impl(), .pcc = &pccA},
+			{.tld_impl = create_tld_hash_impl(), .pcc = &pccB},
+		};
+		ASSERT(jobs[0].tld_impl.context);
+		ASSERT(jobs[1].tld_impl.context);
+		pfb_pool_for(sort_job, jobs, sizeof(sort_job_t), 2);
+		ASSERT(pccA.out_context.out_buffer == nullptr);
+		ASSERT(pccB.out_context.out_buffer == nullptr);
 
-		// deduplicate and sort set A; write to in-memory buffer tmpA.
-		sort_adbplus_adlists(tld_implA, &pccA, false);
 		ASSERT(tmpA.litelines.li);
 		ASSERT(tmpA.litelines.alloc > 0);
 		ASSERT(tmpA.litelines.used > 0);
@@ -421,16 +948,6 @@ int main(int argc, char *const * argv)
 		fflush(stdout);
 #endif
 
-		pfb_free_context_collect(&pccA);
-		ASSERT(pccA.out_context.out_buffer == nullptr);
-
-		// separate implementations after de-dup and sort, they're dangling
-		// pointers. TODO fix dangling pointer issue.
-		TLD_implementation_t tld_implB = create_tld_hash_impl();
-		ASSERT(tld_implB.context);
-
-		// deduplicate and sort set B; write to in-memory buffer tmpB.
-		sort_adbplus_adlists(tld_implB, &pccB, false);
 		ASSERT(tmpB.litelines.li);
 		ASSERT(tmpB.litelines.alloc > 0);
 		ASSERT(tmpB.litelines.used > 0);
@@ -445,13 +962,10 @@ int main(int argc, char *const * argv)
 		fflush(stdout);
 #endif
 
-		pfb_free_context_collect(&pccB);
-		ASSERT(pccB.out_context.out_buffer == nullptr);
-
-		free_tld_impl(&tld_implA);
-		free_tld_impl(&tld_implB);
-		ASSERT(!tld_implA.context);
-		ASSERT(!tld_implB.context);
+		free_tld_impl(&jobs[0].tld_impl);
+		free_tld_impl(&jobs[1].tld_impl);
+		ASSERT(!jobs[0].tld_impl.context);
+		ASSERT(!jobs[1].tld_impl.context);
 
 		// create input contexts for the diff step. these contexts are
 		// effectively the output of the previous sort calls. a sort must be
@@ -480,7 +994,7 @@ int main(int argc, char *const * argv)
 		ASSERT(tmpB.alloc_len > 0);
 		ASSERT(tmpB.litelines.li);
 		ASSERT(tmpB.litelines.used > 0);
-		diff_adbplus_adlists_BUFFER(&tmpA, &tmpB, &out_AvsB);
+		diff_adbplus_adlists_BUFFER(&tmpA, &tmpB, &out_AvsB, diff_output);
 
 		pfb_free_out_context(&out_AvsB);
 
@@ -488,7 +1002,16 @@ int main(int argc, char *const * argv)
 		pfb_free_out_buffer(&tmpB);
 	}
 
-	free_globalErrLog();
+	if(report_memory)
+	{
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		ELOG_STDERR("NOTICE: peak memory %zu KB accounted of the %zu MB budget; %ld KB resident\n",
+				pfb_mem_peak() >> 10, pfb_mem_budget() >> 20, usage.ru_maxrss);
+	}
+
+	pfb_pool_stop();
+	pfb_log_close();
 
 	return 0;
 }
@@ -0,0 +1,213 @@
+/**
+ * pfb_allow.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "dedupdomains.h"
+#include "pfb_allow.h"
+#include "domaininfo.h"
+#include "domaintree.h"
+#include "pfb_format.h"
+#include "tld_hash_context.h"
+#include <string.h>
+
+/**
+ * Subtract the exception rules from the blocked entries as they are written.
+ * An entry of an allowed domain, or of a subdomain of one, is dropped. A
+ * MATCH_FULL entry with allowed subdomains is kept and, for a final output,
+ * followed by the exceptions within it; the entry is split into the blocked
+ * parent and the allowed children. Exceptions within nothing blocked are
+ * dropped.
+ *
+ * One lookup is done per entry written rather than a diff of the whole list
+ * against the allowed domains.
+ */
+
+pfb_allow_t pfb_init_allow(bool write_exceptions)
+{
+	pfb_allow_t allow = {
+		.tld_impl = create_tld_hash_impl(),
+		.write_exceptions = write_exceptions,
+	};
+	ASSERT(allow.tld_impl.context);
+	init_DomainView(&allow.dv);
+	return allow;
+}
+
+void pfb_free_allow(pfb_allow_t allow[static 1])
+{
+	TLD_EntryIter_t it = nullptr;
+	DomainTree_t **dt = nullptr;
+	allow->tld_impl.impl_funcs->create_entry_iter(allow->tld_impl.context, &it,
+			&dt);
+
+	while(dt != nullptr)
+	{
+		free_DomainTree(dt);
+		dt = allow->tld_impl.impl_funcs->next_used_tld_entry(it);
+	}
+
+	allow->tld_impl.impl_funcs->free_entry_iter(&it);
+	free_tld_impl(&allow->tld_impl);
+	free_DomainView(&allow->dv);
+	free(allow->names);
+	allow->names = nullptr;
+	allow->names_used = allow->names_alloc = 0;
+}
+
+/**
+ * Insert the domain of one exception rule. A domain within one already
+ * allowed is skipped by the tree.
+ */
+void pfb_insert_allow(pfb_allow_t allow[static 1], const char *domain,
+		size_len_t len)
+{
+	if(!update_DomainView(&allow->dv, domain, len))
+	{
+		ELOG_STDERR("WARNING: IGNORING exception of '%.*s'; not a domain\n",
+				(int)len, domain);
+		return;
+	}
+
+	if(allow->names_used + len + 1 > allow->names_alloc)
+	{
+		allow->names_alloc = MAX(2 * allow->names_alloc,
+				allow->names_used + len + 1024);
+		CHECK_REALLOC(allow->names, allow->names_alloc);
+	}
+	memcpy(allow->names + allow->names_used, domain, len);
+	allow->names[allow->names_used + len] = '\0';
+
+	allow->dv.match_strength = MATCH_FULL;
+	allow->dv.context = nullptr;
+	allow->dv.li = (line_info_t){
+		.offset = allow->names_used,
+		.line_len = len,
+	};
+	allow->names_used += len + 1;
+	allow->count++;
+
+	insert_DomainTree(allow->tld_impl, &allow->dv);
+}
+
+/**
+ * Insert the domains kept with a list by pfb_keep_allowed(), 'len' bytes of
+ * null terminated domains.
+ */
+void pfb_insert_allowed(pfb_allow_t allow[static 1], const char *allowed,
+		size_t len)
+{
+	for(size_t i = 0; i < len; )
+	{
+		const size_t domain_len = strlen(allowed + i);
+		pfb_insert_allow(allow, allowed + i, domain_len);
+		i += domain_len + 1;
+	}
+}
+
+/**
+ * Keep a copy of the allowed domains with 'out_buffer' so the exceptions are
+ * applied to the lists it is later merged with; see
+ * union_adbplus_adlists_BUFFER().
+ */
+void pfb_keep_allowed(pfb_allow_t const allow[static 1],
+		pfb_out_buffer_t out_buffer[static 1])
+{
+	ASSERT(!out_buffer->mapping);
+	free(out_buffer->allowed);
+	out_buffer->allowed = malloc(MAX(allow->names_used, 1u));
+	CHECK_MALLOC(out_buffer->allowed);
+	memcpy(out_buffer->allowed, allow->names, allow->names_used);
+	out_buffer->allowed_len = allow->names_used;
+}
+
+static void write_exception(DomainInfo_t **di, void *context)
+{
+	pfb_out_context_t *out_context = context;
+	pfb_allow_t const *allow = out_context->allow;
+	pfb_write_exception(out_context, allow->names + (*di)->li.offset,
+			(*di)->li.line_len);
+}
+
+/**
+ * Point the view of 'allow' at the domain of one entry. Returns false if the
+ * entry is not a domain.
+ */
+static bool view_entry(pfb_allow_t allow[static 1], const char *line,
+		line_len_t line_len, MatchStrength_t ms)
+{
+	ASSERT(ms == MATCH_FULL || ms == MATCH_WEAK);
+
+	const char *domain = line;
+	size_len_t len = line_len;
+	if(ms == MATCH_FULL)
+	{
+		ASSERT(line_len > 3 && line[0] == '|' && line[line_len - 1] == '^');
+		domain += 2;
+		len -= 3;
+	}
+
+	return update_DomainView(&allow->dv, domain, len);
+}
+
+/**
+ * Returns true if an exception allows the domain of one entry, taken as
+ * pfb_write_formatted() takes it.
+ */
+bool pfb_is_allowed(pfb_allow_t allow[static 1], const char *line,
+		line_len_t line_len, MatchStrength_t ms)
+{
+	size_len_t labels;
+	return view_entry(allow, line, line_len, ms) &&
+		lookup_DomainTree(allow->tld_impl, &allow->dv, &labels);
+}
+
+/**
+ * Write one entry to every output of the chain unless it is allowed. 'line'
+ * is the entry as pfb_write_formatted() takes it. The exceptions within a
+ * MATCH_FULL entry follow it, the order they sort in, if the outputs are
+ * final; an intermediate list, e.g., of a diff or an index, holds blocked
+ * entries only.
+ */
+void pfb_write_allowed(pfb_out_context_t out_context[static 1],
+		const char *line, line_len_t line_len, MatchStrength_t ms)
+{
+	pfb_allow_t *allow = out_context->allow;
+	ASSERT(allow);
+
+	if(!view_entry(allow, line, line_len, ms))
+	{
+		ASSERT(false && "entries are domains");
+		pfb_write_formatted(out_context, line, line_len, ms);
+		return;
+	}
+
+	size_len_t labels;
+	if(lookup_DomainTree(allow->tld_impl, &allow->dv, &labels))
+	{
+		return;
+	}
+
+	pfb_write_formatted(out_context, line, line_len, ms);
+
+	if(ms == MATCH_FULL && allow->write_exceptions)
+	{
+		visit_below_DomainTree(allow->tld_impl, &allow->dv, write_exception,
+				out_context);
+	}
+}
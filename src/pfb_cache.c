@@ -0,0 +1,198 @@
+/**
+ * pfb_cache.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// mkdir(), opendir(), and getpid() are POSIX; -std=c23 declares only ISO C
+// otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "dedupdomains.h"
+#include "pfb_cache.h"
+#include "pfb_context.h"
+#include "pfb_hash.h"
+#include "pfb_index.h"
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Each plain text input is de-duplicated once on its own and kept in the cache
+ * directory as an index named by the input's device, inode, modification
+ * time, size, and content hash. An input matching all five is replaced by its
+ * cached index, which is mapped instead of parsed and merged with the other
+ * inputs as any index is. Only a new or changed input is parsed; its older
+ * runs are removed from the cache when the new one is written.
+ */
+
+// <dev>-<ino>- names every run of one input; the rest names its content.
+#define CACHE_ID_FMT "%016llx-%016llx-"
+#define CACHE_KEY_FMT CACHE_ID_FMT "%016llx-%016llx-%016llx.idx"
+
+static char* cache_path(const char cache_dir[static 1],
+		pfb_stat_t const pfb_s[static 1], uint64_t hash)
+{
+	const int len = snprintf(nullptr, 0, "%s%c" CACHE_KEY_FMT, cache_dir,
+			PATH_SEP_CHAR, (unsigned long long)pfb_s->st_dev,
+			(unsigned long long)pfb_s->st_ino, (unsigned long long)pfb_s->mtime,
+			(unsigned long long)pfb_s->file_size, (unsigned long long)hash);
+	char *path = malloc(len + 1);
+	CHECK_MALLOC(path);
+	snprintf(path, len + 1, "%s%c" CACHE_KEY_FMT, cache_dir, PATH_SEP_CHAR,
+			(unsigned long long)pfb_s->st_dev, (unsigned long long)pfb_s->st_ino,
+			(unsigned long long)pfb_s->mtime, (unsigned long long)pfb_s->file_size,
+			(unsigned long long)hash);
+	return path;
+}
+
+/**
+ * Remove the runs of the same input other than the run named 'keep_name'.
+ */
+static void remove_stale_runs(const char cache_dir[static 1],
+		pfb_stat_t const pfb_s[static 1], const char *keep_name)
+{
+	char id[2 * 16 + 3];
+	snprintf(id, sizeof(id), CACHE_ID_FMT, (unsigned long long)pfb_s->st_dev,
+			(unsigned long long)pfb_s->st_ino);
+	DIR *dir = opendir(cache_dir);
+	if(!dir)
+	{
+		return;
+	}
+
+	const size_t len_dir = strlen(cache_dir);
+	struct dirent *direntry;
+	while((direntry = readdir(dir)) != nullptr)
+	{
+		if(strncmp(direntry->d_name, id, sizeof(id) - 1) != 0 ||
+				strcmp(direntry->d_name, keep_name) == 0)
+		{
+			continue;
+		}
+
+		const size_t len = len_dir + 1 + strlen(direntry->d_name) + 1;
+		char *stale = malloc(len);
+		CHECK_MALLOC(stale);
+		snprintf(stale, len, "%s%c%s", cache_dir, PATH_SEP_CHAR, direntry->d_name);
+		DEBUG_PRINTF("removing stale run %s\n", stale);
+		unlink(stale);
+		free(stale);
+	}
+	closedir(dir);
+}
+
+/**
+ * De-duplicate the one input to a run at 'run_path'. Written aside and renamed
+ * so another run reading the cache never maps a partial index.
+ */
+static bool write_run(path_info_t const in_path[static 1],
+		const char run_path[static 1],
+		bool (*load_set)(paths_list_t, pfb_out_buffer_t[static 1]))
+{
+	// a view of the one input; load_set() does not keep it.
+	path_info_t one_path = *in_path;
+	paths_list_t one = {
+		.paths = &one_path,
+		.len = 1,
+		.alloced = 1,
+	};
+
+	pfb_out_buffer_t sorted;
+	if(!load_set(one, &sorted))
+	{
+		return false;
+	}
+
+	const size_t len = strlen(run_path) + 32;
+	char *tmp_fname = malloc(len);
+	CHECK_MALLOC(tmp_fname);
+	snprintf(tmp_fname, len, "%s.%ld.tmp", run_path, (long)getpid());
+
+	bool ok = false;
+	FILE *out_file = fopen(tmp_fname, "wb");
+	if(out_file)
+	{
+		ok = pfb_write_index(out_file, &sorted);
+		ok = fclose(out_file) == 0 && ok;
+		ok = ok && rename(tmp_fname, run_path) == 0;
+	}
+
+	if(!ok)
+	{
+		ELOG_STDERR("WARNING: failed to write %s to the cache; it is read as plain text\n",
+				in_path->path);
+		unlink(tmp_fname);
+	}
+
+	free(tmp_fname);
+	pfb_free_out_buffer(&sorted);
+	return ok;
+}
+
+/**
+ * Replace every plain text input of 'in_paths_list' with its run in
+ * 'cache_dir', writing the runs of new or changed inputs with 'load_set'. The
+ * directory is created if missing. Returns false if it cannot be used.
+ */
+bool pfb_cache_inputs(const char cache_dir[static 1],
+		paths_list_t in_paths_list[static 1],
+		bool (*load_set)(paths_list_t, pfb_out_buffer_t[static 1]))
+{
+	if(mkdir(cache_dir, 0755) != 0 && errno != EEXIST)
+	{
+		ELOG_STDERR("ERROR: failed to create cache directory %s\n", cache_dir);
+		return false;
+	}
+
+	for(uint i = 0; i < in_paths_list->len; i++)
+	{
+		path_info_t *in_path = &in_paths_list->paths[i];
+		if(in_path->is_index)
+		{
+			continue;
+		}
+
+		uint64_t hash;
+		if(!pfb_hash_file(in_path->path, &hash))
+		{
+			return false;
+		}
+
+		char *run_path = cache_path(cache_dir, &in_path->pfb_s, hash);
+		if(!pfb_is_index_file(run_path))
+		{
+			DEBUG_PRINTF("cache miss %s\n", in_path->path);
+			if(!write_run(in_path, run_path, load_set))
+			{
+				free(run_path);
+				continue;
+			}
+			remove_stale_runs(cache_dir, &in_path->pfb_s,
+					run_path + strlen(cache_dir) + 1);
+		}
+
+		free(in_path->path);
+		in_path->path = run_path;
+		in_path->is_index = true;
+	}
+
+	return true;
+}
@@ -0,0 +1,802 @@
+/**
+ * pfb_daemon.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// sockets, sigaction() and open_memstream() are POSIX; -std=c23 declares only
+// ISO C otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "dedupdomains.h"
+#include "pfb_context.h"
+#include "pfb_differ.h"
+#include "pfb_daemon.h"
+#include "pfb_lookup.h"
+#include "pfb_memory.h"
+#include "pfb_prune.h"
+#include "pfb_stats.h"
+#include "inputargs.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/**
+ * A resident server over a Unix domain socket. The lists are loaded once,
+ * de-duplicated and sorted, and held in memory along with the consolidation
+ * of all of them; every request is answered from these. One thread serves all
+ * clients from a poll() loop.
+ *
+ * Requests are single lines. Every response starts with a line "OK ..." or
+ * "ERR <reason>"; a response with a body ends with a line holding only ".".
+ *
+ * ADD <name> <path>     load a file or directory as the list <name>,
+ *                       replacing any list of that name
+ * REMOVE <name>         drop the list <name>
+ * LISTS                 body: "<name>\t<entries>" per list
+ * BLOCKED <domain>      "OK <rule>" for the rule blocking <domain>, or "OK -"
+ * DUMP [<name>]         body: the consolidated list, or the list <name>
+ * DIFF <name>|* <path>  body: the diff of the list <name>, or of the
+ *                       consolidated list, against the file or directory
+ * QUIT                  close the connection
+ *
+ * No line of a body starts with '.'; entries start with '|' and diff lines
+ * with their code.
+ */
+#define DAEMON_LINE_MAX 4096
+#define DAEMON_CHUNK (64 * 1024)
+#define DAEMON_BACKLOG 64
+
+/**
+ * A de-duplicated list shared by the daemon and the clients streaming it.
+ * Freed when the last reference goes.
+ */
+typedef struct daemon_set
+{
+	pfb_out_buffer_t sorted;
+	uint refs;
+} daemon_set_t;
+
+typedef struct daemon_list
+{
+	char *name;
+	daemon_set_t *set;
+} daemon_list_t;
+
+typedef struct daemon_client
+{
+	int fd;
+	char in[DAEMON_LINE_MAX];
+	size_t in_used;
+
+	// response bytes not yet sent
+	char *out;
+	size_t out_len;
+	size_t out_sent;
+	size_t out_alloc;
+
+	// when set, the entries of this set from 'dump_idx' on are sent once
+	// 'out' drains.
+	daemon_set_t *dump;
+	size_len_t dump_idx;
+
+	bool closing;
+} daemon_client_t;
+
+typedef struct daemon
+{
+	daemon_list_t *lists;
+	uint lists_used;
+	uint lists_alloc;
+
+	// consolidation of all lists; rebuilt on demand after a list changes.
+	daemon_set_t *all;
+
+	daemon_client_t *clients;
+	uint clients_used;
+	uint clients_alloc;
+
+	bool (*load_set)(paths_list_t, pfb_out_buffer_t[static 1]);
+
+	DomainView_t query;
+	DomainView_t scratch;
+} daemon_t;
+
+static volatile sig_atomic_t daemon_stop = 0;
+
+static void on_stop_signal(int sig)
+{
+	UNUSED(sig);
+	daemon_stop = 1;
+}
+
+static daemon_set_t *create_set()
+{
+	daemon_set_t *set = calloc(1, sizeof(daemon_set_t));
+	CHECK_MALLOC(set);
+	set->refs = 1;
+	return set;
+}
+
+static daemon_set_t *retain_set(daemon_set_t set[static 1])
+{
+	set->refs++;
+	return set;
+}
+
+static void release_set(daemon_set_t **set)
+{
+	if(*set && --(*set)->refs == 0)
+	{
+		pfb_free_out_buffer(&(*set)->sorted);
+		free(*set);
+	}
+	*set = nullptr;
+}
+
+static void client_append(daemon_client_t client[static 1], const char *data,
+		size_t len)
+{
+	if(client->out_len + len > client->out_alloc)
+	{
+		client->out_alloc = MAX(client->out_len + len, 2 * client->out_alloc);
+		client->out_alloc = MAX(client->out_alloc, (size_t)DAEMON_LINE_MAX);
+		CHECK_REALLOC(client->out, client->out_alloc);
+	}
+	memcpy(client->out + client->out_len, data, len);
+	client->out_len += len;
+}
+
+static void client_printf(daemon_client_t client[static 1], const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static void client_printf(daemon_client_t client[static 1], const char *fmt, ...)
+{
+	char line[DAEMON_LINE_MAX];
+	va_list args;
+	va_start(args, fmt);
+	const int len = vsnprintf(line, sizeof(line), fmt, args);
+	va_end(args);
+	ASSERT(len >= 0);
+	client_append(client, line, MIN((size_t)len, sizeof(line) - 1));
+}
+
+static daemon_list_t *find_list(daemon_t d[static 1], const char name[static 1])
+{
+	for(uint i = 0; i < d->lists_used; i++)
+	{
+		if(strcmp(d->lists[i].name, name) == 0)
+			return &d->lists[i];
+	}
+	return nullptr;
+}
+
+/**
+ * Load the inputs at 'path' as one de-duplicated set. Returns nullptr, having
+ * told 'client' why, if the path holds no readable input, an index in it
+ * cannot be used, or the set does not fit the memory budget.
+ */
+static daemon_set_t *load_path(daemon_t d[static 1],
+		daemon_client_t client[static 1], const char path[static 1])
+{
+	paths_list_t paths = read_input_paths(path);
+	if(paths.len == 0)
+	{
+		free_paths_list(&paths);
+		client_printf(client, "ERR no readable input in %s\n", path);
+		return nullptr;
+	}
+
+	daemon_set_t *set = create_set();
+	pfb_mem_overrun();
+	const bool loaded = d->load_set(paths, &set->sorted);
+	free_paths_list(&paths);
+	if(!loaded)
+	{
+		free(set);
+		client_printf(client, "ERR cannot load %s\n", path);
+		return nullptr;
+	}
+	if(pfb_mem_overrun())
+	{
+		release_set(&set);
+		client_printf(client, "ERR %s exceeds the memory budget of %zu MB\n",
+				path, pfb_mem_budget() >> 20);
+		return nullptr;
+	}
+	return set;
+}
+
+static void put_list(daemon_t d[static 1], const char name[static 1],
+		daemon_set_t set[static 1])
+{
+	daemon_list_t *list = find_list(d, name);
+	if(list)
+	{
+		release_set(&list->set);
+	}
+	else
+	{
+		if(d->lists_used == d->lists_alloc)
+		{
+			d->lists_alloc = MAX(2 * d->lists_alloc, 4u);
+			CHECK_REALLOC(d->lists, sizeof(daemon_list_t) * d->lists_alloc);
+		}
+		list = &d->lists[d->lists_used++];
+		list->name = pfb_strdup(name);
+	}
+	list->set = set;
+	release_set(&d->all);
+}
+
+/**
+ * The consolidation of all lists, built when first needed after a change.
+ * Returns nullptr, having told 'client', if it does not fit the memory budget.
+ */
+static daemon_set_t *consolidated(daemon_t d[static 1],
+		daemon_client_t client[static 1])
+{
+	if(d->all)
+		return d->all;
+
+	pfb_out_buffer_t **in = calloc(d->lists_used + 1, sizeof(pfb_out_buffer_t*));
+	CHECK_MALLOC(in);
+	for(uint i = 0; i < d->lists_used; i++)
+	{
+		in[i] = &d->lists[i].set->sorted;
+	}
+
+	d->all = create_set();
+	d->all->sorted = (pfb_out_buffer_t){
+		.buffer = malloc(DAEMON_LINE_MAX),
+		.alloc_len = DAEMON_LINE_MAX,
+	};
+	CHECK_MALLOC(d->all->sorted.buffer);
+	pfb_out_context_t out_context = pfb_init_out_context_BUFFER(&d->all->sorted);
+	pfb_mem_overrun();
+	union_adbplus_adlists_BUFFER(in, d->lists_used, &out_context);
+	free(in);
+	if(pfb_mem_overrun())
+	{
+		release_set(&d->all);
+		client_printf(client, "ERR the consolidated list exceeds the memory budget of %zu MB\n",
+				pfb_mem_budget() >> 20);
+	}
+	return d->all;
+}
+
+static void cmd_add(daemon_t d[static 1], daemon_client_t client[static 1],
+		char *args)
+{
+	char *name = strtok(args, " \t");
+	char *path = strtok(nullptr, "");
+	if(!name || !path)
+	{
+		client_printf(client, "ERR usage: ADD <name> <path>\n");
+		return;
+	}
+
+	daemon_set_t *set = load_path(d, client, path);
+	if(!set)
+	{
+		return;
+	}
+	put_list(d, name, set);
+	client_printf(client, "OK %s %u\n", name, set->sorted.litelines.used);
+}
+
+static void cmd_remove(daemon_t d[static 1], daemon_client_t client[static 1],
+		char *args)
+{
+	daemon_list_t *list = args ? find_list(d, args) : nullptr;
+	if(!list)
+	{
+		client_printf(client, "ERR no list %s\n", args ? args : "");
+		return;
+	}
+
+	release_set(&list->set);
+	free(list->name);
+	*list = d->lists[--d->lists_used];
+	release_set(&d->all);
+	client_printf(client, "OK\n");
+}
+
+static void cmd_lists(daemon_t d[static 1], daemon_client_t client[static 1])
+{
+	client_printf(client, "OK %u\n", d->lists_used);
+	for(uint i = 0; i < d->lists_used; i++)
+	{
+		client_printf(client, "%s\t%u\n", d->lists[i].name,
+				d->lists[i].set->sorted.litelines.used);
+	}
+	client_printf(client, ".\n");
+}
+
+static void cmd_blocked(daemon_t d[static 1], daemon_client_t client[static 1],
+		char *args)
+{
+	if(!args || !pfb_query_DomainView(&d->query, args, strlen(args)))
+	{
+		client_printf(client, "ERR not a domain: %s\n", args ? args : "");
+		return;
+	}
+
+	daemon_set_t const *set = consolidated(d, client);
+	if(!set)
+	{
+		return;
+	}
+
+	pfb_out_buffer_t const *all = &set->sorted;
+	size_len_t found;
+	if(pfb_lookup_BUFFER(all, &d->query, &d->scratch, &found))
+	{
+		const line_info_t li = all->litelines.li[found];
+		client_printf(client, "OK %.*s\n", (int)li.line_len, all->buffer + li.offset);
+	}
+	else
+	{
+		client_printf(client, "OK -\n");
+	}
+}
+
+static void cmd_dump(daemon_t d[static 1], daemon_client_t client[static 1],
+		char *args)
+{
+	daemon_set_t *set = nullptr;
+	if(args)
+	{
+		daemon_list_t *list = find_list(d, args);
+		if(!list)
+		{
+			client_printf(client, "ERR no list %s\n", args);
+			return;
+		}
+		set = list->set;
+	}
+	else if(!(set = consolidated(d, client)))
+	{
+		return;
+	}
+
+	client_printf(client, "OK %u\n", set->sorted.litelines.used);
+	client->dump = retain_set(set);
+	client->dump_idx = 0;
+}
+
+static void cmd_diff(daemon_t d[static 1], daemon_client_t client[static 1],
+		char *args)
+{
+	char *name = strtok(args, " \t");
+	char *path = strtok(nullptr, "");
+	if(!name || !path)
+	{
+		client_printf(client, "ERR usage: DIFF <name>|* <path>\n");
+		return;
+	}
+
+	daemon_set_t *set = nullptr;
+	if(strcmp(name, "*") == 0)
+	{
+		if(!(set = consolidated(d, client)))
+		{
+			return;
+		}
+	}
+	else
+	{
+		daemon_list_t *list = find_list(d, name);
+		if(!list)
+		{
+			client_printf(client, "ERR no list %s\n", name);
+			return;
+		}
+		set = list->set;
+	}
+	set = retain_set(set);
+
+	daemon_set_t *other = load_path(d, client, path);
+	if(!other)
+	{
+		release_set(&set);
+		return;
+	}
+
+	// the report is formatted by the differ into memory and streamed from
+	// there as the client reads it.
+	char *report = nullptr;
+	size_t report_len = 0;
+	FILE *out_file = open_memstream(&report, &report_len);
+	CHECK_MALLOC(out_file);
+	pfb_out_context_t out_context = pfb_init_out_context(nullptr);
+	out_context.out_file = out_file;
+	diff_adbplus_adlists_BUFFER(&set->sorted, &other->sorted, &out_context,
+			DIFF_REPORT);
+	pfb_free_out_context(&out_context);
+	fclose(out_file);
+
+	client_printf(client, "OK\n");
+	client_append(client, report, report_len);
+	client_printf(client, ".\n");
+
+	free(report);
+	release_set(&other);
+	release_set(&set);
+}
+
+/**
+ * Handle one request line and queue its response.
+ */
+static void handle_request(daemon_t d[static 1], daemon_client_t client[static 1],
+		char line[static 1])
+{
+	char *cmd = strtok(line, " \t");
+	char *args = strtok(nullptr, "");
+	if(args)
+	{
+		args += strspn(args, " \t");
+		if(*args == '\0')
+			args = nullptr;
+	}
+
+	if(!cmd)
+	{
+		client_printf(client, "ERR empty request\n");
+	}
+	else if(strcmp(cmd, "ADD") == 0)
+	{
+		cmd_add(d, client, args);
+	}
+	else if(strcmp(cmd, "REMOVE") == 0)
+	{
+		cmd_remove(d, client, args);
+	}
+	else if(strcmp(cmd, "LISTS") == 0)
+	{
+		cmd_lists(d, client);
+	}
+	else if(strcmp(cmd, "BLOCKED") == 0)
+	{
+		cmd_blocked(d, client, args);
+	}
+	else if(strcmp(cmd, "DUMP") == 0)
+	{
+		cmd_dump(d, client, args);
+	}
+	else if(strcmp(cmd, "DIFF") == 0)
+	{
+		cmd_diff(d, client, args);
+	}
+	else if(strcmp(cmd, "QUIT") == 0)
+	{
+		client_printf(client, "OK\n");
+		client->closing = true;
+	}
+	else
+	{
+		client_printf(client, "ERR unknown request %s\n", cmd);
+	}
+}
+
+/**
+ * Queue the next chunk of a dump once the previous one is sent.
+ */
+static void fill_dump(daemon_client_t client[static 1])
+{
+	pfb_out_buffer_t const *sorted = &client->dump->sorted;
+	while(client->out_len < DAEMON_CHUNK &&
+			client->dump_idx < sorted->litelines.used)
+	{
+		const line_info_t li = sorted->litelines.li[client->dump_idx++];
+		client_append(client, sorted->buffer + li.offset, li.line_len);
+		client_append(client, "\n", 1);
+	}
+	if(client->dump_idx == sorted->litelines.used)
+	{
+		client_printf(client, ".\n");
+		release_set(&client->dump);
+	}
+}
+
+static bool client_has_output(daemon_client_t const client[static 1])
+{
+	return client->out_sent < client->out_len || client->dump;
+}
+
+/**
+ * Send what the socket accepts without blocking. Returns false if the client
+ * went away.
+ */
+static bool flush_client(daemon_client_t client[static 1])
+{
+	while(client_has_output(client))
+	{
+		if(client->out_sent == client->out_len)
+		{
+			client->out_sent = client->out_len = 0;
+			fill_dump(client);
+			continue;
+		}
+
+		const ssize_t sent = send(client->fd, client->out + client->out_sent,
+				client->out_len - client->out_sent, MSG_NOSIGNAL);
+		if(sent < 0)
+		{
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+		client->out_sent += sent;
+	}
+	client->out_sent = client->out_len = 0;
+	return true;
+}
+
+/**
+ * Handle the complete request lines received so far. A request is taken only
+ * once the response to the previous one is sent; the rest wait in 'in'.
+ */
+static bool serve_requests(daemon_t d[static 1], daemon_client_t client[static 1])
+{
+	while(true)
+	{
+		if(!flush_client(client))
+			return false;
+		if(client->closing || client_has_output(client))
+			return true;
+
+		char *nl = memchr(client->in, '\n', client->in_used);
+		if(!nl)
+		{
+			if(client->in_used < sizeof(client->in))
+				return true;
+			client_printf(client, "ERR request longer than %d bytes\n",
+					DAEMON_LINE_MAX);
+			client->closing = true;
+			continue;
+		}
+
+		*nl = '\0';
+		if(nl > client->in && nl[-1] == '\r')
+			nl[-1] = '\0';
+		handle_request(d, client, client->in);
+
+		const size_t used = nl + 1 - client->in;
+		memmove(client->in, nl + 1, client->in_used - used);
+		client->in_used -= used;
+	}
+}
+
+static bool read_client(daemon_t d[static 1], daemon_client_t client[static 1])
+{
+	const ssize_t got = recv(client->fd, client->in + client->in_used,
+			sizeof(client->in) - client->in_used, 0);
+	if(got == 0)
+	{
+		return false;
+	}
+	if(got < 0)
+	{
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+	client->in_used += got;
+	return serve_requests(d, client);
+}
+
+static void close_client(daemon_t d[static 1], uint idx)
+{
+	daemon_client_t *client = &d->clients[idx];
+	close(client->fd);
+	free(client->out);
+	release_set(&client->dump);
+	d->clients[idx] = d->clients[--d->clients_used];
+}
+
+static void accept_clients(daemon_t d[static 1], int listen_fd)
+{
+	while(true)
+	{
+		const int fd = accept(listen_fd, nullptr, nullptr);
+		if(fd < 0)
+		{
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				ELOG_STDERR("WARNING: accept failed: %s\n", strerror(errno));
+			}
+			return;
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+		if(d->clients_used == d->clients_alloc)
+		{
+			d->clients_alloc = MAX(2 * d->clients_alloc, 8u);
+			CHECK_REALLOC(d->clients, sizeof(daemon_client_t) * d->clients_alloc);
+		}
+		d->clients[d->clients_used++] = (daemon_client_t){.fd = fd};
+	}
+}
+
+static int listen_on(const char socket_path[static 1])
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	if(strlen(socket_path) >= sizeof(addr.sun_path))
+	{
+		ELOG_STDERR("ERROR: socket path %s is too long\n", socket_path);
+		return -1;
+	}
+	strcpy(addr.sun_path, socket_path);
+
+	// a socket left behind by an earlier run is replaced; anything else at
+	// the path is left alone.
+	struct stat s;
+	if(lstat(socket_path, &s) == 0 && S_ISSOCK(s.st_mode))
+	{
+		unlink(socket_path);
+	}
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0)
+	{
+		ELOG_STDERR("ERROR: failed to create socket: %s\n", strerror(errno));
+		return -1;
+	}
+	if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+			listen(fd, DAEMON_BACKLOG) != 0)
+	{
+		ELOG_STDERR("ERROR: failed to listen on %s: %s\n", socket_path,
+				strerror(errno));
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	return fd;
+}
+
+static void free_daemon(daemon_t d[static 1])
+{
+	while(d->clients_used > 0)
+	{
+		close_client(d, d->clients_used - 1);
+	}
+	for(uint i = 0; i < d->lists_used; i++)
+	{
+		release_set(&d->lists[i].set);
+		free(d->lists[i].name);
+	}
+	release_set(&d->all);
+	free(d->lists);
+	free(d->clients);
+	free_DomainView(&d->query);
+	free_DomainView(&d->scratch);
+}
+
+/**
+ * Load the given sets, each named by the matching entry of 'names', and serve
+ * requests on a Unix domain socket at 'socket_path' until SIGINT or SIGTERM.
+ * Lists added later are loaded with 'load_set'.
+ */
+bool pfb_serve(const char socket_path[static 1],
+		paths_list_t const sets[], char const *const names[], uint count,
+		bool (*load_set)(paths_list_t, pfb_out_buffer_t[static 1]))
+{
+	ASSERT(load_set);
+
+	daemon_t d = {.load_set = load_set};
+	init_DomainView(&d.query);
+	init_DomainView(&d.scratch);
+
+	for(uint i = 0; i < count; i++)
+	{
+		daemon_set_t *set = create_set();
+		if(!load_set(sets[i], &set->sorted))
+		{
+			free(set);
+			free_daemon(&d);
+			return false;
+		}
+		put_list(&d, names[i], set);
+	}
+	// past here a list over the budget is refused, not the end of the server.
+	pfb_mem_set_soft(true);
+
+	const int listen_fd = listen_on(socket_path);
+	if(listen_fd < 0)
+	{
+		free_daemon(&d);
+		return false;
+	}
+
+	struct sigaction sa = {.sa_handler = on_stop_signal};
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGTERM, &sa, nullptr);
+
+	struct pollfd *fds = nullptr;
+	uint fds_alloc = 0;
+	while(!daemon_stop)
+	{
+		// SIGUSR1 interrupts poll() below.
+		pfb_stats_poll();
+		// write what was logged before waiting, however long that is.
+		pfb_log_flush();
+
+		if(fds_alloc < d.clients_used + 1)
+		{
+			fds_alloc = d.clients_alloc + 1;
+			CHECK_REALLOC(fds, sizeof(struct pollfd) * fds_alloc);
+		}
+
+		fds[0] = (struct pollfd){.fd = listen_fd, .events = POLLIN};
+		for(uint i = 0; i < d.clients_used; i++)
+		{
+			fds[i + 1] = (struct pollfd){
+				.fd = d.clients[i].fd,
+				.events = client_has_output(&d.clients[i]) ? POLLOUT : POLLIN,
+			};
+		}
+		const uint nfds = d.clients_used + 1;
+
+		if(poll(fds, nfds, -1) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			ELOG_STDERR("ERROR: poll failed: %s\n", strerror(errno));
+			break;
+		}
+
+		// walk backwards; a closed client is replaced by the last one.
+		for(uint i = nfds - 1; i > 0; i--)
+		{
+			daemon_client_t *client = &d.clients[i - 1];
+			bool keep = true;
+			if(fds[i].revents & POLLOUT)
+			{
+				keep = serve_requests(&d, client);
+			}
+			else if(fds[i].revents & POLLIN)
+			{
+				keep = read_client(&d, client);
+			}
+			else if(fds[i].revents & (POLLHUP | POLLERR | POLLNVAL))
+			{
+				keep = false;
+			}
+
+			if(!keep || (client->closing && !client_has_output(client)))
+			{
+				close_client(&d, i - 1);
+			}
+		}
+
+		if(fds[0].revents & POLLIN)
+		{
+			accept_clients(&d, listen_fd);
+		}
+	}
+
+	free(fds);
+	close(listen_fd);
+	unlink(socket_path);
+	free_daemon(&d);
+	return true;
+}
@@ -0,0 +1,358 @@
+/**
+ * pfb_delta.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// getline() is POSIX; -std=c23 declares only ISO C otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "dedupdomains.h"
+#include "pfb_context.h"
+#include "pfb_differ.h"
+#include "pfb_delta.h"
+#include "adbplusline.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * A delta is newline delimited JSON; one record per entry added or removed, in
+ * the same order as the diff which produced it:
+ *
+ * {"op":"add","key":"com.example.ads","ms":1}
+ *
+ * 'key' holds the labels of the domain from the TLD down, i.e., the order the
+ * entries are sorted in. 'ms' is the MatchStrength of the entry.
+ */
+static const char DELTA_ADD[] = "add";
+static const char DELTA_REMOVE[] = "remove";
+
+static void write_json_chars(FILE *out_file, const char *data, size_len_t len)
+{
+	for(size_len_t i = 0; i < len; i++)
+	{
+		const unsigned char c = data[i];
+		if(c == '"' || c == '\\')
+		{
+			fprintf(out_file, "\\%c", c);
+		}
+		else if(c < 0x20)
+		{
+			fprintf(out_file, "\\u%04x", c);
+		}
+		else
+		{
+			fputc(c, out_file);
+		}
+	}
+}
+
+void pfb_write_delta_record(FILE *out_file, DomainView_t const dv[static 1],
+		bool add)
+{
+	ASSERT(out_file);
+	ASSERT(dv->segs_used > 0);
+
+	fprintf(out_file, "{\"op\":\"%s\",\"key\":\"", add ? DELTA_ADD : DELTA_REMOVE);
+	for(size_len_t i = 0; i < dv->segs_used; i++)
+	{
+		if(i > 0)
+		{
+			fputc('.', out_file);
+		}
+		write_json_chars(out_file, dv->fqd.data + dv->label_indexes[i],
+				dv->lengths[i]);
+	}
+	fprintf(out_file, "\",\"ms\":%d}\n", dv->match_strength);
+}
+
+/**
+ * One record read from a delta. 'line' holds the entry as it is written to
+ * an adlist; 'dv' views the domain within it.
+ */
+typedef struct delta_record
+{
+	bool add;
+	MatchStrength_t ms;
+	DomainView_t dv;
+	char *line;
+	size_t line_alloc;
+	size_len_t line_len;
+} delta_record_t;
+
+/**
+ * Return a pointer to the value following "name": in the record or nullptr
+ * when the field is missing.
+ */
+static const char *find_json_field(const char *record, const char *name)
+{
+	const size_t len = strlen(name);
+	for(const char *c = strchr(record, '"'); c; c = strchr(c + 1, '"'))
+	{
+		if(strncmp(c + 1, name, len) == 0 && c[len + 1] == '"' &&
+				c[len + 2] == ':')
+		{
+			return c + len + 3;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * Parse one record. The key is unescaped and its labels reversed into the
+ * adlist form '||<domain>^', or the raw domain for a MATCH_WEAK record.
+ * Returns false for a malformed record.
+ */
+static bool parse_delta_record(delta_record_t rec[static 1], const char *record)
+{
+	const char *op = find_json_field(record, "op");
+	const char *key = find_json_field(record, "key");
+	const char *ms = find_json_field(record, "ms");
+	if(!op || !key || !ms || *key != '"')
+	{
+		return false;
+	}
+
+	if(strncmp(op, "\"add\"", 5) == 0)
+	{
+		rec->add = true;
+	}
+	else if(strncmp(op, "\"remove\"", 8) == 0)
+	{
+		rec->add = false;
+	}
+	else
+	{
+		return false;
+	}
+
+	char *end = nullptr;
+	rec->ms = strtol(ms, &end, 10);
+	if(end == ms || (rec->ms != MATCH_FULL && rec->ms != MATCH_WEAK))
+	{
+		return false;
+	}
+
+	// unescape the key into a scratch area at the end of 'line'; the
+	// domain is written in front of it with the labels reversed.
+	key++;
+	const size_t key_max = strlen(key);
+	if(rec->line_alloc < key_max * 2 + 4)
+	{
+		rec->line_alloc = key_max * 2 + 4;
+		CHECK_REALLOC(rec->line, rec->line_alloc);
+	}
+	char *scratch = rec->line + key_max + 4;
+	size_t key_len = 0;
+	for(; *key && *key != '"'; key++)
+	{
+		if(*key == '\\')
+		{
+			key++;
+			if(*key == 'u')
+			{
+				char hex[5] = {};
+				for(uint h = 0; h < 4; h++)
+				{
+					if(!key[h + 1])
+						return false;
+					hex[h] = key[h + 1];
+				}
+				scratch[key_len++] = strtol(hex, nullptr, 16);
+				key += 4;
+				continue;
+			}
+			else if(*key == '\0')
+			{
+				return false;
+			}
+		}
+		scratch[key_len++] = *key;
+	}
+	if(*key != '"' || key_len == 0)
+	{
+		return false;
+	}
+
+	char *out = rec->line;
+	if(rec->ms == MATCH_FULL)
+	{
+		*out++ = '|';
+		*out++ = '|';
+	}
+	size_t label_end = key_len;
+	for(size_t i = key_len; i > 0; i--)
+	{
+		if(scratch[i - 1] == '.')
+		{
+			memcpy(out, scratch + i, label_end - i);
+			out += label_end - i;
+			*out++ = '.';
+			label_end = i - 1;
+		}
+	}
+	memcpy(out, scratch, label_end);
+	out += label_end;
+	if(rec->ms == MATCH_FULL)
+	{
+		*out++ = '^';
+	}
+	*out = '\0';
+	rec->line_len = out - rec->line;
+
+	AdbplusView_t lv;
+	if(!parse_adbplus_line(&lv, rec->line) || lv.ms != rec->ms)
+	{
+		return false;
+	}
+	if(!update_DomainView(&rec->dv, lv.data, lv.len))
+	{
+		return false;
+	}
+	rec->dv.match_strength = lv.ms;
+	return true;
+}
+
+/**
+ * Read records until one parses. Returns false at the end of the delta.
+ */
+static bool next_delta_record(FILE *delta, char *buffer[static 1],
+		size_t alloc[static 1], delta_record_t rec[static 1],
+		linenumber_t line_number[static 1])
+{
+	ssize_t read;
+	while((read = getline(buffer, alloc, delta)) != -1)
+	{
+		(*line_number)++;
+		while(read > 0 && ((*buffer)[read - 1] == '\n' ||
+					(*buffer)[read - 1] == '\r'))
+		{
+			(*buffer)[--read] = '\0';
+		}
+		if(read == 0)
+		{
+			continue;
+		}
+		if(parse_delta_record(rec, *buffer))
+		{
+			return true;
+		}
+		ELOG_STDERR("WARNING: IGNORING malformed delta record on line %ld\n",
+				*line_number);
+	}
+	return false;
+}
+
+static void write_line(pfb_out_context_t out_context[static 1],
+		const char *line, size_len_t line_len)
+{
+	fwrite(line, sizeof(char), line_len, out_context->out_file);
+	fprintf(out_context->out_file, "\n");
+	out_context->counter++;
+}
+
+/**
+ * Apply a delta to a de-duplicated and sorted base in one linear merge and
+ * write the resulting adlist. The records of the delta must be in the order
+ * the diff wrote them.
+ */
+void pfb_apply_delta_BUFFER(pfb_out_buffer_t base[static 1], FILE *delta,
+		pfb_out_context_t out_context[static 1])
+{
+	ASSERT(delta);
+	ASSERT(out_context);
+	ASSERT(out_context->out_file);
+
+	DomainView_t base_dv;
+	init_DomainView(&base_dv);
+	size_len_t base_idx = 0;
+
+	delta_record_t rec = {};
+	init_DomainView(&rec.dv);
+	char *buffer = nullptr;
+	size_t alloc = 0;
+	linenumber_t line_number = 0;
+
+	bool have_base = false;
+	bool have_rec = next_delta_record(delta, &buffer, &alloc, &rec, &line_number);
+
+	while(true)
+	{
+		if(!have_base && base_idx < base->litelines.used)
+		{
+			AdbplusView_t lv;
+			const bool parsed_ok = parse_adbplus_line(&lv, base->buffer +
+					base->litelines.li[base_idx].offset);
+			ASSERT(parsed_ok);
+			UNUSED(parsed_ok);
+			update_DomainView(&base_dv, lv.data, lv.len);
+			base_dv.match_strength = lv.ms;
+			have_base = true;
+		}
+
+		if(!have_base && !have_rec)
+		{
+			break;
+		}
+
+		int cmp = dv_A_lt_dv_B_write_A;
+		if(have_base && have_rec)
+		{
+			cmp = compare_dv(&base_dv, &rec.dv);
+		}
+		else if(have_rec)
+		{
+			cmp = dv_A_gt_dv_B_write_B;
+		}
+
+		if(cmp == dv_A_lt_dv_B_write_A || cmp == dv_A_blk_dv_B)
+		{
+			const line_info_t li = base->litelines.li[base_idx];
+			write_line(out_context, base->buffer + li.offset, li.line_len);
+			base_idx++;
+			have_base = false;
+		}
+		else if(cmp == dv_A_eq_dv_B)
+		{
+			if(rec.add)
+			{
+				const line_info_t li = base->litelines.li[base_idx];
+				write_line(out_context, base->buffer + li.offset, li.line_len);
+			}
+			base_idx++;
+			have_base = false;
+			have_rec = next_delta_record(delta, &buffer, &alloc, &rec, &line_number);
+		}
+		else
+		{
+			if(rec.add)
+			{
+				write_line(out_context, rec.line, rec.line_len);
+			}
+			else
+			{
+				ELOG_STDERR("WARNING: delta removes %s which is not in the base\n",
+						rec.line);
+			}
+			have_rec = next_delta_record(delta, &buffer, &alloc, &rec, &line_number);
+		}
+	}
+
+	free(buffer);
+	free(rec.line);
+	free_DomainView(&rec.dv);
+	free_DomainView(&base_dv);
+}
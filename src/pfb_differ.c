@@ -19,9 +19,13 @@
  * limitations under the License.
  */
 #include "dedupdomains.h"
+#include "pfb_allow.h"
 #include "pfb_context.h"
 #include "adbplusline.h"
 #include "domain.h"
+#include "pfb_differ.h"
+#include "pfb_delta.h"
+#include "pfb_stats.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -32,21 +36,6 @@ enum diff_codes : char
 	NEUTRAL=' ',
 };
 
-// might also act as indexes into an array holding markers for what symbol(s) to
-// write to output file.
-enum dv_comparison : char
-{
-	dv_A_eq_dv_B = 0,
-	dv_A_blk_dv_B = 1,
-	dv_B_blk_dv_A = 2,
-	dv_A_isblk_dv_B = 3,
-	dv_B_isblk_dv_A = 4,
-	dv_A_exclusive = 5,
-	dv_B_exclusive = 6,
-	dv_A_lt_dv_B_write_A = 7,
-	dv_A_gt_dv_B_write_B = 8,
-};
-
 typedef struct DV_FILE_iter
 {
 	// source of the next line: read from FILE specified.
@@ -61,6 +50,8 @@ typedef struct DV_FILE_iter
 	bool written;
 	// holds 'a' or 'b' for which DomainView this iter represents
 	const char marker;
+	// report or set operation to write
+	const enum diff_output output;
 
 	// array of offsets and line lengths for entries contained within in_context
 	const size_len_t li_used;
@@ -82,6 +73,8 @@ typedef struct DV_BUFFER_iter
 	bool written;
 	// holds 'a' or 'b' for which DomainView this iter represents
 	const char marker;
+	// report or set operation to write
+	const enum diff_output output;
 
 	// than having another pointer to dereference?
 	//const LiteLineData_t lld;
@@ -151,11 +144,14 @@ static void read_liteline_FILE(pfb_context_t pcc[static 1],
  * ads.google.com
  * ads.yahoo.com
  *
- * another layer to consider is match strength. if raw domains are supported,
- * the comparison here becomes a level more complicated as a full match is moot
- * until a strong match comes along.
+ * another layer to consider is match strength. a raw domain, MATCH_WEAK,
+ * blocks only itself: it sorts ahead of its children like any parent but does
+ * not block them. a MATCH_FULL entry and a raw domain of the same name are not
+ * equal: the MATCH_FULL entry blocks the raw domain as it would a child and
+ * sorts ahead of it.
  */
-static int compare_dv(DomainView_t dv_A, DomainView_t dv_B)
+int compare_dv(DomainView_t const dv_A[static 1],
+		DomainView_t const dv_B[static 1])
 {
 	// probably points to an array of the full set of domainviews that
 	// themselves point to entries in the buffer which is held by the context.
@@ -166,34 +162,34 @@ static int compare_dv(DomainView_t dv_A, DomainView_t dv_B)
 	// could compute a hash, store it, then comare against a hash of the other.
 
 	int last_cmp = -1;
-	ASSERT(dv_A.fqd.len > 0);
-	ASSERT(dv_B.fqd.len > 0);
-	ASSERT(dv_A.fqd.data);
-	ASSERT(dv_B.fqd.data);
-	ASSERT(dv_A.segs_used > 0);
-	ASSERT(dv_B.segs_used > 0);
-	//printf("A segs used=%u\n", dv_A.segs_used);
-	//printf("B segs used=%u\n", dv_B.segs_used);
-	for(uint i = 0, j = 0; i < dv_A.segs_used && j < dv_B.segs_used;
+	ASSERT(dv_A->fqd.len > 0);
+	ASSERT(dv_B->fqd.len > 0);
+	ASSERT(dv_A->fqd.data);
+	ASSERT(dv_B->fqd.data);
+	ASSERT(dv_A->segs_used > 0);
+	ASSERT(dv_B->segs_used > 0);
+	//printf("A segs used=%u\n", dv_A->segs_used);
+	//printf("B segs used=%u\n", dv_B->segs_used);
+	for(uint i = 0, j = 0; i < dv_A->segs_used && j < dv_B->segs_used;
 			i++, j++)
 	{
 		int ret = memcmp(
-				dv_A.fqd.data + dv_A.label_indexes[i],
-				dv_B.fqd.data + dv_B.label_indexes[j],
-				MIN(dv_A.lengths[i], dv_B.lengths[j]));
+				dv_A->fqd.data + dv_A->label_indexes[i],
+				dv_B->fqd.data + dv_B->label_indexes[j],
+				MIN(dv_A->lengths[i], dv_B->lengths[j]));
 
 		if(ret == 0)
 		{
-			ret = dv_A.lengths[i] - dv_B.lengths[j];
+			ret = dv_A->lengths[i] - dv_B->lengths[j];
 		}
 
 #if 0
 		printf("A the segment under inspection: >");
-		fwrite(dv_A.fqd.data + dv_A.label_indexes[i], 1, dv_A.lengths[i], stdout);
+		fwrite(dv_A->fqd.data + dv_A->label_indexes[i], 1, dv_A->lengths[i], stdout);
 		printf("<\n");
 
 		printf("VS\nB the segment under inspection: >");
-		fwrite(dv_B.fqd.data + dv_B.label_indexes[i], 1, dv_B.lengths[i], stdout);
+		fwrite(dv_B->fqd.data + dv_B->label_indexes[i], 1, dv_B->lengths[i], stdout);
 		printf("<\n\n");
 #endif
 
@@ -217,12 +213,12 @@ static int compare_dv(DomainView_t dv_A, DomainView_t dv_B)
 			//
 			// ads.google.com - A - write; advance
 			// ads.google.com - B - advance
-			//long long ret_seg = dv_A.segs_used - dv_B.segs_used;
-			if(dv_A.segs_used == dv_B.segs_used)
+			//long long ret_seg = dv_A->segs_used - dv_B->segs_used;
+			if(dv_A->segs_used == dv_B->segs_used)
 			{
 				last_cmp = dv_A_eq_dv_B;
 			}
-			else if(dv_A.segs_used < dv_B.segs_used)
+			else if(dv_A->segs_used < dv_B->segs_used)
 			{
 				last_cmp = dv_A_blk_dv_B;
 			}
@@ -284,6 +280,19 @@ static int compare_dv(DomainView_t dv_A, DomainView_t dv_B)
 	}
 
 	ASSERT(last_cmp != -1);
+	if(last_cmp == dv_A_eq_dv_B && dv_A->match_strength != dv_B->match_strength)
+	{
+		last_cmp = dv_A->match_strength == MATCH_FULL ? dv_A_blk_dv_B :
+			dv_B_blk_dv_A;
+	}
+	else if(last_cmp == dv_A_blk_dv_B && dv_A->match_strength != MATCH_FULL)
+	{
+		last_cmp = dv_A_lt_dv_B_write_A;
+	}
+	else if(last_cmp == dv_B_blk_dv_A && dv_B->match_strength != MATCH_FULL)
+	{
+		last_cmp = dv_A_gt_dv_B_write_B;
+	}
 	return last_cmp;
 }
 
@@ -349,9 +358,56 @@ static void action_dv(int cmp,
 }
 
 
+/**
+ * True if the entry belongs in the result of the set operation. An entry
+ * blocked by a parent in the other input is written as a LOSER: it is in the
+ * intersection and in neither difference.
+ */
+static bool in_set_operation(enum diff_output output, char code, char marker)
+{
+	switch(output)
+	{
+		case DIFF_INTERSECTION:
+			return code == NEUTRAL || code == LOSER;
+		case DIFF_A_MINUS_B:
+			return code == WINNER && marker == 'a';
+		case DIFF_SYMMETRIC:
+			return code == WINNER;
+		case DIFF_REPORT:
+		default:
+			break;
+	}
+	ASSERT(false && "output is not a set operation");
+	return false;
+}
+
 static void core_write_DV(FILE *out_file, const char buffer[static 1],
-		size_len_t line_len, char code, char marker)
+		size_len_t line_len, DomainView_t const dv[static 1], char code,
+		char marker, enum diff_output output)
 {
+	if(output == DIFF_DELTA)
+	{
+		// what is in A and not in B is removed; what is in B and not in A is
+		// added. entries in both are not recorded.
+		if(code != NEUTRAL)
+		{
+			pfb_write_delta_record(out_file, dv, marker == 'b');
+			pfb_stats_count(PFB_STATS_OUTPUT_LINES, 1);
+		}
+		return;
+	}
+	else if(output != DIFF_REPORT)
+	{
+		// a clean adlist: no markers.
+		if(in_set_operation(output, code, marker))
+		{
+			fwrite(buffer, sizeof(char), line_len, out_file);
+			fprintf(out_file, "\n");
+			pfb_stats_count(PFB_STATS_OUTPUT_LINES, 1);
+		}
+		return;
+	}
+
 	// options to write only the new entries added by 'a', or mark only those
 	// added by 'a' as plus, mark all removals from 'a' and 'b', etc.
 	if(code == NEUTRAL)
@@ -376,6 +432,7 @@ static void core_write_DV(FILE *out_file, const char buffer[static 1],
 	}
 	fwrite(buffer, sizeof(char), line_len, out_file);
 	fprintf(out_file, "\n");
+	pfb_stats_count(PFB_STATS_OUTPUT_LINES, 1);
 }
 
 static void write_DV_FILE_iter(void *iter_in, char code)
@@ -386,7 +443,8 @@ static void write_DV_FILE_iter(void *iter_in, char code)
 	if(iter->written == false)
 	{
 		core_write_DV(iter->out_context->out_file, iter->buffer,
-				iter->li[iter->cur_li_idx].line_len, code, iter->marker);
+				iter->li[iter->cur_li_idx].line_len, &iter->dv, code,
+				iter->marker, iter->output);
 		iter->written = true;
 	}
 }
@@ -403,8 +461,8 @@ static void write_DV_BUFFER_iter(void *iter_in, char code)
 		// newline characters that come between. theoretically one newline.
 		core_write_DV(iter->out_context->out_file, iter->buffer +
 				iter->li[iter->cur_li_idx].offset,
-				iter->li[iter->cur_li_idx].line_len,
-				code, iter->marker);
+				iter->li[iter->cur_li_idx].line_len, &iter->dv,
+				code, iter->marker, iter->output);
 		iter->written = true;
 	}
 }
@@ -413,7 +471,7 @@ static void write_DV_BUFFER_iter(void *iter_in, char code)
 /**
  * Process clean lines. Expectations:
  *
- * null terminated, MATCH_FULL
+ * null terminated, MATCH_FULL or MATCH_WEAK
  */
 static bool process_one_line(DomainView_t dv[static 1], const char *const str)
 {
@@ -424,12 +482,14 @@ static bool process_one_line(DomainView_t dv[static 1], const char *const str)
 	ASSERT(parsed_ok);
 	UNUSED(parsed_ok);
 
-	ASSERT(lv.ms == MATCH_FULL);
+	ASSERT(lv.ms == MATCH_FULL || lv.ms == MATCH_WEAK);
 
 	const bool update_dv_ok = update_DomainView(dv, lv.data, lv.len);
 	ASSERT(update_dv_ok);
 	UNUSED(update_dv_ok);
 
+	dv->match_strength = lv.ms;
+
 	return true;
 }
 
@@ -598,10 +658,10 @@ static void free_DV_BUFFER_iter(DV_BUFFER_iter_t iter[static 1])
 }
 
 
-void diff_adbplus_adlists_FILE(pfb_context_t pcc_A[static 1],
+static void do_diff_adbplus_adlists_FILE(pfb_context_t pcc_A[static 1],
 		const LiteLineData_t litelines_A[static 1],
 		pfb_context_t pcc_B[static 1], const LiteLineData_t litelines_B[static 1],
-		pfb_out_context_t out_context[static 1])
+		pfb_out_context_t out_context[static 1], enum diff_output output)
 {
 	ASSERT(pcc_A);
 	ASSERT(pcc_B);
@@ -627,6 +687,7 @@ void diff_adbplus_adlists_FILE(pfb_context_t pcc_A[static 1],
 		.dv = {},
 		.written = false,
 		.marker = 'a',
+		.output = output,
 		.li_used = litelines_A->used,
 		.li = litelines_A->li,
 		.cur_li_idx = 0,
@@ -646,6 +707,7 @@ void diff_adbplus_adlists_FILE(pfb_context_t pcc_A[static 1],
 		.dv = {},
 		.written = false,
 		.marker = 'b',
+		.output = output,
 		.li_used = litelines_B->used,
 		.li = litelines_B->li,
 		.cur_li_idx = 0,
@@ -688,7 +750,7 @@ void diff_adbplus_adlists_FILE(pfb_context_t pcc_A[static 1],
 
 	do
 	{
-		int cmp = compare_dv(dv_iterA.dv, dv_iterB.dv);
+		int cmp = compare_dv(&dv_iterA.dv, &dv_iterB.dv);
 		action_dv(cmp, write_DV_FILE_iter, advance_DV_FILE_iter, &dv_iterA, &dv_iterB);
 	} while(dv_iterA.cur_li_idx < dv_iterA.li_used &&
 			dv_iterB.cur_li_idx < dv_iterB.li_used);
@@ -719,6 +781,17 @@ void diff_adbplus_adlists_FILE(pfb_context_t pcc_A[static 1],
 	free_DV_FILE_iter(&dv_iterB);
 }
 
+void diff_adbplus_adlists_FILE(pfb_context_t pcc_A[static 1],
+		const LiteLineData_t litelines_A[static 1],
+		pfb_context_t pcc_B[static 1], const LiteLineData_t litelines_B[static 1],
+		pfb_out_context_t out_context[static 1], enum diff_output output)
+{
+	const pfb_phase_clock_t clock = pfb_stats_begin(PFB_PHASE_DIFF);
+	do_diff_adbplus_adlists_FILE(pcc_A, litelines_A, pcc_B, litelines_B,
+			out_context, output);
+	pfb_stats_end(&clock);
+}
+
 
 /**
  * AdbplusView_t requires null terminated strings.
@@ -732,8 +805,9 @@ void diff_adbplus_adlists_FILE(pfb_context_t pcc_A[static 1],
  * possibly the construction of the buffer adds \0 at strategic locations since
  * the input is no longer a meaningful file to write to disk.
  */
-void diff_adbplus_adlists_BUFFER(pfb_out_buffer_t pcc_A[static 1],
-		pfb_out_buffer_t pcc_B[static 1], pfb_out_context_t out_context[static 1])
+static void do_diff_adbplus_adlists_BUFFER(pfb_out_buffer_t pcc_A[static 1],
+		pfb_out_buffer_t pcc_B[static 1], pfb_out_context_t out_context[static 1],
+		enum diff_output output)
 {
 	ASSERT(pcc_A);
 	ASSERT(pcc_B);
@@ -758,6 +832,7 @@ void diff_adbplus_adlists_BUFFER(pfb_out_buffer_t pcc_A[static 1],
 		.dv = {},
 		.written = false,
 		.marker = 'a',
+		.output = output,
 		.li_used = pcc_A->litelines.used,
 		.li = pcc_A->litelines.li,
 		.cur_li_idx = 0,
@@ -784,6 +859,7 @@ void diff_adbplus_adlists_BUFFER(pfb_out_buffer_t pcc_A[static 1],
 		.dv = {},
 		.written = false,
 		.marker = 'b',
+		.output = output,
 		.li_used = pcc_B->litelines.used,
 		.li = pcc_B->litelines.li,
 		.cur_li_idx = 0,
@@ -809,7 +885,7 @@ void diff_adbplus_adlists_BUFFER(pfb_out_buffer_t pcc_A[static 1],
 	UNUSED(action_dv_collector);
 	do
 	{
-		int cmp = compare_dv(dv_iterA.dv, dv_iterB.dv);
+		int cmp = compare_dv(&dv_iterA.dv, &dv_iterB.dv);
 		action_dv(cmp, write_DV_BUFFER_iter, advance_DV_BUFFER_iter, &dv_iterA, &dv_iterB);
 	} while(dv_iterA.cur_li_idx < dv_iterA.li_used &&
 			dv_iterB.cur_li_idx < dv_iterB.li_used);
@@ -831,3 +907,473 @@ void diff_adbplus_adlists_BUFFER(pfb_out_buffer_t pcc_A[static 1],
 	free_DV_BUFFER_iter(&dv_iterA);
 	free_DV_BUFFER_iter(&dv_iterB);
 }
+
+void diff_adbplus_adlists_BUFFER(pfb_out_buffer_t pcc_A[static 1],
+		pfb_out_buffer_t pcc_B[static 1], pfb_out_context_t out_context[static 1],
+		enum diff_output output)
+{
+	const pfb_phase_clock_t clock = pfb_stats_begin(PFB_PHASE_DIFF);
+	do_diff_adbplus_adlists_BUFFER(pcc_A, pcc_B, out_context, output);
+	pfb_stats_end(&clock);
+}
+
+
+/**
+ * One sorted, de-duplicated input to the k-way merge.
+ */
+typedef struct DV_merge_stream
+{
+	pfb_out_buffer_t const *in;
+	DomainView_t dv;
+	// current index into the litelines of 'in'
+	size_len_t cur_li_idx;
+	// position of 'in' in the array given to the merge; ties between equal
+	// entries are broken by this so owners are reported in ascending order.
+	uint index;
+} DV_merge_stream_t;
+
+/**
+ * An entry already visited which may be the parent of entries yet to come.
+ */
+typedef struct DV_merge_parent
+{
+	DomainView_t dv;
+	// bit per input; set when the input holds this entry.
+	bool *owned;
+} DV_merge_parent_t;
+
+/**
+ * True if stream 'a' must be visited before stream 'b'.
+ */
+static bool merge_stream_lt(DV_merge_stream_t const a[static 1],
+		DV_merge_stream_t const b[static 1])
+{
+	const int cmp = compare_dv(&a->dv, &b->dv);
+	if(cmp == dv_A_eq_dv_B)
+	{
+		return a->index < b->index;
+	}
+	return cmp == dv_A_lt_dv_B_write_A || cmp == dv_A_blk_dv_B;
+}
+
+static void merge_heap_push(DV_merge_stream_t *heap[], uint used[static 1],
+		DV_merge_stream_t s[static 1])
+{
+	uint i = (*used)++;
+	heap[i] = s;
+	while(i > 0)
+	{
+		const uint parent = (i - 1) / 2;
+		if(!merge_stream_lt(heap[i], heap[parent]))
+			break;
+		DV_merge_stream_t *tmp = heap[parent];
+		heap[parent] = heap[i];
+		heap[i] = tmp;
+		i = parent;
+	}
+}
+
+static DV_merge_stream_t *merge_heap_pop(DV_merge_stream_t *heap[],
+		uint used[static 1])
+{
+	ASSERT(*used > 0);
+	DV_merge_stream_t *top = heap[0];
+	heap[0] = heap[--(*used)];
+
+	uint i = 0;
+	while(true)
+	{
+		const uint l = 2 * i + 1;
+		const uint r = l + 1;
+		uint least = i;
+		if(l < *used && merge_stream_lt(heap[l], heap[least]))
+			least = l;
+		if(r < *used && merge_stream_lt(heap[r], heap[least]))
+			least = r;
+		if(least == i)
+			break;
+		DV_merge_stream_t *tmp = heap[least];
+		heap[least] = heap[i];
+		heap[i] = tmp;
+		i = least;
+	}
+	return top;
+}
+
+/**
+ * Move the stream to its next entry. Returns false once the stream is
+ * exhausted.
+ */
+static bool advance_merge_stream(DV_merge_stream_t s[static 1])
+{
+	if(s->cur_li_idx >= s->in->litelines.used)
+		return false;
+
+	process_one_line(&s->dv, s->in->buffer +
+			s->in->litelines.li[s->cur_li_idx].offset);
+	return true;
+}
+
+/**
+ * k-way merge of any number of de-duplicated, sorted in-memory buffers. Every
+ * distinct entry is handed to 'visitor' exactly once, in the same order a diff
+ * would write it, along with the inputs holding it and the inputs holding a
+ * MATCH_FULL parent of it.
+ *
+ * Each input must be the output of the BUFFER writer: null terminated lines
+ * with no entry blocked by another in the same input.
+ */
+static void do_merge_adbplus_adlists_BUFFER(pfb_out_buffer_t *const in[], uint count,
+		void (*visitor)(DV_merge_group_t const group[static 1], void *context),
+		void *context)
+{
+	ASSERT(in);
+	ASSERT(visitor);
+
+	if(count == 0)
+		return;
+
+	DV_merge_stream_t *streams = calloc(count, sizeof(DV_merge_stream_t));
+	CHECK_MALLOC(streams);
+	DV_merge_stream_t **heap = calloc(count, sizeof(DV_merge_stream_t*));
+	CHECK_MALLOC(heap);
+	// streams holding the entry currently visited
+	DV_merge_stream_t **group = calloc(count, sizeof(DV_merge_stream_t*));
+	CHECK_MALLOC(group);
+	// one pending parent per input is enough unless an input blocks entries
+	// of its own; the stack grows when it does.
+	uint parents_alloc = count;
+	DV_merge_parent_t *parents = calloc(parents_alloc, sizeof(DV_merge_parent_t));
+	CHECK_MALLOC(parents);
+	uint *owners = calloc(count, sizeof(uint));
+	CHECK_MALLOC(owners);
+	size_len_t *positions = calloc(count, sizeof(size_len_t));
+	CHECK_MALLOC(positions);
+	uint *covered_by = calloc(count, sizeof(uint));
+	CHECK_MALLOC(covered_by);
+	// scratch to gather the inputs covering the current entry
+	bool *covering = calloc(count, sizeof(bool));
+	CHECK_MALLOC(covering);
+
+	uint heap_used = 0;
+	for(uint i = 0; i < count; i++)
+	{
+		ASSERT(in[i]);
+		streams[i].in = in[i];
+		streams[i].index = i;
+		streams[i].cur_li_idx = 0;
+		init_DomainView(&streams[i].dv);
+
+		init_DomainView(&parents[i].dv);
+		parents[i].owned = calloc(count, sizeof(bool));
+		CHECK_MALLOC(parents[i].owned);
+
+		if(advance_merge_stream(&streams[i]))
+		{
+			merge_heap_push(heap, &heap_used, &streams[i]);
+		}
+	}
+
+	uint parents_used = 0;
+	while(heap_used > 0)
+	{
+		DV_merge_stream_t *first = merge_heap_pop(heap, &heap_used);
+		uint owners_used = 0;
+		group[owners_used++] = first;
+		while(heap_used > 0 &&
+				compare_dv(&heap[0]->dv, &first->dv) == dv_A_eq_dv_B)
+		{
+			group[owners_used++] = merge_heap_pop(heap, &heap_used);
+		}
+		// a group is of one strength; a raw domain is visited after a
+		// MATCH_FULL entry of the same name, which covers it.
+		for(uint i = 0; i < owners_used; i++)
+		{
+			owners[i] = group[i]->index;
+			positions[i] = group[i]->cur_li_idx;
+		}
+
+		// drop pending parents that are not a parent of this entry. what
+		// remains is the chain of parents leading to this entry.
+		while(parents_used > 0 &&
+				compare_dv(&parents[parents_used - 1].dv, &first->dv) != dv_A_blk_dv_B)
+		{
+			parents_used--;
+		}
+
+		memset(covering, 0, count * sizeof(bool));
+		for(uint p = 0; p < parents_used; p++)
+		{
+			for(uint i = 0; i < count; i++)
+			{
+				covering[i] |= parents[p].owned[i];
+			}
+		}
+		uint covered_used = 0;
+		for(uint i = 0; i < count; i++)
+		{
+			if(covering[i])
+			{
+				covered_by[covered_used++] = i;
+			}
+		}
+
+		const line_info_t li = first->in->litelines.li[first->cur_li_idx];
+		const DV_merge_group_t visit = {
+			.line = first->in->buffer + li.offset,
+			.line_len = li.line_len,
+			.dv = &first->dv,
+			.owners = owners,
+			.owners_used = owners_used,
+			.positions = positions,
+			.covered_by = covered_by,
+			.covered_used = covered_used,
+		};
+		visitor(&visit, context);
+
+		if(first->dv.match_strength == MATCH_FULL)
+		{
+			if(parents_used == parents_alloc)
+			{
+				CHECK_REALLOC(parents, 2 * parents_alloc * sizeof(DV_merge_parent_t));
+				for(uint i = parents_alloc; i < 2 * parents_alloc; i++)
+				{
+					init_DomainView(&parents[i].dv);
+					parents[i].owned = calloc(count, sizeof(bool));
+					CHECK_MALLOC(parents[i].owned);
+				}
+				parents_alloc *= 2;
+			}
+			// swap rather than copy; the DomainView points into the input
+			// buffer which outlives the merge. the stream re-uses whatever
+			// the parent slot held on its next advance.
+			DV_merge_parent_t *parent = &parents[parents_used++];
+			memset(parent->owned, 0, count * sizeof(bool));
+			for(uint i = 0; i < owners_used; i++)
+			{
+				parent->owned[owners[i]] = true;
+			}
+
+			DomainView_t tmp = parent->dv;
+			parent->dv = first->dv;
+			first->dv = tmp;
+		}
+
+		for(uint i = 0; i < owners_used; i++)
+		{
+			group[i]->cur_li_idx++;
+			if(advance_merge_stream(group[i]))
+			{
+				merge_heap_push(heap, &heap_used, group[i]);
+			}
+		}
+	}
+
+	for(uint i = 0; i < count; i++)
+	{
+		free_DomainView(&streams[i].dv);
+	}
+	for(uint i = 0; i < parents_alloc; i++)
+	{
+		free_DomainView(&parents[i].dv);
+		free(parents[i].owned);
+	}
+	free(covering);
+	free(covered_by);
+	free(positions);
+	free(owners);
+	free(parents);
+	free(group);
+	free(heap);
+	free(streams);
+}
+
+void merge_adbplus_adlists_BUFFER(pfb_out_buffer_t *const in[], uint count,
+		void (*visitor)(DV_merge_group_t const group[static 1], void *context),
+		void *context)
+{
+	const pfb_phase_clock_t clock = pfb_stats_begin(PFB_PHASE_MERGE);
+	do_merge_adbplus_adlists_BUFFER(in, count, visitor, context);
+	pfb_stats_end(&clock);
+}
+
+
+enum merge3_inputs
+{
+	MERGE3_BASE = 0,
+	MERGE3_OURS = 1,
+	MERGE3_THEIRS = 2,
+	MERGE3_COUNT = 3,
+};
+
+enum merge3_codes : char
+{
+	ADDED='+',
+	REMOVED='-',
+	CONFLICT='!',
+};
+
+/**
+ * Per entry of a three-way merge: whether each input holds it exactly and
+ * whether each input blocks it, either exactly or by a parent.
+ */
+typedef struct merge3_state
+{
+	bool own[MERGE3_COUNT];
+	bool blocked[MERGE3_COUNT];
+} merge3_state_t;
+
+static void write_merge3_line(FILE *out_file, DV_merge_group_t const
+		group[static 1], char code, bool ours, bool theirs)
+{
+	ASSERT(ours || theirs);
+	const char marker = ours && theirs ? 'b' : (ours ? 'o' : 't');
+	fprintf(out_file, "%c%c", code, marker);
+	fwrite(group->line, sizeof(char), group->line_len, out_file);
+	fprintf(out_file, "\n");
+	pfb_stats_count(PFB_STATS_OUTPUT_LINES, 1);
+}
+
+/**
+ * Classify one entry of the merge of base, ours, and theirs:
+ *
+ * +o, +t, +b entry added by ours, theirs, or both; not blocked in base.
+ * -o, -t, -b entry of base no longer blocked by ours, theirs, or both.
+ * !o, !t     entry added by one side beneath a parent in base which the other
+ *            side removed.
+ *
+ * An entry added beneath a parent that every side still blocks changes
+ * nothing and is not written.
+ */
+static void visit_merge3(DV_merge_group_t const group[static 1], void *context)
+{
+	pfb_out_context_t *out_context = context;
+	ASSERT(out_context);
+	ASSERT(out_context->out_file);
+
+	merge3_state_t st = {};
+	for(uint i = 0; i < group->owners_used; i++)
+	{
+		ASSERT(group->owners[i] < MERGE3_COUNT);
+		st.own[group->owners[i]] = true;
+		st.blocked[group->owners[i]] = true;
+	}
+	for(uint i = 0; i < group->covered_used; i++)
+	{
+		ASSERT(group->covered_by[i] < MERGE3_COUNT);
+		st.blocked[group->covered_by[i]] = true;
+	}
+
+	FILE *out_file = out_context->out_file;
+	if(st.own[MERGE3_BASE])
+	{
+		const bool ours = !st.blocked[MERGE3_OURS];
+		const bool theirs = !st.blocked[MERGE3_THEIRS];
+		if(ours || theirs)
+		{
+			write_merge3_line(out_file, group, REMOVED, ours, theirs);
+			out_context->counter++;
+		}
+	}
+	else if(!st.blocked[MERGE3_BASE])
+	{
+		write_merge3_line(out_file, group, ADDED, st.own[MERGE3_OURS],
+				st.own[MERGE3_THEIRS]);
+		out_context->counter++;
+	}
+	else
+	{
+		// blocked in base by a parent. if one side holds the entry while the
+		// other side no longer blocks it, the other side removed the parent.
+		const bool ours = st.own[MERGE3_OURS] && !st.blocked[MERGE3_THEIRS];
+		const bool theirs = st.own[MERGE3_THEIRS] && !st.blocked[MERGE3_OURS];
+		if(ours || theirs)
+		{
+			write_merge3_line(out_file, group, CONFLICT, ours, theirs);
+			out_context->counter++;
+		}
+	}
+}
+
+/**
+ * Three-way merge of de-duplicated and sorted in-memory buffers: write the
+ * changes made by 'ours' and by 'theirs' since 'base' as a compact change set
+ * in a single pass over the three inputs.
+ */
+void merge3_adbplus_adlists_BUFFER(pfb_out_buffer_t base[static 1],
+		pfb_out_buffer_t ours[static 1], pfb_out_buffer_t theirs[static 1],
+		pfb_out_context_t out_context[static 1])
+{
+	ASSERT(out_context);
+	ASSERT(out_context->out_file);
+
+	pfb_out_buffer_t *const in[MERGE3_COUNT] = {
+		[MERGE3_BASE] = base,
+		[MERGE3_OURS] = ours,
+		[MERGE3_THEIRS] = theirs,
+	};
+
+	merge_adbplus_adlists_BUFFER(in, MERGE3_COUNT, visit_merge3, out_context);
+}
+
+
+static void visit_union(DV_merge_group_t const group[static 1], void *context)
+{
+	pfb_out_context_t *out_context = context;
+	ASSERT(out_context);
+	ASSERT(out_context->writer_cb);
+
+	// blocked by a parent from another input; the parent was already written.
+	if(group->covered_used > 0)
+		return;
+
+	if(out_context->allow)
+	{
+		pfb_write_allowed(out_context, group->line, group->line_len,
+				group->dv->match_strength);
+		return;
+	}
+
+	out_context->writer_cb(group->line, group->line_len, out_context);
+	out_context->counter++;
+}
+
+/**
+ * De-duplicate already de-duplicated and sorted in-memory buffers against one
+ * another: write each distinct entry once, omitting entries blocked by a
+ * parent from another input, in sorted order to the given context.
+ *
+ * The exceptions kept with each input are subtracted from the entries of every
+ * input, as if the inputs were read together, unless the context already has
+ * exceptions of its own; an in-memory output keeps them in turn.
+ */
+void union_adbplus_adlists_BUFFER(pfb_out_buffer_t *const in[], uint count,
+		pfb_out_context_t out_context[static 1])
+{
+	bool has_allowed = false;
+	for(uint i = 0; i < count; i++)
+	{
+		has_allowed = has_allowed || in[i]->allowed_len > 0;
+	}
+	if(out_context->allow || !has_allowed)
+	{
+		merge_adbplus_adlists_BUFFER(in, count, visit_union, out_context);
+		return;
+	}
+
+	pfb_allow_t allow = pfb_init_allow(false);
+	for(uint i = 0; i < count; i++)
+	{
+		pfb_insert_allowed(&allow, in[i]->allowed, in[i]->allowed_len);
+	}
+	out_context->allow = &allow;
+	if(pfb_is_out_context_BUFFER(out_context))
+	{
+		pfb_keep_allowed(&allow, out_context->out_buffer);
+	}
+
+	merge_adbplus_adlists_BUFFER(in, count, visit_union, out_context);
+
+	out_context->allow = nullptr;
+	pfb_free_allow(&allow);
+}
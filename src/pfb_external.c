@@ -0,0 +1,341 @@
+/**
+ * pfb_external.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// fmemopen(), mkdtemp(), and unlink() are POSIX; -std=c23 declares only ISO C
+// otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "dedupdomains.h"
+#include "pfb_allow.h"
+#include "pfb_context.h"
+#include "pfb_differ.h"
+#include "pfb_external.h"
+#include "pfb_index.h"
+#include "pfb_memory.h"
+#include "pfb_prune.h"
+#include "tld_hash_context.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * De-duplicate inputs larger than memory. The inputs are read in chunks small
+ * enough that the DomainTree of one chunk fits the budget; each chunk is
+ * de-duplicated on its own and spilled to a temporary index, a sorted run.
+ * The runs are mapped and combined in a single k-way merge, which drops the
+ * entries blocked by a parent from another run exactly as a tree of all of
+ * the inputs would, and streams the result to the output. Only one chunk and
+ * its tree are held in memory at a time; the runs are paged in from disk by
+ * the merge. The header and comments of a single plain text input are kept
+ * and written ahead of the entries, as the tree of -D does.
+ */
+
+#define EXTERNAL_MIN_CHUNK (1 << 16)
+
+typedef struct external_runs
+{
+	// directory holding the runs until each is mapped
+	char *dir;
+	// the exception rules of every chunk; subtracted at the merge where the
+	// entries of all of the chunks meet.
+	pfb_allow_t *allow;
+	pfb_out_buffer_t *runs;
+	uint used;
+	uint alloc;
+	// the carried over lines of every chunk in order, each null terminated;
+	// only kept if true.
+	bool keep_carry_over;
+	char *carry_over;
+	size_t carry_over_len;
+	size_t carry_over_alloc;
+} external_runs_t;
+
+static pfb_out_buffer_t *next_run(external_runs_t er[static 1])
+{
+	if(er->used == er->alloc)
+	{
+		er->alloc = MAX(2 * er->alloc, 16u);
+		CHECK_REALLOC(er->runs, sizeof(pfb_out_buffer_t) * er->alloc);
+	}
+	return &er->runs[er->used];
+}
+
+/**
+ * Write 'sorted' as the next run and map it in its place. The file is removed
+ * once mapped; the mapping keeps its pages until the merge is done.
+ */
+static bool spill_run(external_runs_t er[static 1],
+		pfb_out_buffer_t sorted[static 1])
+{
+	const size_t len = strlen(er->dir) + 32;
+	char *run_fname = malloc(len);
+	CHECK_MALLOC(run_fname);
+	snprintf(run_fname, len, "%s%crun.%u", er->dir, PATH_SEP_CHAR, er->used);
+
+	bool ok = false;
+	FILE *out_file = fopen(run_fname, "wb");
+	if(out_file)
+	{
+		ok = pfb_write_index(out_file, sorted);
+		ok = fclose(out_file) == 0 && ok;
+	}
+	pfb_free_out_buffer(sorted);
+
+	if(!ok)
+	{
+		ELOG_STDERR("ERROR: failed to write the sorted run %s\n", run_fname);
+	}
+	else if(pfb_map_index(run_fname, next_run(er)))
+	{
+		er->used++;
+	}
+	else
+	{
+		ok = false;
+	}
+
+	unlink(run_fname);
+	free(run_fname);
+	return ok;
+}
+
+static void keep_carry_over(external_runs_t er[static 1],
+		pfb_context_t const c[static 1], char const data[])
+{
+	for(size_len_t i = 0; i < c->co.used; i++)
+	{
+		const line_info_t li = c->co.li[i];
+		if(er->carry_over_len + li.line_len + 1 > er->carry_over_alloc)
+		{
+			er->carry_over_alloc = MAX(2 * er->carry_over_alloc,
+					er->carry_over_len + li.line_len + 1024);
+			CHECK_REALLOC(er->carry_over, er->carry_over_alloc);
+		}
+		memcpy(er->carry_over + er->carry_over_len, data + li.offset,
+				li.line_len);
+		er->carry_over[er->carry_over_len + li.line_len] = '\0';
+		er->carry_over_len += li.line_len + 1;
+	}
+}
+
+static void write_carry_over(external_runs_t const er[static 1],
+		pfb_out_context_t out_context[static 1])
+{
+	for(size_t i = 0; i < er->carry_over_len; )
+	{
+		const size_t line_len = strlen(er->carry_over + i);
+		out_context->writer_cb(er->carry_over + i, line_len, out_context);
+		i += line_len + 1;
+	}
+}
+
+/**
+ * De-duplicate and sort 'len' bytes of whole lines into a run.
+ */
+static bool sort_chunk(external_runs_t er[static 1], char *data, size_t len)
+{
+	pfb_mem_charge(len + 1);
+	pfb_out_buffer_t sorted = {
+		.buffer = malloc(len + 1),
+		.alloc_len = len + 1,
+		.charged = len + 1,
+	};
+	CHECK_MALLOC(sorted.buffer);
+
+	FILE *in_file = fmemopen(data, len, "rb");
+	CHECK_MALLOC(in_file);
+
+	pfb_context_collect_t pcc = {
+		.out_context = pfb_init_out_context_BUFFER(&sorted),
+	};
+	pcc.in_contexts.begin_context = calloc(1, sizeof(pfb_context_t));
+	CHECK_MALLOC(pcc.in_contexts.begin_context);
+	pcc.in_contexts.end_context = pcc.in_contexts.begin_context + 1;
+	*pcc.in_contexts.begin_context = (pfb_context_t){
+		.in_file = in_file,
+		.file_size = len,
+		// the entries are re-read through the FILE; writing from a memory
+		// buffer is supported only to a FILE.
+		.use_mem_buffer = false,
+	};
+
+	TLD_implementation_t tld_impl = create_tld_hash_impl();
+	ASSERT(tld_impl.context);
+
+	pfb_read_all(tld_impl, er->allow, &pcc.in_contexts);
+	if(er->keep_carry_over)
+	{
+		keep_carry_over(er, pcc.in_contexts.begin_context, data);
+	}
+	pfb_consolidate(tld_impl, &pcc.out_context);
+
+	// without a name, the context leaves closing its FILE to its creator.
+	fclose(in_file);
+	pfb_free_context_collect(&pcc);
+	free_tld_impl(&tld_impl);
+
+	return spill_run(er, &sorted);
+}
+
+/**
+ * Cut the plain text input at 'path' into chunks of at most 'chunk_len' bytes
+ * ending at a line break and spill each as a run.
+ */
+static bool spill_input(external_runs_t er[static 1], const char path[static 1],
+		char chunk[], size_t chunk_len)
+{
+	FILE *in_file = fopen(path, "rb");
+	if(!in_file)
+	{
+		ELOG_STDERR("ERROR: failed to open %s for reading\n", path);
+		return false;
+	}
+
+	bool ok = true;
+	size_t used = 0;
+	size_t read;
+	while(ok && (read = fread(chunk + used, 1, chunk_len - used, in_file)) > 0)
+	{
+		used += read;
+		if(used < chunk_len)
+		{
+			continue;
+		}
+
+		// the partial last line is carried to the next chunk. a line longer
+		// than a whole chunk is split in two.
+		size_t cut = used;
+		while(cut > 0 && chunk[cut - 1] != '\n')
+		{
+			cut--;
+		}
+		if(cut == 0)
+		{
+			cut = used;
+		}
+		ok = sort_chunk(er, chunk, cut);
+		memmove(chunk, chunk + cut, used - cut);
+		used -= cut;
+	}
+
+	if(ferror(in_file))
+	{
+		ELOG_STDERR("ERROR: failed to read %s\n", path);
+		ok = false;
+	}
+	else if(ok && used > 0)
+	{
+		ok = sort_chunk(er, chunk, used);
+	}
+
+	fclose(in_file);
+	return ok;
+}
+
+/**
+ * De-duplicate the inputs of 'in_paths_list' holding no more than about
+ * 'budget_mb' MB in memory and write the sorted result to 'out_fname' or
+ * stdout if null. Indexes given as inputs are used as runs as they are.
+ */
+bool pfb_dedup_external(paths_list_t in_paths_list, const char *out_fname,
+		uint budget_mb)
+{
+	const char *tmp_dir = getenv("TMPDIR");
+	const size_t len = strlen(tmp_dir ? tmp_dir : "/tmp") + sizeof("/pfb-runs.XXXXXX");
+	external_runs_t er = {
+		.dir = malloc(len),
+		.keep_carry_over = in_paths_list.len == 1 &&
+			!in_paths_list.paths[0].is_index,
+	};
+	CHECK_MALLOC(er.dir);
+	snprintf(er.dir, len, "%s%cpfb-runs.XXXXXX", tmp_dir ? tmp_dir : "/tmp",
+			PATH_SEP_CHAR);
+	if(!mkdtemp(er.dir))
+	{
+		ELOG_STDERR("ERROR: failed to create a directory for the sorted runs in %s\n",
+				tmp_dir ? tmp_dir : "/tmp");
+		free(er.dir);
+		return false;
+	}
+
+	const size_t chunk_len = MAX((size_t)budget_mb * 1024 * 1024 /
+			PFB_EXTERNAL_TREE_FACTOR, (size_t)EXTERNAL_MIN_CHUNK);
+	pfb_mem_charge(chunk_len);
+	char *chunk = malloc(chunk_len);
+	CHECK_MALLOC(chunk);
+
+	pfb_allow_t allow = pfb_init_allow(true);
+	er.allow = &allow;
+
+	bool ok = true;
+	for(uint i = 0; ok && i < in_paths_list.len; i++)
+	{
+		if(in_paths_list.paths[i].is_index)
+		{
+			pfb_out_buffer_t *run = next_run(&er);
+			ok = pfb_map_index(in_paths_list.paths[i].path, run);
+			if(ok)
+			{
+				// the exceptions of an index apply to the other inputs too.
+				pfb_insert_allowed(&allow, run->allowed, run->allowed_len);
+				er.used++;
+			}
+		}
+		else
+		{
+			ok = spill_input(&er, in_paths_list.paths[i].path, chunk, chunk_len);
+		}
+	}
+	free(chunk);
+	pfb_mem_release(chunk_len);
+	rmdir(er.dir);
+
+	if(ok)
+	{
+		DEBUG_PRINTF("merging %u sorted runs\n", er.used);
+		pfb_out_buffer_t **in = calloc(MAX(er.used, 1u), sizeof(pfb_out_buffer_t*));
+		CHECK_MALLOC(in);
+		for(uint i = 0; i < er.used; i++)
+		{
+			in[i] = &er.runs[i];
+		}
+
+		pfb_out_context_t out_context = pfb_init_out_context(out_fname);
+		pfb_open_out_context(&out_context, false);
+		write_carry_over(&er, &out_context);
+		if(allow.count > 0)
+		{
+			out_context.allow = &allow;
+		}
+		union_adbplus_adlists_BUFFER(in, er.used, &out_context);
+		pfb_free_out_context(&out_context);
+		free(in);
+	}
+
+	for(uint i = 0; i < er.used; i++)
+	{
+		pfb_free_out_buffer(&er.runs[i]);
+	}
+	free(er.runs);
+	free(er.dir);
+	free(er.carry_over);
+	pfb_free_allow(&allow);
+	return ok;
+}
@@ -0,0 +1,226 @@
+/**
+ * pfb_format.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "dedupdomains.h"
+#include "pfb_format.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Write the entries of a de-duplicated list in the formats resolvers read.
+ * Every output of a chain of out contexts gets each entry in its own format;
+ * the entries are visited once for all of them.
+ */
+static const char *const format_names[] = {
+	[PFB_FORMAT_ADBPLUS] = "adbplus",
+	[PFB_FORMAT_DOMAINS] = "domains",
+	[PFB_FORMAT_HOSTS] = "hosts",
+	[PFB_FORMAT_DNSMASQ] = "dnsmasq",
+	[PFB_FORMAT_UNBOUND] = "unbound",
+	[PFB_FORMAT_RPZ] = "rpz",
+};
+
+// an RPZ zone needs an SOA and an NS record ahead of its policies.
+static const char *const rpz_header[] = {
+	"$TTL 300",
+	"@ IN SOA localhost. root.localhost. 1 3600 600 86400 300",
+	"  IN NS localhost.",
+};
+
+// long enough for any domain and the decoration of any format.
+#define FORMAT_LINE_MAX 1024
+
+/**
+ * Find the format named by the first 'len' characters of 'name'. Returns false
+ * if there is no such format.
+ */
+bool pfb_parse_format(const char *name, size_t len,
+		enum pfb_out_format format[static 1])
+{
+	for(uint i = 0; i < sizeof(format_names) / sizeof(format_names[0]); i++)
+	{
+		if(strlen(format_names[i]) == len && !memcmp(format_names[i], name, len))
+		{
+			*format = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Write what each output of the chain needs ahead of its entries.
+ */
+void pfb_write_format_headers(pfb_out_context_t out_context[static 1])
+{
+	for(pfb_out_context_t *c = out_context; c; c = c->next)
+	{
+		if(c->format != PFB_FORMAT_RPZ)
+			continue;
+
+		for(uint i = 0; i < sizeof(rpz_header) / sizeof(rpz_header[0]); i++)
+		{
+			c->writer_cb(rpz_header[i], strlen(rpz_header[i]), c);
+		}
+	}
+}
+
+static void write_line(pfb_out_context_t c[static 1], char line[static 1],
+		int len)
+{
+	ASSERT(len > 0 && len < FORMAT_LINE_MAX);
+	c->writer_cb(line, len, c);
+}
+
+/**
+ * Write the domain of one entry in the format of 'c'.
+ */
+static void write_domain(pfb_out_context_t c[static 1], const char *domain,
+		int len, MatchStrength_t ms)
+{
+	char line[FORMAT_LINE_MAX];
+	const bool full = ms == MATCH_FULL;
+
+	switch(c->format)
+	{
+		case PFB_FORMAT_DOMAINS:
+			write_line(c, line, snprintf(line, sizeof(line), "%.*s", len, domain));
+			break;
+		case PFB_FORMAT_HOSTS:
+			write_line(c, line, snprintf(line, sizeof(line), "0.0.0.0 %.*s", len,
+						domain));
+			break;
+		case PFB_FORMAT_DNSMASQ:
+			// address=/ covers the subdomains; a host record is the name alone.
+			write_line(c, line, full ?
+					snprintf(line, sizeof(line), "address=/%.*s/", len, domain) :
+					snprintf(line, sizeof(line), "host-record=%.*s,0.0.0.0", len,
+						domain));
+			break;
+		case PFB_FORMAT_UNBOUND:
+			// local data alone makes a transparent zone of the name alone.
+			write_line(c, line, full ?
+					snprintf(line, sizeof(line),
+						"local-zone: \"%.*s.\" always_nxdomain", len, domain) :
+					snprintf(line, sizeof(line), "local-data: \"%.*s. A 0.0.0.0\"",
+						len, domain));
+			break;
+		case PFB_FORMAT_RPZ:
+			write_line(c, line, snprintf(line, sizeof(line), "%.*s CNAME .", len,
+						domain));
+			if(full)
+			{
+				write_line(c, line, snprintf(line, sizeof(line), "*.%.*s CNAME .",
+							len, domain));
+			}
+			break;
+		case PFB_FORMAT_ADBPLUS:
+		default:
+			ASSERT(false && "adbplus lines are written as read");
+			break;
+	}
+}
+
+/**
+ * Write one entry to every output of the chain. 'line' is the entry as held by
+ * a de-duplicated list: '||domain^' for a MATCH_FULL entry and the raw domain
+ * for a MATCH_WEAK one. It need not be null terminated.
+ */
+void pfb_write_formatted(pfb_out_context_t out_context[static 1],
+		const char *line, line_len_t line_len, MatchStrength_t ms)
+{
+	ASSERT(line);
+	ASSERT(ms == MATCH_FULL || ms == MATCH_WEAK);
+
+	const char *domain = line;
+	int len = line_len;
+	if(ms == MATCH_FULL)
+	{
+		ASSERT(line_len > 3 && line[0] == '|' && line[line_len - 1] == '^');
+		domain += 2;
+		len -= 3;
+	}
+
+	for(pfb_out_context_t *c = out_context; c; c = c->next)
+	{
+		if(c->format == PFB_FORMAT_ADBPLUS)
+		{
+			c->writer_cb(line, line_len, c);
+		}
+		else if(len < FORMAT_LINE_MAX / 2)
+		{
+			write_domain(c, domain, len, ms);
+		}
+		else
+		{
+			ELOG_STDERR("WARNING: IGNORING entry of %d characters; too long for a domain\n",
+					len);
+			continue;
+		}
+		c->counter++;
+	}
+}
+
+/**
+ * Write an exception within an entry written before it to every output of the
+ * chain: the domain and its subdomains are not blocked. hosts and domains
+ * outputs block a parent alone and need none.
+ */
+void pfb_write_exception(pfb_out_context_t out_context[static 1],
+		const char *domain, size_len_t len)
+{
+	ASSERT(domain);
+	if(len >= FORMAT_LINE_MAX / 2)
+	{
+		return;
+	}
+
+	char line[FORMAT_LINE_MAX];
+	const int l = len;
+	for(pfb_out_context_t *c = out_context; c; c = c->next)
+	{
+		switch(c->format)
+		{
+			case PFB_FORMAT_ADBPLUS:
+				write_line(c, line, snprintf(line, sizeof(line), "@@||%.*s^", l,
+							domain));
+				break;
+			case PFB_FORMAT_DNSMASQ:
+				// resolved upstream as usual; the longer match wins.
+				write_line(c, line, snprintf(line, sizeof(line), "server=/%.*s/#", l,
+							domain));
+				break;
+			case PFB_FORMAT_UNBOUND:
+				write_line(c, line, snprintf(line, sizeof(line),
+							"local-zone: \"%.*s.\" transparent", l, domain));
+				break;
+			case PFB_FORMAT_RPZ:
+				write_line(c, line, snprintf(line, sizeof(line),
+							"%.*s CNAME rpz-passthru.", l, domain));
+				write_line(c, line, snprintf(line, sizeof(line),
+							"*.%.*s CNAME rpz-passthru.", l, domain));
+				break;
+			case PFB_FORMAT_DOMAINS:
+			case PFB_FORMAT_HOSTS:
+			default:
+				break;
+		}
+	}
+}
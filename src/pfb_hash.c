@@ -0,0 +1,78 @@
+/**
+ * pfb_hash.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "dedupdomains.h"
+#include "pfb_hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PFB_HASH_PRIME 0x100000001b3ULL
+#define PFB_HASH_CHUNK (1 << 16)
+
+/**
+ * FNV-1a over 'len' bytes continuing from 'seed'. Pass PFB_HASH_INIT as the
+ * seed to start a new hash. Only used to tell whether an input changed; not for anything
+ * that must resist collisions made on purpose.
+ */
+uint64_t pfb_hash64(void const *data, size_t len, uint64_t seed)
+{
+	unsigned char const *c = data;
+	uint64_t h = seed;
+	for(size_t i = 0; i < len; i++)
+	{
+		h ^= c[i];
+		h *= PFB_HASH_PRIME;
+	}
+	return h;
+}
+
+/**
+ * Hash the content of the file at 'path'. Returns false if the file could not
+ * be read.
+ */
+bool pfb_hash_file(const char path[static 1], uint64_t hash[static 1])
+{
+	FILE *f = fopen(path, "rb");
+	if(!f)
+	{
+		ELOG_STDERR("ERROR: failed to open %s for hashing\n", path);
+		return false;
+	}
+
+	char *chunk = malloc(PFB_HASH_CHUNK);
+	CHECK_MALLOC(chunk);
+
+	uint64_t h = PFB_HASH_INIT;
+	size_t n;
+	while((n = fread(chunk, 1, PFB_HASH_CHUNK, f)) > 0)
+	{
+		h = pfb_hash64(chunk, n, h);
+	}
+
+	const bool ok = !ferror(f);
+	if(!ok)
+	{
+		ELOG_STDERR("ERROR: failed to read %s for hashing\n", path);
+	}
+	free(chunk);
+	fclose(f);
+	*hash = h;
+	return ok;
+}
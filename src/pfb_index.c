@@ -0,0 +1,352 @@
+/**
+ * pfb_index.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// mmap() and posix_madvise() are POSIX; -std=c23 declares only ISO C otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "dedupdomains.h"
+#include "pfb_context.h"
+#include "pfb_index.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// the entries are mapped back as line_info_t; a change to it changes the format.
+static_assert(sizeof(line_info_t) == sizeof(pfb_index_entry_t) &&
+		offsetof(line_info_t, offset) == offsetof(pfb_index_entry_t, offset) &&
+		offsetof(line_info_t, line_len) == offsetof(pfb_index_entry_t, line_len) &&
+		sizeof(linenumber_t) == sizeof(int64_t) &&
+		sizeof(line_len_t) == sizeof(uint16_t),
+		"line_info_t layout is part of the index format");
+static_assert(sizeof(pfb_index_header_t) % 8 == 0, "entries must follow the header aligned");
+
+/**
+ * Returns true if the file at path begins with the index magic.
+ */
+bool pfb_is_index_file(const char path[static 1])
+{
+	FILE *f = fopen(path, "rb");
+	if(!f)
+	{
+		return false;
+	}
+
+	char magic[PFB_INDEX_MAGIC_LEN];
+	const size_t read = fread(magic, sizeof(char), PFB_INDEX_MAGIC_LEN, f);
+	fclose(f);
+
+	return read == PFB_INDEX_MAGIC_LEN &&
+		memcmp(magic, PFB_INDEX_MAGIC, PFB_INDEX_MAGIC_LEN) == 0;
+}
+
+static bool valid_range(uint64_t offset, uint64_t count, uint64_t size,
+		size_t file_size)
+{
+	return offset <= file_size && count <= (file_size - offset) / size;
+}
+
+static bool valid_index_header(pfb_index_header_t const h[static 1],
+		size_t file_size)
+{
+	if(memcmp(h->magic, PFB_INDEX_MAGIC, PFB_INDEX_MAGIC_LEN) != 0)
+		return false;
+	if(h->version != PFB_INDEX_VERSION)
+		return false;
+	if(h->byte_order != PFB_INDEX_BYTE_ORDER)
+		return false;
+	if(h->line_info_size != sizeof(line_info_t))
+		return false;
+	if(h->entry_count > UINT_MAX || h->shadow_count > UINT_MAX)
+		return false;
+	if(h->source_count > PFB_INDEX_MAX_SOURCES)
+		return false;
+	if(h->entries_offset % _Alignof(line_info_t) != 0 ||
+			h->shadow_entries_offset % _Alignof(line_info_t) != 0 ||
+			h->sources_offset % _Alignof(pfb_index_source_t) != 0 ||
+			h->masks_offset % _Alignof(uint64_t) != 0 ||
+			h->shadow_masks_offset % _Alignof(uint64_t) != 0 ||
+			h->allowed_masks_offset % _Alignof(uint64_t) != 0)
+		return false;
+	if(!valid_range(h->entries_offset, h->entry_count, sizeof(line_info_t), file_size))
+		return false;
+	if(!valid_range(h->strings_offset, h->strings_len, 1, file_size))
+		return false;
+	if(!valid_range(h->allowed_offset, h->allowed_len, 1, file_size))
+		return false;
+	if(h->source_count > 0)
+	{
+		if(!valid_range(h->sources_offset, h->source_count,
+					sizeof(pfb_index_source_t), file_size))
+			return false;
+		if(!valid_range(h->masks_offset, h->entry_count, sizeof(uint64_t), file_size))
+			return false;
+		if(!valid_range(h->shadow_entries_offset, h->shadow_count,
+					sizeof(line_info_t), file_size))
+			return false;
+		if(!valid_range(h->shadow_masks_offset, h->shadow_count,
+					sizeof(uint64_t), file_size))
+			return false;
+		if(!valid_range(h->allowed_masks_offset, h->allowed_count,
+					sizeof(uint64_t), file_size))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Returns false if any entry lies outside the string table.
+ */
+static bool valid_entries(line_info_t const li[], uint64_t count,
+		char const strings[], uint64_t strings_len)
+{
+	// bounds only; the entries themselves are never parsed here.
+	for(uint64_t i = 0; i < count; i++)
+	{
+		if(li[i].offset < 0 ||
+				(uint64_t)li[i].offset + li[i].line_len >= strings_len ||
+				strings[li[i].offset + li[i].line_len] != '\0')
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Map the index at 'path' read-only and make 'out_buffer' a view of its
+ * de-duplicated list. The view is released with pfb_free_out_buffer().
+ * Returns false if the file is not a usable index.
+ */
+bool pfb_map_index(const char path[static 1], pfb_out_buffer_t out_buffer[static 1])
+{
+	const int fd = open(path, O_RDONLY);
+	if(fd == -1)
+	{
+		ELOG_STDERR("ERROR: failed to open index %s for reading\n", path);
+		return false;
+	}
+
+	struct stat s;
+	if(fstat(fd, &s) != 0 || (size_t)s.st_size < sizeof(pfb_index_header_t))
+	{
+		ELOG_STDERR("ERROR: %s is too short to be an index\n", path);
+		close(fd);
+		return false;
+	}
+
+	void *mapping = mmap(nullptr, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED)
+	{
+		ELOG_STDERR("ERROR: failed to map index %s\n", path);
+		return false;
+	}
+
+	pfb_index_header_t const *h = mapping;
+	if(!valid_index_header(h, s.st_size))
+	{
+		ELOG_STDERR("ERROR: %s is not an index of version %d for this host\n",
+				path, PFB_INDEX_VERSION);
+		munmap(mapping, s.st_size);
+		return false;
+	}
+
+	char *strings = (char*)mapping + h->strings_offset;
+	char *allowed = (char*)mapping + h->allowed_offset;
+	line_info_t *li = (line_info_t*)((char*)mapping + h->entries_offset);
+	line_info_t const *shadow = (line_info_t const*)((char*)mapping +
+			h->shadow_entries_offset);
+
+	if(!valid_entries(li, h->entry_count, strings, h->strings_len) ||
+			(h->source_count > 0 &&
+			 !valid_entries(shadow, h->shadow_count, strings, h->strings_len)) ||
+			(h->allowed_len > 0 && allowed[h->allowed_len - 1] != '\0'))
+	{
+		ELOG_STDERR("ERROR: index %s is corrupt\n", path);
+		munmap(mapping, s.st_size);
+		return false;
+	}
+
+	posix_madvise(mapping, s.st_size, POSIX_MADV_SEQUENTIAL);
+
+	*out_buffer = (pfb_out_buffer_t){
+		.buffer = strings,
+		.next_idx = h->strings_len,
+		.alloc_len = h->strings_len,
+		.litelines = {
+			.alloc = h->entry_count,
+			.used = h->entry_count,
+			.li = li,
+		},
+		.mapping = mapping,
+		.mapping_len = s.st_size,
+		.allowed = h->allowed_len > 0 ? allowed : nullptr,
+		.allowed_len = h->allowed_len,
+	};
+
+	return true;
+}
+
+/**
+ * Fill 'sources' with views of the sources, masks, and shadow entries of a
+ * mapped index. Returns false if the index was written without them.
+ */
+bool pfb_index_sources(pfb_out_buffer_t const mapped[static 1],
+		pfb_index_sources_t sources[static 1])
+{
+	*sources = (pfb_index_sources_t){};
+	if(!mapped->mapping)
+	{
+		return false;
+	}
+
+	char const *base = mapped->mapping;
+	pfb_index_header_t const *h = mapped->mapping;
+	if(h->source_count == 0)
+	{
+		return false;
+	}
+
+	*sources = (pfb_index_sources_t){
+		.sources = (pfb_index_source_t const*)(base + h->sources_offset),
+		.source_count = h->source_count,
+		.masks = (uint64_t const*)(base + h->masks_offset),
+		.shadow = {
+			.alloc = h->shadow_count,
+			.used = h->shadow_count,
+			.li = (line_info_t*)(base + h->shadow_entries_offset),
+		},
+		.shadow_masks = (uint64_t const*)(base + h->shadow_masks_offset),
+		.allowed_masks = (uint64_t const*)(base + h->allowed_masks_offset),
+		.allowed_count = h->allowed_count,
+	};
+	return true;
+}
+
+static bool write_array(FILE out_file[static 1], void const *data, size_t size,
+		uint64_t count)
+{
+	return count == 0 || fwrite(data, size, count, out_file) == count;
+}
+
+/**
+ * Write 'count' entries as pfb_index_entry_t, a chunk at a time, so no byte of
+ * the file comes from the padding of a line_info_t.
+ */
+static bool write_entries(FILE out_file[static 1], line_info_t const li[],
+		uint64_t count)
+{
+	pfb_index_entry_t chunk[512] = {};
+	for(uint64_t i = 0; i < count; )
+	{
+		uint64_t n = 0;
+		for(; n < sizeof(chunk) / sizeof(chunk[0]) && i < count; n++, i++)
+		{
+			chunk[n].offset = li[i].offset;
+			chunk[n].line_len = li[i].line_len;
+		}
+		if(!write_array(out_file, chunk, sizeof(pfb_index_entry_t), n))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Write the de-duplicated and sorted entries held by 'in_buffer', as laid out
+ * by the BUFFER writer, to 'out_file' in the index format along with the
+ * exceptions kept with them and which sources hold each entry.
+ */
+bool pfb_write_index_sources(FILE out_file[static 1],
+		pfb_out_buffer_t const in_buffer[static 1],
+		pfb_index_sources_t const sources[static 1])
+{
+	ASSERT(out_file);
+	ASSERT(in_buffer);
+	ASSERT(sources->source_count <= PFB_INDEX_MAX_SOURCES);
+
+	const uint64_t count = in_buffer->litelines.used;
+	const uint64_t source_count = sources->source_count;
+	const uint64_t shadow_count = source_count > 0 ? sources->shadow.used : 0;
+	const uint64_t allowed_count = source_count > 0 ? sources->allowed_count : 0;
+
+	pfb_index_header_t h = {
+		.version = PFB_INDEX_VERSION,
+		.byte_order = PFB_INDEX_BYTE_ORDER,
+		.line_info_size = sizeof(line_info_t),
+		.entry_count = count,
+		.strings_len = in_buffer->next_idx,
+		.allowed_len = in_buffer->allowed_len,
+		.source_count = source_count,
+		.shadow_count = shadow_count,
+		.allowed_count = allowed_count,
+	};
+	memcpy(h.magic, PFB_INDEX_MAGIC, PFB_INDEX_MAGIC_LEN);
+	h.sources_offset = sizeof(pfb_index_header_t);
+	h.entries_offset = h.sources_offset + source_count * sizeof(pfb_index_source_t);
+	h.masks_offset = h.entries_offset + count * sizeof(pfb_index_entry_t);
+	h.shadow_entries_offset = h.masks_offset +
+		(source_count > 0 ? count * sizeof(uint64_t) : 0);
+	h.shadow_masks_offset = h.shadow_entries_offset +
+		shadow_count * sizeof(pfb_index_entry_t);
+	h.allowed_masks_offset = h.shadow_masks_offset +
+		shadow_count * sizeof(uint64_t);
+	h.strings_offset = h.allowed_masks_offset + allowed_count * sizeof(uint64_t);
+	h.allowed_offset = h.strings_offset + h.strings_len;
+
+	bool ok = fwrite(&h, sizeof(h), 1, out_file) == 1;
+	ok = ok && write_array(out_file, sources->sources, sizeof(pfb_index_source_t),
+			source_count);
+	ok = ok && write_entries(out_file, in_buffer->litelines.li, count);
+	if(source_count > 0)
+	{
+		ok = ok && write_array(out_file, sources->masks, sizeof(uint64_t), count);
+		ok = ok && write_entries(out_file, sources->shadow.li, shadow_count);
+		ok = ok && write_array(out_file, sources->shadow_masks, sizeof(uint64_t),
+				shadow_count);
+		ok = ok && write_array(out_file, sources->allowed_masks, sizeof(uint64_t),
+				allowed_count);
+	}
+
+	ok = ok && write_array(out_file, in_buffer->buffer, sizeof(char),
+			in_buffer->next_idx);
+	ok = ok && write_array(out_file, in_buffer->allowed, sizeof(char),
+			in_buffer->allowed_len);
+
+	if(!ok)
+	{
+		ELOG_STDERR("ERROR: failed to write index\n");
+	}
+	return ok;
+}
+
+/**
+ * Write the de-duplicated and sorted entries held by 'in_buffer', as laid out
+ * by the BUFFER writer, to 'out_file' in the index format.
+ */
+bool pfb_write_index(FILE out_file[static 1], pfb_out_buffer_t const in_buffer[static 1])
+{
+	const pfb_index_sources_t none = {};
+	return pfb_write_index_sources(out_file, in_buffer, &none);
+}
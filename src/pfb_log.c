@@ -0,0 +1,315 @@
+/**
+ * pfb_log.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// clock_gettime() is POSIX; -std=c23 declares only ISO C otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "dedupdomains.h"
+#include "pfb_log.h"
+#include "pfb_session.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#define LOG_BUFFER_SIZE (64 * 1024)
+#define LOG_FLUSH_INTERVAL_NS 1000000000LL
+// distinct messages counted per input; a message beyond is never held back.
+#define LOG_REPEAT_SLOTS 16
+
+typedef struct log_file
+{
+	char const *fname;
+	FILE *file;
+	size_t used;
+	char buffer[LOG_BUFFER_SIZE];
+} log_file_t;
+
+typedef struct log_repeat
+{
+	// messages are told apart by the address of their format string.
+	char const *fmt;
+	size_t count;
+} log_repeat_t;
+
+static log_file_t logs[PFB_LOG_COUNT];
+
+// guards the logs and keeps the messages of different threads whole.
+static once_flag log_once = ONCE_FLAG_INIT;
+static mtx_t log_lock;
+static long long log_flushed_ns = 0;
+
+static thread_local char const *log_input_name = nullptr;
+static thread_local log_repeat_t log_repeats[LOG_REPEAT_SLOTS];
+static thread_local size_t log_repeats_used = 0;
+
+/**
+ * When set, the error log of this thread goes to the sink. The log files are
+ * set once while parsing the command line; the sink is per thread so sessions
+ * on different threads keep their own.
+ */
+static thread_local pfb_log_sink_t const *thread_logSink = nullptr;
+
+static void init_log_lock()
+{
+	mtx_init(&log_lock, mtx_plain);
+}
+
+static long long log_now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static FILE *log_fallback(enum pfb_log log)
+{
+	return log == PFB_LOG_STD ? stdout : stderr;
+}
+
+/**
+ * Write what is gathered for 'log'. The file is opened on the first write so
+ * a run which logs nothing leaves no file behind. Called with the lock held.
+ */
+static void flush_log_file(enum pfb_log log)
+{
+	log_file_t *const l = &logs[log];
+	if(l->used == 0)
+	{
+		return;
+	}
+
+	if(!l->file)
+	{
+		l->file = fopen(l->fname, "ab");
+		if(!l->file)
+		{
+			fprintf(stderr, "ERROR: Unable to open %s for append writing.\n",
+					l->fname);
+			l->file = log_fallback(log);
+		}
+	}
+
+	fwrite(l->buffer, sizeof(char), l->used, l->file);
+	fflush(l->file);
+	l->used = 0;
+}
+
+static void flush_log_files()
+{
+	for(int log = 0; log < PFB_LOG_COUNT; log++)
+	{
+		flush_log_file(log);
+	}
+	log_flushed_ns = log_now_ns();
+}
+
+static void log_vprintf(enum pfb_log log, char const *fmt, va_list args)
+{
+	log_file_t *const l = &logs[log];
+
+	call_once(&log_once, init_log_lock);
+	mtx_lock(&log_lock);
+
+	if(!l->fname)
+	{
+		vfprintf(log_fallback(log), fmt, args);
+		mtx_unlock(&log_lock);
+		return;
+	}
+
+	va_list again;
+	va_copy(again, args);
+	int len = vsnprintf(&l->buffer[l->used], LOG_BUFFER_SIZE - l->used, fmt,
+			args);
+	if(len > 0 && (size_t)len >= LOG_BUFFER_SIZE - l->used)
+	{
+		// it did not fit; write out what came before and format it again. a
+		// single message longer than the buffer is cut short.
+		flush_log_file(log);
+		len = vsnprintf(l->buffer, LOG_BUFFER_SIZE, fmt, again);
+		len = MIN(len, LOG_BUFFER_SIZE - 1);
+	}
+	va_end(again);
+
+	if(len > 0)
+	{
+		l->used += len;
+	}
+
+	if(log_now_ns() - log_flushed_ns >= LOG_FLUSH_INTERVAL_NS)
+	{
+		flush_log_files();
+	}
+
+	mtx_unlock(&log_lock);
+}
+
+/**
+ * Whether 'fmt' was already logged PFB_LOG_REPEATS times for the input this
+ * thread reads; it is counted if so.
+ */
+static bool log_repeated(char const *fmt)
+{
+	if(!log_input_name)
+	{
+		return false;
+	}
+
+	for(size_t i = 0; i < log_repeats_used; i++)
+	{
+		if(log_repeats[i].fmt == fmt)
+		{
+			return ++log_repeats[i].count > PFB_LOG_REPEATS;
+		}
+	}
+
+	if(log_repeats_used < LOG_REPEAT_SLOTS)
+	{
+		log_repeats[log_repeats_used++] = (log_repeat_t){fmt, 1};
+	}
+	return false;
+}
+
+static void log_route(enum pfb_log log, char const *fmt, va_list args)
+{
+	if(log == PFB_LOG_ERR && thread_logSink)
+	{
+		char message[1024];
+		vsnprintf(message, sizeof(message), fmt, args);
+		thread_logSink->write(message, thread_logSink->context);
+		return;
+	}
+
+	log_vprintf(log, fmt, args);
+}
+
+/**
+ * Log to 'fname' rather than to stdout or stderr.
+ */
+void pfb_log_open(enum pfb_log log, char const *fname)
+{
+	ASSERT(log < PFB_LOG_COUNT);
+	ASSERT(fname);
+	call_once(&log_once, init_log_lock);
+
+	mtx_lock(&log_lock);
+	const bool first = !logs[PFB_LOG_ERR].fname && !logs[PFB_LOG_STD].fname;
+	logs[log].fname = fname;
+	if(first)
+	{
+		log_flushed_ns = log_now_ns();
+	}
+	mtx_unlock(&log_lock);
+
+	if(first)
+	{
+		atexit(pfb_log_close);
+	}
+}
+
+bool pfb_log_has_file(enum pfb_log log)
+{
+	ASSERT(log < PFB_LOG_COUNT);
+	return logs[log].fname != nullptr;
+}
+
+void pfb_log_printf(enum pfb_log log, char const *fmt, ...)
+{
+	ASSERT(log < PFB_LOG_COUNT);
+	if(log_repeated(fmt))
+	{
+		return;
+	}
+
+	va_list args;
+	va_start(args, fmt);
+	log_route(log, fmt, args);
+	va_end(args);
+}
+
+/**
+ * Begin counting repeated messages for the input 'name' which this thread
+ * reads next, or stop with nullptr. The repeats of the input read before are
+ * logged as one line each.
+ */
+void pfb_log_input(char const *name)
+{
+	char const *const prev_name = log_input_name;
+	log_input_name = nullptr;
+
+	for(size_t i = 0; i < log_repeats_used; i++)
+	{
+		if(log_repeats[i].count > PFB_LOG_REPEATS)
+		{
+			char const *const fmt = log_repeats[i].fmt;
+			const int fmt_len = strcspn(fmt, "\n");
+			pfb_log_printf(PFB_LOG_ERR, "NOTICE: %zu more like '%.*s' in %s\n",
+					log_repeats[i].count - PFB_LOG_REPEATS, fmt_len, fmt,
+					prev_name);
+		}
+	}
+
+	log_repeats_used = 0;
+	log_input_name = name;
+}
+
+void pfb_log_flush()
+{
+	call_once(&log_once, init_log_lock);
+	mtx_lock(&log_lock);
+	flush_log_files();
+	mtx_unlock(&log_lock);
+}
+
+/**
+ * Write what was gathered and close the log files; what is logged after goes
+ * to stdout and stderr. Registered with atexit() by pfb_log_open().
+ */
+void pfb_log_close()
+{
+	call_once(&log_once, init_log_lock);
+	mtx_lock(&log_lock);
+	flush_log_files();
+	for(int log = 0; log < PFB_LOG_COUNT; log++)
+	{
+		log_file_t *const l = &logs[log];
+		if(l->file && l->file != log_fallback(log))
+		{
+			fclose(l->file);
+		}
+		l->file = nullptr;
+		l->fname = nullptr;
+	}
+	mtx_unlock(&log_lock);
+}
+
+pfb_log_sink_t const *swap_threadLogSink(pfb_log_sink_t const *sink)
+{
+	pfb_log_sink_t const *prev = thread_logSink;
+	thread_logSink = sink;
+	return prev;
+}
+
+pfb_log_sink_t const *get_threadLogSink()
+{
+	return thread_logSink;
+}
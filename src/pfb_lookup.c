@@ -0,0 +1,117 @@
+/**
+ * pfb_lookup.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "dedupdomains.h"
+#include "pfb_context.h"
+#include "pfb_differ.h"
+#include "pfb_lookup.h"
+#include "adbplusline.h"
+
+/**
+ * Point 'dv' at the domain 'name' of 'len' bytes, e.g., "ads.example.com".
+ * A trailing '.' is ignored. Returns false if 'name' is not a domain.
+ */
+bool pfb_query_DomainView(DomainView_t dv[static 1], const char *name,
+		size_len_t len)
+{
+	if(len > 0 && name[len - 1] == '.')
+	{
+		len--;
+	}
+	if(len == 0 || name[0] == '.')
+	{
+		return false;
+	}
+	for(size_len_t i = 1; i < len; i++)
+	{
+		if(name[i] == '.' && name[i - 1] == '.')
+			return false;
+	}
+
+	if(!update_DomainView(dv, name, len))
+	{
+		return false;
+	}
+	// a name looked up stands for itself alone; an entry of the name blocks
+	// it whether or not it blocks the subdomains too.
+	dv->match_strength = MATCH_WEAK;
+	return true;
+}
+
+static void entry_DomainView(DomainView_t dv[static 1],
+		pfb_out_buffer_t const sorted[static 1], size_len_t idx)
+{
+	AdbplusView_t lv;
+	const bool parsed_ok = parse_adbplus_line(&lv,
+			sorted->buffer + sorted->litelines.li[idx].offset);
+	ASSERT(parsed_ok);
+	UNUSED(parsed_ok);
+
+	const bool update_dv_ok = update_DomainView(dv, lv.data, lv.len);
+	ASSERT(update_dv_ok);
+	UNUSED(update_dv_ok);
+	dv->match_strength = lv.ms;
+}
+
+/**
+ * Find the entry of the de-duplicated and sorted 'sorted' which blocks
+ * 'query': the entry itself or its nearest parent. Returns false if nothing
+ * blocks it; otherwise 'found' is the index of the entry in the litelines.
+ *
+ * A parent sorts ahead of its children and a de-duplicated list holds none of
+ * the children of its entries; the greatest entry not greater than 'query' is
+ * therefore the only one that can block it.
+ */
+bool pfb_lookup_BUFFER(pfb_out_buffer_t const sorted[static 1],
+		DomainView_t const query[static 1], DomainView_t scratch[static 1],
+		size_len_t found[static 1])
+{
+	size_len_t lo = 0;
+	size_len_t hi = sorted->litelines.used;
+	while(lo < hi)
+	{
+		const size_len_t mid = lo + (hi - lo) / 2;
+		entry_DomainView(scratch, sorted, mid);
+		const int cmp = compare_dv(scratch, query);
+		if(cmp == dv_A_eq_dv_B || cmp == dv_A_blk_dv_B ||
+				cmp == dv_A_lt_dv_B_write_A)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	if(lo == 0)
+	{
+		return false;
+	}
+
+	entry_DomainView(scratch, sorted, lo - 1);
+	const int cmp = compare_dv(scratch, query);
+	if(cmp == dv_A_eq_dv_B || cmp == dv_A_blk_dv_B)
+	{
+		*found = lo - 1;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,155 @@
+/**
+ * pfb_memory.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "dedupdomains.h"
+#include "pfb_memory.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// the -P workers charge the same budget.
+static size_t mem_budget = 0;
+static atomic_size_t mem_used = 0;
+static atomic_size_t mem_peak = 0;
+static atomic_size_t mem_allocs = 0;
+// the resident server refuses one request instead of ending.
+static bool mem_soft = false;
+static atomic_bool mem_overrun = false;
+
+/**
+ * Set the ceiling in bytes; 0 removes it.
+ */
+void pfb_mem_set_budget(size_t bytes)
+{
+	mem_budget = bytes;
+}
+
+size_t pfb_mem_budget()
+{
+	return mem_budget;
+}
+
+/**
+ * Returns true if 'bytes' more fit the budget.
+ */
+bool pfb_mem_fits(size_t bytes)
+{
+	return mem_budget == 0 ||
+		atomic_load_explicit(&mem_used, memory_order_relaxed) + bytes <= mem_budget;
+}
+
+static void raise_peak(size_t used)
+{
+	size_t peak = atomic_load_explicit(&mem_peak, memory_order_relaxed);
+	while(used > peak && !atomic_compare_exchange_weak_explicit(&mem_peak,
+				&peak, used, memory_order_relaxed, memory_order_relaxed))
+	{
+	}
+}
+
+/**
+ * Count 'bytes' an optional allocation is about to hold. Returns false, and
+ * counts nothing, if they would exceed the budget.
+ */
+bool pfb_mem_reserve(size_t bytes)
+{
+	size_t used = atomic_load_explicit(&mem_used, memory_order_relaxed);
+	do
+	{
+		if(mem_budget > 0 && used + bytes > mem_budget)
+		{
+			return false;
+		}
+	} while(!atomic_compare_exchange_weak_explicit(&mem_used, &used,
+				used + bytes, memory_order_relaxed, memory_order_relaxed));
+
+	atomic_fetch_add_explicit(&mem_allocs, 1, memory_order_relaxed);
+	raise_peak(used + bytes);
+	return true;
+}
+
+/**
+ * With 'soft' set, a charge beyond the budget no longer ends the run; it is
+ * noted for pfb_mem_overrun().
+ */
+void pfb_mem_set_soft(bool soft)
+{
+	mem_soft = soft;
+	atomic_store_explicit(&mem_overrun, false, memory_order_relaxed);
+}
+
+/**
+ * Returns true, and forgets it, if a charge went beyond the budget since the
+ * last call.
+ */
+bool pfb_mem_overrun()
+{
+	return atomic_exchange_explicit(&mem_overrun, false, memory_order_relaxed);
+}
+
+/**
+ * Count 'bytes' an allocation the run cannot do without is about to hold.
+ * Exceeding the budget ends the run, unless it is soft.
+ */
+void pfb_mem_charge(size_t bytes)
+{
+	const size_t used = atomic_fetch_add_explicit(&mem_used, bytes,
+			memory_order_relaxed) + bytes;
+	atomic_fetch_add_explicit(&mem_allocs, 1, memory_order_relaxed);
+	if(mem_budget > 0 && used > mem_budget && mem_soft)
+	{
+		atomic_store_explicit(&mem_overrun, true, memory_order_relaxed);
+	}
+	else if(mem_budget > 0 && used > mem_budget)
+	{
+		ELOG_STDERR("ERROR: the memory budget of %zu MB is exceeded; raise -b or use -e\n",
+				mem_budget >> 20);
+		exit(EXIT_FAILURE);
+	}
+	raise_peak(used);
+}
+
+void pfb_mem_release(size_t bytes)
+{
+	atomic_fetch_sub_explicit(&mem_used, bytes, memory_order_relaxed);
+}
+
+/**
+ * The bytes counted now.
+ */
+size_t pfb_mem_used()
+{
+	return atomic_load_explicit(&mem_used, memory_order_relaxed);
+}
+
+/**
+ * The most bytes counted at once.
+ */
+size_t pfb_mem_peak()
+{
+	return atomic_load_explicit(&mem_peak, memory_order_relaxed);
+}
+
+/**
+ * The reservations and charges counted so far.
+ */
+size_t pfb_mem_allocs()
+{
+	return atomic_load_explicit(&mem_allocs, memory_order_relaxed);
+}
@@ -0,0 +1,139 @@
+/**
+ * pfb_overlap.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "dedupdomains.h"
+#include "pfb_context.h"
+#include "pfb_differ.h"
+#include "pfb_overlap.h"
+#include <stdlib.h>
+
+/**
+ * Counters collected over one k-way merge of N inputs. Each matrix is N x N
+ * in row-major order; row i describes the entries of input i.
+ */
+typedef struct overlap_matrix
+{
+	uint count;
+	// entries held by input i
+	size_t *entries;
+	// entries held by input i and by no other input, nor blocked by a parent
+	// held in another input.
+	size_t *exclusive;
+	// entries held by both input i and input j. the diagonal equals entries.
+	size_t *shared;
+	// entries of input i blocked by a MATCH_FULL parent held in input j.
+	size_t *covered;
+} overlap_matrix_t;
+
+static void visit_overlap(DV_merge_group_t const group[static 1], void *context)
+{
+	overlap_matrix_t *m = context;
+	ASSERT(m);
+	ASSERT(group->owners_used > 0);
+
+	for(uint o = 0; o < group->owners_used; o++)
+	{
+		const uint i = group->owners[o];
+		ASSERT(i < m->count);
+		m->entries[i]++;
+
+		if(group->owners_used == 1 && group->covered_used == 0)
+		{
+			m->exclusive[i]++;
+		}
+
+		for(uint s = 0; s < group->owners_used; s++)
+		{
+			m->shared[i * m->count + group->owners[s]]++;
+		}
+
+		for(uint c = 0; c < group->covered_used; c++)
+		{
+			m->covered[i * m->count + group->covered_by[c]]++;
+		}
+	}
+}
+
+static void write_overlap_matrix(FILE *out_file, char const *label,
+		size_t const matrix[], uint count)
+{
+	fprintf(out_file, "! %s", label);
+	for(uint j = 0; j < count; j++)
+	{
+		fprintf(out_file, "\t%u", j);
+	}
+	fprintf(out_file, "\n");
+
+	for(uint i = 0; i < count; i++)
+	{
+		fprintf(out_file, "%u", i);
+		for(uint j = 0; j < count; j++)
+		{
+			fprintf(out_file, "\t%zu", matrix[i * count + j]);
+		}
+		fprintf(out_file, "\n");
+	}
+}
+
+/**
+ * Compute, in a single pass over all inputs, how the de-duplicated and sorted
+ * inputs overlap one another and write the result as tab separated tables:
+ * entries and exclusive entries per input, an N x N matrix of shared entries,
+ * and an N x N matrix of entries of row i covered by a parent in column j.
+ *
+ * 'names' labels each input in the output; it may be nullptr.
+ */
+void overlap_adbplus_adlists_BUFFER(pfb_out_buffer_t *const in[],
+		char const *const names[], uint count,
+		pfb_out_context_t out_context[static 1])
+{
+	ASSERT(in);
+	ASSERT(out_context);
+	ASSERT(out_context->out_file);
+
+	overlap_matrix_t m = {
+		.count = count,
+		.entries = calloc(count, sizeof(size_t)),
+		.exclusive = calloc(count, sizeof(size_t)),
+		.shared = calloc((size_t)count * count, sizeof(size_t)),
+		.covered = calloc((size_t)count * count, sizeof(size_t)),
+	};
+	CHECK_MALLOC(m.entries);
+	CHECK_MALLOC(m.exclusive);
+	CHECK_MALLOC(m.shared);
+	CHECK_MALLOC(m.covered);
+
+	merge_adbplus_adlists_BUFFER(in, count, visit_overlap, &m);
+
+	FILE *out_file = out_context->out_file;
+	fprintf(out_file, "! list\tentries\texclusive\tname\n");
+	for(uint i = 0; i < count; i++)
+	{
+		fprintf(out_file, "%u\t%zu\t%zu\t%s\n", i, m.entries[i], m.exclusive[i],
+				names && names[i] ? names[i] : "");
+	}
+	write_overlap_matrix(out_file, "shared", m.shared, count);
+	write_overlap_matrix(out_file, "covered", m.covered, count);
+
+	free(m.entries);
+	free(m.exclusive);
+	free(m.shared);
+	free(m.covered);
+}
@@ -0,0 +1,196 @@
+/**
+ * pfb_perfile.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "dedupdomains.h"
+#include "pfb_context.h"
+#include "pfb_perfile.h"
+#include "pfb_pool.h"
+#include "pfb_prune.h"
+#include "tld_hash_context.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * De-duplicate every input on its own and write each next to its input with
+ * the given extension, e.g., lists/a.txt to lists/a.out. Every input is a
+ * task of the pool, -j, with its own tree and contexts so the inputs share
+ * nothing. Inputs of the same output, e.g., lists/a.txt and lists/a.list, are
+ * refused before anything is written.
+ */
+
+typedef struct perfile_job
+{
+	path_info_t *in_path;
+	char *out_fname;
+} perfile_job_t;
+
+static bool ends_with(const char path[static 1], const char ext[static 1])
+{
+	const size_t path_len = strlen(path);
+	const size_t ext_len = strlen(ext);
+	return path_len >= ext_len && strcmp(path + path_len - ext_len, ext) == 0;
+}
+
+/**
+ * Set 'out_fname' to the output of one input, or nullptr if the input is
+ * skipped. Returns false if the input is not de-duplicated for lack of an
+ * output.
+ */
+static bool output_of(path_info_t const in_path[static 1],
+		const char ext[static 1], char *out_fname[static 1])
+{
+	*out_fname = nullptr;
+
+	// the output of an earlier run is not an input; it would be overwritten by
+	// its own output.
+	if(ends_with(in_path->path, ext))
+	{
+		ELOG_STDERR("NOTICE: skipping %s; it has the output extension %s\n",
+				in_path->path, ext);
+		return true;
+	}
+
+	if(in_path->is_index)
+	{
+		ELOG_STDERR("WARNING: skipping index %s; only plain text inputs are de-duplicated one by one\n",
+				in_path->path);
+		return false;
+	}
+
+	*out_fname = outputfilename(in_path->path, ext);
+	return *out_fname != nullptr;
+}
+
+/**
+ * De-duplicate one input to its output.
+ */
+static void dedup_one(path_info_t in_path[static 1], const char out_fname[static 1])
+{
+	// a view of the one input; the contexts copy what they keep.
+	paths_list_t one = {
+		.paths = in_path,
+		.len = 1,
+		.alloced = 1,
+	};
+
+	TLD_implementation_t tld_impl = create_tld_hash_impl();
+	ASSERT(tld_impl.context);
+
+	pfb_context_collect_t pcc = pfb_init_contexts(one, out_fname);
+	sort_adbplus_adlists(tld_impl, &pcc, true);
+	pfb_free_context_collect(&pcc);
+
+	free_tld_impl(&tld_impl);
+}
+
+static int compare_outputs(const void *a, const void *b)
+{
+	perfile_job_t const *const *job_a = a;
+	perfile_job_t const *const *job_b = b;
+	return strcmp((*job_a)->out_fname, (*job_b)->out_fname);
+}
+
+/**
+ * Returns false if two inputs, e.g., a.txt and a.list, have the same output;
+ * one would overwrite the other, at the same time with -j.
+ */
+static bool distinct_outputs(perfile_job_t jobs[], uint count)
+{
+	perfile_job_t **sorted = calloc(MAX(count, 1u), sizeof(perfile_job_t*));
+	CHECK_MALLOC(sorted);
+	uint used = 0;
+	for(uint i = 0; i < count; i++)
+	{
+		if(jobs[i].out_fname)
+		{
+			sorted[used++] = &jobs[i];
+		}
+	}
+	qsort(sorted, used, sizeof(perfile_job_t*), compare_outputs);
+
+	bool distinct = true;
+	for(uint i = 1; i < used; i++)
+	{
+		if(strcmp(sorted[i - 1]->out_fname, sorted[i]->out_fname) == 0)
+		{
+			ELOG_STDERR("ERROR: %s and %s would both be written to %s\n",
+					sorted[i - 1]->in_path->path, sorted[i]->in_path->path,
+					sorted[i]->out_fname);
+			distinct = false;
+		}
+	}
+	free(sorted);
+	return distinct;
+}
+
+static void perfile_job(void *arg)
+{
+	perfile_job_t *job = arg;
+	dedup_one(job->in_path, job->out_fname);
+}
+
+/**
+ * De-duplicate each input of 'in_paths_list' on its own and write it to the
+ * path of the input with its extension replaced by 'ext'. Returns false if any
+ * input was not written.
+ */
+bool pfb_dedup_each_file(paths_list_t in_paths_list, const char ext[static 1])
+{
+	// accept both "out" and ".out"
+	const size_t ext_len = strlen(ext);
+	char *dot_ext = malloc(ext_len + 2);
+	CHECK_MALLOC(dot_ext);
+	dot_ext[0] = '.';
+	memcpy(dot_ext + (ext[0] != '.'), ext, ext_len + 1);
+
+	perfile_job_t *jobs = calloc(in_paths_list.len, sizeof(perfile_job_t));
+	CHECK_MALLOC(jobs);
+	bool ok = true;
+	uint used = 0;
+	for(uint i = 0; i < in_paths_list.len; i++)
+	{
+		path_info_t *in_path = &in_paths_list.paths[i];
+		char *out_fname;
+		ok = output_of(in_path, dot_ext, &out_fname) && ok;
+		if(out_fname)
+		{
+			jobs[used++] = (perfile_job_t){in_path, out_fname};
+		}
+	}
+
+	// nothing is written unless every output is of one input alone.
+	if(distinct_outputs(jobs, used))
+	{
+		pfb_pool_for(perfile_job, jobs, sizeof(perfile_job_t), used);
+	}
+	else
+	{
+		ok = false;
+	}
+
+	for(uint i = 0; i < used; i++)
+	{
+		free(jobs[i].out_fname);
+	}
+	free(jobs);
+	free(dot_ext);
+
+	return ok;
+}
@@ -0,0 +1,358 @@
+/**
+ * pfb_pool.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// sysconf() is POSIX; -std=c23 declares only ISO C otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "pfb_pool.h"
+#include "pfb_session.h"
+#include "pfb_stats.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <unistd.h>
+
+#define POOL_DEQUE_INIT 64
+
+typedef struct pool_task
+{
+	void (*fn)(void *arg);
+	void *arg;
+	pfb_task_group_t *group;
+	pfb_log_sink_t const *log;
+} pool_task_t;
+
+/**
+ * A ring of tasks. The owner pushes and pops at the bottom; a thief takes
+ * from the top, the oldest task, which tends to be the largest.
+ */
+typedef struct pool_deque
+{
+	mtx_t lock;
+	pool_task_t *tasks;
+	size_t alloc;
+	size_t top;
+	size_t bottom;
+} pool_deque_t;
+
+// deque 0 is of the threads outside the pool; deque i of worker i.
+static pool_deque_t *pool_deques = nullptr;
+static thrd_t *pool_workers = nullptr;
+static uint pool_size = 1;
+// the calling thread and the workers which did start.
+static uint pool_started = 1;
+
+// tasks in all deques; the idle workers sleep while there are none, and a
+// thread waiting on a group sleeps while its tasks run elsewhere.
+static atomic_size_t pool_queued;
+static atomic_bool pool_stopping;
+static mtx_t pool_idle_lock;
+static cnd_t pool_idle;
+
+static thread_local uint pool_self = 0;
+// tasks running on this thread, nested in one another.
+static thread_local uint pool_depth = 0;
+
+static void deque_push(pool_deque_t d[static 1], pool_task_t task)
+{
+	mtx_lock(&d->lock);
+	if(d->bottom - d->top == d->alloc)
+	{
+		const size_t alloc = d->alloc ? 2 * d->alloc : POOL_DEQUE_INIT;
+		pool_task_t *tasks = malloc(alloc * sizeof(pool_task_t));
+		CHECK_MALLOC(tasks);
+		for(size_t i = d->top; i < d->bottom; i++)
+		{
+			tasks[i % alloc] = d->tasks[i % d->alloc];
+		}
+		free(d->tasks);
+		d->tasks = tasks;
+		d->alloc = alloc;
+	}
+	d->tasks[d->bottom % d->alloc] = task;
+	d->bottom++;
+	mtx_unlock(&d->lock);
+}
+
+static bool deque_pop(pool_deque_t d[static 1], pool_task_t task[static 1])
+{
+	mtx_lock(&d->lock);
+	const bool found = d->bottom != d->top;
+	if(found)
+	{
+		d->bottom--;
+		*task = d->tasks[d->bottom % d->alloc];
+	}
+	mtx_unlock(&d->lock);
+	return found;
+}
+
+static bool deque_steal(pool_deque_t d[static 1], pool_task_t task[static 1])
+{
+	mtx_lock(&d->lock);
+	const bool found = d->bottom != d->top;
+	if(found)
+	{
+		*task = d->tasks[d->top % d->alloc];
+		d->top++;
+	}
+	mtx_unlock(&d->lock);
+	return found;
+}
+
+static bool find_task(pool_task_t task[static 1])
+{
+	if(atomic_load_explicit(&pool_queued, memory_order_relaxed) == 0)
+	{
+		return false;
+	}
+
+	bool found = deque_pop(&pool_deques[pool_self], task);
+	for(uint i = 1; !found && i < pool_size; i++)
+	{
+		found = deque_steal(&pool_deques[(pool_self + i) % pool_size], task);
+	}
+
+	if(found)
+	{
+		atomic_fetch_sub_explicit(&pool_queued, 1, memory_order_relaxed);
+	}
+	return found;
+}
+
+static void run_task(pool_task_t const task[static 1])
+{
+	pfb_log_sink_t const *prev = swap_threadLogSink(task->log);
+	pool_depth++;
+	task->fn(task->arg);
+	pool_depth--;
+	swap_threadLogSink(prev);
+
+	// the counters of a worker are lost with it.
+	pfb_stats_flush();
+	if(task->group && atomic_fetch_sub_explicit(&task->group->pending, 1,
+				memory_order_release) == 1 && pool_workers)
+	{
+		// wake the thread waiting on the group along with the idle workers.
+		mtx_lock(&pool_idle_lock);
+		cnd_broadcast(&pool_idle);
+		mtx_unlock(&pool_idle_lock);
+	}
+}
+
+static int pool_worker(void *data)
+{
+	pool_self = (uint)(uintptr_t)data;
+
+	pool_task_t task;
+	while(true)
+	{
+		if(find_task(&task))
+		{
+			run_task(&task);
+			continue;
+		}
+
+		mtx_lock(&pool_idle_lock);
+		while(!atomic_load(&pool_stopping) && atomic_load(&pool_queued) == 0)
+		{
+			cnd_wait(&pool_idle, &pool_idle_lock);
+		}
+		mtx_unlock(&pool_idle_lock);
+
+		if(atomic_load(&pool_stopping) && atomic_load(&pool_queued) == 0)
+		{
+			return 0;
+		}
+	}
+}
+
+/**
+ * Run tasks on 'threads' threads, or one per core for 0: the calling thread
+ * while it waits and 'threads' - 1 workers. More than
+ * PFB_POOL_THREADS_PER_CORE per core only wait on the same cores and are
+ * lowered to that.
+ */
+void pfb_pool_start(uint threads)
+{
+	ASSERT(!pool_workers);
+	atomic_init(&pool_queued, 0);
+	atomic_init(&pool_stopping, false);
+	const long online = sysconf(_SC_NPROCESSORS_ONLN);
+	const uint cores = online > 0 ? (uint)online : 1;
+	if(threads == 0)
+	{
+		threads = cores;
+	}
+	else if(threads > cores * PFB_POOL_THREADS_PER_CORE)
+	{
+		threads = cores * PFB_POOL_THREADS_PER_CORE;
+		ELOG_STDERR("NOTICE: -j lowered to %u, %d threads per core\n", threads,
+				PFB_POOL_THREADS_PER_CORE);
+	}
+	if(threads <= 1)
+	{
+		return;
+	}
+
+	mtx_init(&pool_idle_lock, mtx_plain);
+	cnd_init(&pool_idle);
+	pool_deques = calloc(threads, sizeof(pool_deque_t));
+	CHECK_MALLOC(pool_deques);
+	for(uint i = 0; i < threads; i++)
+	{
+		mtx_init(&pool_deques[i].lock, mtx_plain);
+	}
+	pool_workers = calloc(threads, sizeof(thrd_t));
+	CHECK_MALLOC(pool_workers);
+
+	// a worker which fails to start leaves its deque empty; only the owner
+	// of a deque pushes to it.
+	pool_size = threads;
+	for(uint i = 1; i < threads; i++)
+	{
+		if(thrd_create(&pool_workers[i], pool_worker, (void*)(uintptr_t)i) !=
+				thrd_success)
+		{
+			ELOG_STDERR("WARNING: failed to start a worker thread; continuing with %u\n",
+					pool_started);
+			break;
+		}
+		pool_started++;
+	}
+}
+
+/**
+ * Let the workers finish the tasks queued and join them.
+ */
+void pfb_pool_stop()
+{
+	if(!pool_workers)
+	{
+		return;
+	}
+
+	mtx_lock(&pool_idle_lock);
+	atomic_store(&pool_stopping, true);
+	cnd_broadcast(&pool_idle);
+	mtx_unlock(&pool_idle_lock);
+
+	for(uint i = 1; i < pool_started; i++)
+	{
+		thrd_join(pool_workers[i], nullptr);
+	}
+
+	for(uint i = 0; i < pool_size; i++)
+	{
+		mtx_destroy(&pool_deques[i].lock);
+		free(pool_deques[i].tasks);
+	}
+	free(pool_deques);
+	free(pool_workers);
+	pool_deques = nullptr;
+	pool_workers = nullptr;
+	pool_size = 1;
+	pool_started = 1;
+	cnd_destroy(&pool_idle);
+	mtx_destroy(&pool_idle_lock);
+}
+
+uint pfb_pool_threads()
+{
+	return pool_started;
+}
+
+/**
+ * True inside a task while other threads may be running tasks too; a task
+ * starting threads of its own would only compete with them.
+ */
+bool pfb_pool_in_parallel()
+{
+	return pool_started > 1 && pool_depth > 0;
+}
+
+void pfb_init_task_group(pfb_task_group_t group[static 1])
+{
+	atomic_init(&group->pending, 0);
+}
+
+void pfb_pool_spawn(pfb_task_group_t group[static 1], void (*fn)(void *arg),
+		void *arg)
+{
+	const pool_task_t task = {
+		.fn = fn,
+		.arg = arg,
+		.group = group,
+		.log = get_threadLogSink(),
+	};
+
+	atomic_fetch_add_explicit(&group->pending, 1, memory_order_relaxed);
+	if(pool_started <= 1)
+	{
+		run_task(&task);
+		return;
+	}
+
+	deque_push(&pool_deques[pool_self], task);
+	atomic_fetch_add(&pool_queued, 1);
+
+	mtx_lock(&pool_idle_lock);
+	cnd_signal(&pool_idle);
+	mtx_unlock(&pool_idle_lock);
+}
+
+/**
+ * Return once every task of 'group' has run, running tasks of any group
+ * meanwhile.
+ */
+void pfb_pool_wait(pfb_task_group_t group[static 1])
+{
+	pool_task_t task;
+	while(atomic_load_explicit(&group->pending, memory_order_acquire) > 0)
+	{
+		if(find_task(&task))
+		{
+			run_task(&task);
+			continue;
+		}
+
+		mtx_lock(&pool_idle_lock);
+		while(atomic_load_explicit(&group->pending, memory_order_acquire) > 0 &&
+				atomic_load(&pool_queued) == 0)
+		{
+			cnd_wait(&pool_idle, &pool_idle_lock);
+		}
+		mtx_unlock(&pool_idle_lock);
+	}
+}
+
+/**
+ * Call 'fn' on each of the 'count' elements of 'size' bytes at 'args' on the
+ * pool and wait for all of them.
+ */
+void pfb_pool_for(void (*fn)(void *arg), void *args, size_t size, size_t count)
+{
+	pfb_task_group_t group;
+	pfb_init_task_group(&group);
+	for(size_t i = 0; i < count; i++)
+	{
+		pfb_pool_spawn(&group, fn, (char*)args + i * size);
+	}
+	pfb_pool_wait(&group);
+}
@@ -0,0 +1,137 @@
+/**
+ * pfb_prefilter.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "pfb_prefilter.h"
+#include "pfb_memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PREFILTER_MIX 0x9e3779b97f4a7c15ULL
+
+// bytes of the set each read allocates; 0 leaves the prefilter off.
+static size_t prefilter_size = 0;
+
+void pfb_prefilter_set_size(size_t bytes)
+{
+	prefilter_size = bytes;
+}
+
+/**
+ * Allocate the set if a size was given and it fits the memory budget.
+ * Returns false when there is no prefilter to use.
+ */
+bool pfb_init_prefilter(pfb_prefilter_t pf[static 1])
+{
+	memset(pf, 0, sizeof(pfb_prefilter_t));
+	if(prefilter_size < sizeof(uint64_t))
+	{
+		return false;
+	}
+
+	// the largest power of two of slots within the size.
+	size_t slots = 1;
+	while(slots * 2 * sizeof(uint64_t) <= prefilter_size)
+	{
+		slots *= 2;
+	}
+
+	const size_t bytes = slots * sizeof(uint64_t);
+	if(!pfb_mem_reserve(bytes))
+	{
+		ELOG_STDERR("NOTICE: -z set of %zu MB is over the memory budget; reading without it\n",
+				bytes >> 20);
+		return false;
+	}
+
+	pf->slots = calloc(slots, sizeof(uint64_t));
+	if(!pf->slots)
+	{
+		ELOG_STDERR("NOTICE: failed to allocate the -z set of %zu MB; reading without it\n",
+				bytes >> 20);
+		pfb_mem_release(bytes);
+		return false;
+	}
+	pf->mask = slots - 1;
+	pf->limit = slots - slots / 4;
+	return true;
+}
+
+/**
+ * Fingerprint 'len' bytes eight at a time; a line is too short to need more.
+ * Not for input made to collide on purpose.
+ */
+static uint64_t fingerprint(char const *line, size_t len)
+{
+	uint64_t h = len * PREFILTER_MIX;
+	size_t i = 0;
+	for(; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+	{
+		uint64_t w;
+		memcpy(&w, &line[i], sizeof(w));
+		h = (h ^ w) * PREFILTER_MIX;
+		h ^= h >> 29;
+	}
+
+	uint64_t w = 0;
+	memcpy(&w, &line[i], len - i);
+	h = (h ^ w) * PREFILTER_MIX;
+
+	// finalizer of splitmix64
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+	return h ? h : 1;
+}
+
+/**
+ * True if a line of the same bytes was seen before; otherwise remember it.
+ */
+bool pfb_prefilter_seen(pfb_prefilter_t pf[static 1], char const *line,
+		size_t len)
+{
+	ASSERT(pf->slots);
+	const uint64_t fp = fingerprint(line, len);
+	for(size_t i = fp & pf->mask; ; i = (i + 1) & pf->mask)
+	{
+		if(pf->slots[i] == fp)
+		{
+			return true;
+		}
+		if(pf->slots[i] == 0)
+		{
+			if(pf->used < pf->limit)
+			{
+				pf->slots[i] = fp;
+				pf->used++;
+			}
+			return false;
+		}
+	}
+}
+
+void pfb_free_prefilter(pfb_prefilter_t pf[static 1])
+{
+	if(pf->slots)
+	{
+		free(pf->slots);
+		pfb_mem_release((pf->mask + 1) * sizeof(uint64_t));
+	}
+	memset(pf, 0, sizeof(pfb_prefilter_t));
+}
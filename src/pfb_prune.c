@@ -18,6 +18,8 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+// sysconf() is POSIX; -std=c23 declares only ISO C otherwise.
+#define _POSIX_C_SOURCE 200809L
 #include "dedupdomains.h"
 #include "domaintree.h"
 #include "domaininfo.h"
@@ -29,9 +31,32 @@
 #include "pfb_prune.h"
 #include "matchstrength.h"
 #include "paths_list.h"
+#include "pfb_allow.h"
+#include "pfb_format.h"
+#include "pfb_index.h"
+#include "pfb_memory.h"
+#include "pfb_pool.h"
+#include "pfb_prefilter.h"
+#include "pfb_spsc.h"
+#include "pfb_stats.h"
 #include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include "logdiagnostics.h"
+#include <threads.h>
 #include <time.h>
+#include <unistd.h>
+
+// tokens and domain bytes a batch of the read pipeline holds.
+#define TOKEN_BATCH_SIZE 4096
+#define TOKEN_ARENA_SIZE (128 * 1024)
+#define PIPELINE_BATCHES 8
+// smaller inputs are read and inserted on the one thread.
+#define PIPELINE_MIN_BYTES (1 << 20)
+// set in the environment, the pipeline runs whatever the size of the inputs
+// and the number of cores; the tests use it on small hosts.
+#define PIPELINE_FORCE_ENV "PFB_TEST_PIPELINE"
 
 const char LINE_TERMINAL = '\0';
 
@@ -75,6 +100,8 @@ char* outputfilename(const char *input, const char *ext)
 		return nullptr;
 	}
 
+	// only a period of the file name begins its extension; one in a directory
+	// name does not.
 	const char *walker, *period = nullptr;
 	for(walker = input; *walker; walker++)
 	{
@@ -82,6 +109,10 @@ char* outputfilename(const char *input, const char *ext)
 		{
 			period = walker;
 		}
+		else if(*walker == PATH_SEP_CHAR)
+		{
+			period = nullptr;
+		}
 	}
 
 	char *output = nullptr;
@@ -103,18 +134,182 @@ char* outputfilename(const char *input, const char *ext)
 	return output;
 }
 
+/**
+ * A rule or carried over line parsed by pfb_insert(), or one domain of a hosts
+ * line. Applied to the tree by apply_token() on the thread inserting; a copy
+ * of the domain is kept in the arena of its batch as the line it was read
+ * from is overwritten by the next.
+ */
+typedef struct line_token
+{
+	pfb_context_t *context;
+	// of the whole line; of the domain alone for MATCH_WEAK.
+	line_info_t li;
+	MatchStrength_t ms;
+	size_len_t len;
+	// offset of the domain in the arena of the batch.
+	size_t domain;
+} line_token_t;
+
+typedef struct token_batch
+{
+	size_t used;
+	size_t arena_used;
+	// the reader is done; this batch holds its final tokens.
+	bool last;
+	line_token_t tokens[TOKEN_BATCH_SIZE];
+	char arena[TOKEN_ARENA_SIZE];
+} token_batch_t;
+
+/**
+ * Where pfb_insert() puts the tokens of a line: applied at once, or gathered
+ * into batches passed to the inserting thread through 'full' and returned
+ * empty through 'empty'.
+ */
+typedef struct token_sink
+{
+	ContextPair_t const *pc;
+	token_batch_t *batch;
+	pfb_spsc_t *full;
+	pfb_spsc_t *empty;
+} token_sink_t;
+
+/**
+ * Insert a token into the tree, the exceptions, or the carried over lines of
+ * its context. The only step which writes to what the contexts share.
+ */
+static void apply_token(ContextPair_t const pc[static 1],
+		line_token_t const t[static 1], char const *domain)
+{
+	if(t->ms == MATCH_COMMENT || t->ms == MATCH_HEADER)
+	{
+		insert_carry_over(&t->context->co, t->li);
+		pfb_stats_count(PFB_STATS_CARRY_OVER_LINES, 1);
+		return;
+	}
+
+	if(t->ms == MATCH_EXCEPTION)
+	{
+		ASSERT(pc->allow);
+		if(pc->allow_lock)
+		{
+			mtx_lock(pc->allow_lock);
+		}
+		pfb_insert_allow(pc->allow, domain, t->len);
+		if(pc->allow_lock)
+		{
+			mtx_unlock(pc->allow_lock);
+		}
+		return;
+	}
+
+	ASSERT(t->ms == MATCH_FULL || t->ms == MATCH_WEAK);
+	DomainView_t *dv = pc->dv;
+	ASSERT(!null_DomainView(dv));
+
+	// the len here is for the FQD *only* e.g. 'ads.google.com'.
+	// the DomainInfo requires the line length to be used in the
+	// consolidate. this is a significant change!
+	if(!update_DomainView(dv, domain, t->len))
+	{
+		ELOG_STDERR("ERROR: failed to update DomainView; possibly garbage input. insert skipped.\n");
+		ASSERT(false);
+		return;
+	}
+
+	// DomainView is valid only during an insert.
+	dv->match_strength = t->ms;
+	dv->context = t->context;
+	dv->li = t->li;
+
+	insert_DomainTree(*pc->tld_impl, dv);
+}
+
+static void emit_token(token_sink_t sink[static 1], line_token_t t,
+		char const *domain)
+{
+	token_batch_t *b = sink->batch;
+	if(!b)
+	{
+		apply_token(sink->pc, &t, domain);
+		return;
+	}
+
+	if(b->used == TOKEN_BATCH_SIZE || b->arena_used + t.len > TOKEN_ARENA_SIZE)
+	{
+		pfb_spsc_put(sink->full, b);
+		b = sink->batch = pfb_spsc_take(sink->empty);
+		ASSERT(b->used == 0 && b->arena_used == 0);
+	}
+
+	t.domain = b->arena_used;
+	if(t.len > 0)
+	{
+		memcpy(&b->arena[b->arena_used], domain, t.len);
+		b->arena_used += t.len;
+	}
+	b->tokens[b->used++] = t;
+}
+
+/**
+ * Emit the domain viewed by 'lv'. A MATCH_WEAK domain is written out alone
+ * rather than the whole line it is read from; a hosts line holds several of
+ * them.
+ */
+static void emit_line_view(PortLineData_t const pld[static 1],
+		AdbplusView_t const lv[static 1], pfb_context_t pfbc[static 1],
+		token_sink_t sink[static 1])
+{
+	// the tree compares labels byte for byte; lowercase the domain in the copy
+	// of the line and drop it if it is not a domain.
+	bool folded;
+	if(!normalize_domain(pld->data + (lv->data - pld->data), lv->len, &folded))
+	{
+		pfbc->rejected++;
+		pfb_stats_count(PFB_STATS_REJECTED, 1);
+		return;
+	}
+	pfbc->folded = pfbc->folded || folded;
+	pfbc->entries++;
+
+	line_token_t t = {
+		.context = pfbc,
+		.li = pld->li,
+		.ms = lv->ms,
+		.len = lv->len,
+	};
+	if(lv->ms == MATCH_WEAK)
+	{
+		t.li.offset += lv->data - pld->data;
+		t.li.line_len = lv->len;
+	}
+
+	emit_token(sink, t, lv->data);
+}
+
+/**
+ * Parse a line read from 'pfbc' and emit what it holds to the token_sink_t
+ * 'data'. Touches nothing shared between the contexts so it may run on a
+ * thread of its own.
+ */
 static void pfb_insert(PortLineData_t const pld[static 1],
 		pfb_context_t pfbc[static 1], void *data)
 {
 	ASSERT(data);
 	ASSERT(pfbc->in_file);
 
-	ContextPair_t *pc = data;
+	token_sink_t *sink = data;
+	ContextPair_t const *pc = sink->pc;
 
-	DomainView_t *dv = pc->dv;
-	const TLD_implementation_t *tld_impl = pc->tld_impl;
+	pfbc->lines++;
 
-	ASSERT(dv);
+	// comments and headers are carried over per input; every one is kept.
+	if(pc->prefilter && !strchr("![#", *pld->data) &&
+			pfb_prefilter_seen(pc->prefilter, pld->data, pld->li.line_len))
+	{
+		pfb_stats_line_prefiltered(pld->li.line_len + 1);
+		return;
+	}
 
 	// pld has total line length
 	// lv has the length of the domain alone to split it into components.
@@ -123,40 +318,45 @@ static void pfb_insert(PortLineData_t const pld[static 1],
 	// marker if it exists. i.e. number of characters in the FQD.
 	AdbplusView_t lv;
 	bool valid = parse_adbplus_line(&lv, pld->data);
+	pfb_stats_line(valid ? lv.ms : MATCH_BOGUS, pld->li.line_len + 1);
 	if(!valid)
 	{
 		return;
 	}
 
 	const MatchStrength_t ms = lv.ms;
-	if(ms == MATCH_COMMENT || ms == MATCH_HEADER)
+	if(ms == MATCH_EXCEPTION)
 	{
-		// add the line information to list for direct carry over to the final
-		// list.
-		insert_carry_over(&pfbc->co, pld->li);
+		bool folded;
+		if(!normalize_domain(pld->data + (lv.data - pld->data), lv.len, &folded))
+		{
+			pfbc->rejected++;
+			pfb_stats_count(PFB_STATS_REJECTED, 1);
+		}
+		else if(pc->allow)
+		{
+			emit_token(sink, (line_token_t){.context = pfbc, .li = pld->li,
+					.ms = ms, .len = lv.len}, lv.data);
+		}
 	}
-	else
+	else if(ms == MATCH_COMMENT || ms == MATCH_HEADER)
 	{
-		ASSERT(ms == MATCH_FULL);
-		// domain view remains the same for adbplus! :-)
-		ASSERT(!null_DomainView(dv));
-		// the len here is for the FQD *only* e.g. 'ads.google.com'.
-		// the DomainInfo requires the line length to be used in the
-		// consolidate. this is a significant change!
-		if(!update_DomainView(dv, lv.data, lv.len))
+		// add the line information to list for direct carry over to the final
+		// list. '#' comments of hosts files are not adbplus syntax and are
+		// dropped.
+		if(ms == MATCH_HEADER || *pld->data == '!')
 		{
-			ELOG_STDERR("ERROR: failed to update DomainView; possibly garbage input. insert skipped.\n");
-			ASSERT(false);
+			emit_token(sink, (line_token_t){.context = pfbc, .li = pld->li,
+					.ms = ms}, nullptr);
 		}
-		else
+	}
+	else
+	{
+		ASSERT(ms == MATCH_FULL || ms == MATCH_WEAK);
+		do
 		{
-			// DomainView is valid only during an insert.
-			dv->match_strength = ms;
-			dv->context = pfbc;
-			dv->li = pld->li;
-
-			insert_DomainTree(*tld_impl, dv);
-		}
+			emit_line_view(pld, &lv, pfbc, sink);
+		} while(next_hosts_domain(&lv));
 	}
 }
 
@@ -266,6 +466,8 @@ static size_t pfb_out_context_write_BUFFER(const char *buffer,
 	else
 	{
 		const size_t growth = c->out_buffer->alloc_len * 0.5;
+		pfb_mem_charge(growth);
+		c->out_buffer->charged += growth;
 		CHECK_REALLOC(c->out_buffer->buffer, sizeof(char) *
 				(c->out_buffer->alloc_len + growth));
 		ASSERT(c->out_buffer);
@@ -285,7 +487,15 @@ static size_t pfb_out_context_write_BUFFER(const char *buffer,
 	// account for null terminator
 	c->out_buffer->next_idx++;
 
+	const size_len_t litelines_alloc = c->out_buffer->litelines.alloc;
 	realloc_litelines(&c->out_buffer->litelines);
+	if(c->out_buffer->litelines.alloc != litelines_alloc)
+	{
+		const size_t growth = sizeof(line_info_t) *
+			(c->out_buffer->litelines.alloc - litelines_alloc);
+		pfb_mem_charge(growth);
+		c->out_buffer->charged += growth;
+	}
 	ASSERT(c->out_buffer->litelines.li);
 	ASSERT(c->out_buffer->litelines.alloc > 0);
 	ASSERT(c->out_buffer->litelines.used < c->out_buffer->litelines.alloc);
@@ -296,6 +506,28 @@ static size_t pfb_out_context_write_BUFFER(const char *buffer,
 	return count;
 }
 
+/**
+ * Initialize an output context which collects the written lines in the given
+ * in-memory buffer.
+ */
+pfb_out_context_t pfb_init_out_context_BUFFER(pfb_out_buffer_t out_buffer[static 1])
+{
+	return (pfb_out_context_t){
+		.out_fname = nullptr,
+		.out_buffer = out_buffer,
+		.writer_cb = pfb_out_context_write_BUFFER
+	};
+}
+
+/**
+ * True if 'c' collects the written lines in its out_buffer rather than writing
+ * them to a FILE.
+ */
+bool pfb_is_out_context_BUFFER(pfb_out_context_t const c[static 1])
+{
+	return c->writer_cb == pfb_out_context_write_BUFFER;
+}
+
 pfb_context_collect_t pfb_init_contexts_FILE(paths_list_t in_paths_list,
 		FILE out_file[static 1])
 {
@@ -426,6 +658,12 @@ void pfb_close_out_context(pfb_out_context_t c[static 1])
 
 void pfb_free_out_context(pfb_out_context_t c[static 1])
 {
+	// the outputs asked for; not the temporary files of a diff.
+	if(c->writer_cb == pfb_out_context_write_FILE &&
+			(c->out_fname || c->out_file == stdout))
+	{
+		pfb_stats_count(PFB_STATS_OUTPUT_LINES, c->counter);
+	}
 	pfb_close_out_context(c);
 
 	free(c->out_fname);
@@ -441,6 +679,11 @@ void pfb_free_out_context(pfb_out_context_t c[static 1])
 
 void pfb_free_context(pfb_context_t c[static 1])
 {
+	if(c->in_fname && c->lines > 0)
+	{
+		pfb_stats_input(c->in_fname, c->lines, c->file_size, c->entries,
+				c->kept);
+	}
 	pfb_close_context(c);
 	free(c->in_fname);
 	c->in_fname = nullptr;
@@ -493,11 +736,195 @@ void pfb_close_contexts(pfb_contexts_t in_contexts[static 1])
 	}
 }
 
+static void read_contexts(pfb_contexts_t cs[static 1],
+		token_sink_t sink[static 1])
+{
+	for(pfb_context_t *pfbc = cs->begin_context; pfbc < cs->end_context; pfbc++)
+	{
+		if(pfbc->in_fname)
+		{
+			DEBUG_PRINTF("Reading %s...\n", pfbc->in_fname);
+		}
+		else
+		{
+			DEBUG_PRINTF("Reading from unnamed input\n");
+		}
+		pfb_read_one_context(pfbc, pfb_insert, sink);
+		if(pfbc->rejected > 0)
+		{
+			DEBUG_PRINTF("rejected %zu entries which are not domains\n",
+					pfbc->rejected);
+		}
+	}
+}
+
+/**
+ * With more than one core, the inputs are read and parsed on a thread of
+ * their own while the calling thread inserts what was parsed. The two pass
+ * batches of tokens through a pair of lock-free rings; the tree is written by
+ * the calling thread alone.
+ */
+typedef struct read_pipeline
+{
+	pfb_contexts_t *cs;
+	token_sink_t sink;
+	pfb_spsc_t full;
+	pfb_spsc_t empty;
+	// the reader logs where its caller does.
+	struct pfb_log_sink const *log;
+} read_pipeline_t;
+
+static int read_stage(void *data)
+{
+	read_pipeline_t *rp = data;
+	swap_threadLogSink(rp->log);
+
+	const pfb_phase_clock_t clock = pfb_stats_begin(PFB_PHASE_READ);
+	rp->sink.batch = pfb_spsc_take(&rp->empty);
+	read_contexts(rp->cs, &rp->sink);
+	rp->sink.batch->last = true;
+	pfb_spsc_put(&rp->full, rp->sink.batch);
+	pfb_stats_end(&clock);
+
+	// the counters of a thread are lost with it.
+	pfb_stats_flush();
+	return 0;
+}
+
+/**
+ * Read 'cs' on a reader thread and insert here. Returns false, having read
+ * nothing, if the inputs are too small to be worth a thread or none could be
+ * started.
+ */
+static bool read_pipelined(ContextPair_t const pc[static 1],
+		pfb_contexts_t cs[static 1])
+{
+	size_t bytes = 0;
+	for(pfb_context_t *pfbc = cs->begin_context; pfbc < cs->end_context; pfbc++)
+	{
+		bytes += pfbc->file_size;
+	}
+	// on a single core the two threads would only take turns, and the tasks
+	// of the pool already keep the cores busy.
+	const bool forced = getenv(PIPELINE_FORCE_ENV) != nullptr;
+	if(pfb_pool_in_parallel() || (!forced && (bytes < PIPELINE_MIN_BYTES ||
+			sysconf(_SC_NPROCESSORS_ONLN) < 2)))
+	{
+		return false;
+	}
+
+	read_pipeline_t rp = {
+		.cs = cs,
+		.sink = {.pc = pc},
+		.log = get_threadLogSink(),
+	};
+	rp.sink.full = &rp.full;
+	rp.sink.empty = &rp.empty;
+	pfb_init_spsc(&rp.full, PIPELINE_BATCHES);
+	pfb_init_spsc(&rp.empty, PIPELINE_BATCHES);
+
+	token_batch_t *batches = calloc(PIPELINE_BATCHES, sizeof(token_batch_t));
+	CHECK_MALLOC(batches);
+	for(size_t i = 0; i < PIPELINE_BATCHES; i++)
+	{
+		pfb_spsc_put(&rp.empty, &batches[i]);
+	}
+
+	thrd_t reader;
+	const bool started = thrd_create(&reader, read_stage, &rp) == thrd_success;
+	if(started)
+	{
+		for(bool last = false; !last; )
+		{
+			token_batch_t *b = pfb_spsc_take(&rp.full);
+			for(size_t i = 0; i < b->used; i++)
+			{
+				apply_token(pc, &b->tokens[i], &b->arena[b->tokens[i].domain]);
+			}
+			last = b->last;
+			b->used = 0;
+			b->arena_used = 0;
+			pfb_spsc_put(&rp.empty, b);
+		}
+		thrd_join(reader, nullptr);
+	}
+
+	free(batches);
+	pfb_free_spsc(&rp.full);
+	pfb_free_spsc(&rp.empty);
+	return started;
+}
+
+/**
+ * One input read by a task of the pool into a tree several threads insert
+ * into at once.
+ */
+typedef struct read_task
+{
+	ContextPair_t pc;
+	pfb_context_t *pfbc;
+} read_task_t;
+
+static void read_task(void *arg)
+{
+	read_task_t *task = arg;
+
+	DomainView_t dv;
+	init_DomainView(&dv);
+	task->pc.dv = &dv;
+
+	pfb_contexts_t one = {task->pfbc, task->pfbc + 1};
+	token_sink_t sink = {.pc = &task->pc};
+	read_contexts(&one, &sink);
+
+	free_DomainView(&dv);
+}
+
+/**
+ * Read each input of 'cs' as a task of the pool when the tree takes inserts
+ * from several threads at once. Returns false, having read nothing, if it
+ * does not, if the pool runs on one thread, or if there is a single input.
+ * Repeated lines are dropped with -z across the inputs by the one set of
+ * fingerprints, which takes a single writer; with it the inputs are read in
+ * turn.
+ */
+static bool read_concurrent(ContextPair_t const pc[static 1],
+		pfb_contexts_t cs[static 1])
+{
+	const size_t count = cs->end_context - cs->begin_context;
+	if(!pc->tld_impl->impl_funcs->release_dt_entry_for_tld || count < 2 ||
+			pfb_pool_threads() < 2 || pc->prefilter)
+	{
+		return false;
+	}
+
+	mtx_t allow_lock;
+	mtx_init(&allow_lock, mtx_plain);
+
+	read_task_t *tasks = calloc(count, sizeof(read_task_t));
+	CHECK_MALLOC(tasks);
+	for(size_t i = 0; i < count; i++)
+	{
+		tasks[i] = (read_task_t){
+			.pc = {pc->tld_impl, nullptr, pc->allow, nullptr, &allow_lock},
+			.pfbc = &cs->begin_context[i],
+		};
+	}
+
+	pfb_pool_for(read_task, tasks, sizeof(read_task_t), count);
+
+	free(tasks);
+	mtx_destroy(&allow_lock);
+	return true;
+}
+
 /**
  * Provides a callback that is specific to handling reading the CSV file
  * pfBlockerNG produces and adds appropriate entries to the DomainTree.
+ * Exception rules are inserted into 'allow' or dropped if it is nullptr.
  */
-void pfb_read_all(TLD_implementation_t tld_impl, pfb_contexts_t cs[static 1])
+void pfb_read_all(TLD_implementation_t tld_impl, pfb_allow_t *allow,
+		pfb_contexts_t cs[static 1])
 {
 	ASSERT(cs->begin_context);
 	ASSERT(cs->begin_context != cs->end_context);
@@ -505,21 +932,19 @@ void pfb_read_all(TLD_implementation_t tld_impl, pfb_contexts_t cs[static 1])
 	DomainView_t dv;
 	init_DomainView(&dv);
 
-	ContextPair_t pc = {&tld_impl, &dv};
+	pfb_prefilter_t prefilter;
+	ContextPair_t pc = {&tld_impl, &dv, allow,
+		pfb_init_prefilter(&prefilter) ? &prefilter : nullptr, nullptr};
+	const pfb_phase_clock_t clock = pfb_stats_begin(PFB_PHASE_READ);
 
-	for(pfb_context_t *pfbc = cs->begin_context; pfbc < cs->end_context; pfbc++)
+	if(!read_concurrent(&pc, cs) && !read_pipelined(&pc, cs))
 	{
-		if(pfbc->in_fname)
-		{
-			DEBUG_PRINTF("Reading %s...\n", pfbc->in_fname);
-		}
-		else
-		{
-			DEBUG_PRINTF("Reading from unnamed input\n");
-		}
-		pfb_read_one_context(pfbc, pfb_insert, &pc);
+		token_sink_t sink = {.pc = &pc};
+		read_contexts(cs, &sink);
 	}
 
+	pfb_stats_end(&clock);
+	pfb_free_prefilter(&prefilter);
 	free_DomainView(&dv);
 }
 
@@ -546,7 +971,7 @@ static void write_line_from_buffer(pfb_context_t in_c[static 1], line_info_t li,
 
 static const uint rw_buffer_size = 512;
 
-static void write_line_from_file(pfb_context_t in_c[static 1], line_info_t li,
+static void read_line_from_file(pfb_context_t in_c[static 1], line_info_t li,
 		pfb_out_context_t out_c[static 1])
 {
 	ASSERT(in_c);
@@ -572,16 +997,49 @@ static void write_line_from_file(pfb_context_t in_c[static 1], line_info_t li,
 	const size_t read_size = fread(out_c->buffer, sizeof(char),
 			li.line_len, in_c->in_file);
 
+	UNUSED(read_size);
 	ASSERT(read_size == li.line_len);
 	ASSERT(read_size > 0);
+}
+
+static void write_line_from_file(pfb_context_t in_c[static 1], line_info_t li,
+		pfb_out_context_t out_c[static 1])
+{
+	read_line_from_file(in_c, li, out_c);
 
 #if 0
 	DEBUG_PRINTF("write from file .. line len=%u\n", li.line_len);
 	DEBUG_PRINTF("write from file .. offset=%lu\n", li.offset);
 #endif
-	const size_t wrote_size = out_c->writer_cb(out_c->buffer, read_size, out_c);
+	const size_t wrote_size = out_c->writer_cb(out_c->buffer, li.line_len, out_c);
 	UNUSED(wrote_size);
-	ASSERT(wrote_size == read_size);
+	ASSERT(wrote_size == li.line_len);
+}
+
+static void alloc_rw_buffer(pfb_out_context_t out_c[static 1])
+{
+	if(out_c->buffer == nullptr)
+	{
+		out_c->buffer = malloc(rw_buffer_size * sizeof(char));
+		CHECK_MALLOC(out_c->buffer);
+	}
+}
+
+/**
+ * Returns the line described by 'li' as held by the input context's buffer or
+ * read into the output context's buffer. The line is not null terminated.
+ */
+static char *pfb_read_line(pfb_context_t in_c[static 1], line_info_t li,
+		pfb_out_context_t out_c[static 1])
+{
+	if(in_c->mem_buffer)
+	{
+		return &in_c->mem_buffer[li.offset];
+	}
+
+	alloc_rw_buffer(out_c);
+	read_line_from_file(in_c, li, out_c);
+	return out_c->buffer;
 }
 
 /**
@@ -619,11 +1077,7 @@ static void pfb_write_line(pfb_context_t in_c[static 1], line_info_t li,
 		// otherwise, ensure an output buffer is allocated and write by reading
 		// from input file into this output buffer and write to disk from the
 		// output buffer.
-		if(out_c->buffer == nullptr)
-		{
-			out_c->buffer = malloc(rw_buffer_size * sizeof(char));
-			CHECK_MALLOC(out_c->buffer);
-		}
+		alloc_rw_buffer(out_c);
 		write_line_from_file(in_c, li, out_c);
 	}
 }
@@ -639,28 +1093,62 @@ static void pfb_write_DomainInfo(DomainInfo_t *di[static 1], void *context)
 	ASSERT(input_context);
 	ASSERT(output_context);
 
-	pfb_write_line(input_context, (*di)->li, output_context);
+	const line_info_t li = (*di)->li;
+	const MatchStrength_t ms = (*di)->match_strength;
+	const size_t written = output_context->counter;
+	if(!output_context->allow && !input_context->folded &&
+			output_context->format == PFB_FORMAT_ADBPLUS && !output_context->next)
+	{
+		pfb_write_line(input_context, li, output_context);
+		output_context->counter++;
+	}
+	else
+	{
+		// read once for every output of the chain.
+		char *line = pfb_read_line(input_context, li, output_context);
+		if(input_context->folded)
+		{
+			// the input holds the domain as read; the tree held it lowercased.
+			bool folded;
+			if(ms == MATCH_FULL)
+				normalize_domain(line + 2, li.line_len - 3, &folded);
+			else
+				normalize_domain(line, li.line_len, &folded);
+		}
+
+		if(output_context->allow)
+			pfb_write_allowed(output_context, line, li.line_len, ms);
+		else
+			pfb_write_formatted(output_context, line, li.line_len, ms);
+	}
+	// an entry an exception allows is not written.
+	input_context->kept += output_context->counter != written;
 
 	// this "collector" transfers the info on DomainInfo into the new container.
 	// the DomainInfo is effectively dangling. it's parent holder, the
 	// DomainTree, will be destroyed soon after returning from this function.
 	free_DomainInfo(di);
 	ASSERT(*di == nullptr);
-
-	output_context->counter++;
 }
 
 void pfb_write_carry_over(pfb_context_collect_t pcc[static 1])
 {
 	if(pcc->in_contexts.end_context - pcc->in_contexts.begin_context == 1)
 	{
-		for(size_len_t i = 0; i < pcc->in_contexts.begin_context->co.used;
-				i++)
+		// the header and comments are adbplus syntax; other formats go
+		// without.
+		for(pfb_out_context_t *c = &pcc->out_context; c; c = c->next)
 		{
-			// write carry over lines to output context
-			pfb_write_line(pcc->in_contexts.begin_context,
-					pcc->in_contexts.begin_context->co.li[i],
-					&pcc->out_context);
+			if(c->format != PFB_FORMAT_ADBPLUS)
+				continue;
+
+			for(size_len_t i = 0; i < pcc->in_contexts.begin_context->co.used;
+					i++)
+			{
+				// write carry over lines to output context
+				pfb_write_line(pcc->in_contexts.begin_context,
+						pcc->in_contexts.begin_context->co.li[i], c);
+			}
 		}
 	}
 	else
@@ -681,22 +1169,90 @@ void pfb_consolidate(TLD_implementation_t tld_impl, pfb_out_context_t out_contex
 	ASSERT(tld_impl.impl_funcs);
 	ASSERT(tld_impl.context);
 
+	const pfb_phase_clock_t clock = pfb_stats_begin(PFB_PHASE_CONSOLIDATE);
 	tld_impl.impl_funcs->sort_domain_entries(tld_impl.context);
 
 	TLD_EntryIter_t it = nullptr;
 	DomainTree_t **dt = nullptr;
+	// dt is nullptr when the tree is empty, e.g., an input of only comments.
 	tld_impl.impl_funcs->create_entry_iter(tld_impl.context, &it, &dt);
-	// TODO may be cases where the tree is empty...
-	ASSERT(*dt);
 
 	while(dt != nullptr && *dt != nullptr)
 	{
 		transfer_DomainInfo(dt, pfb_write_DomainInfo, out_context);
 		free_DomainTreePtr(dt);
 		dt = tld_impl.impl_funcs->next_used_tld_entry(it);
+		pfb_stats_poll();
 	}
 
 	tld_impl.impl_funcs->free_entry_iter(&it);
+	pfb_stats_end(&clock);
+
+	if(out_context->index_file)
+	{
+		ASSERT(out_context->writer_cb == pfb_out_context_write_BUFFER);
+		pfb_write_index(out_context->index_file, out_context->out_buffer);
+	}
+}
+
+/**
+ * de-duplicate, sort, and write the final adlist to the specified output
+ * context.
+ *
+ * this will eventually support reading inputs that have been sorted alongside
+ * raw unsorted inputs.
+ */
+void sort_adbplus_adlists(TLD_implementation_t tld_impl,
+		pfb_context_collect_t in_pcc[static 1], bool include_carry_over)
+{
+	ASSERT(tld_impl.context);
+
+	// in a world where many more file handles are involved than can be opened
+	// simultaneously... opening what is necessary and closing afterwards makes
+	// sense.
+	pfb_open_contexts(&in_pcc->in_contexts);
+
+	// only the final list, the one the carry over goes to, is split by the
+	// exceptions; an intermediate list, e.g., of a diff or an index, holds the
+	// blocked entries alone.
+	pfb_allow_t allow = pfb_init_allow(include_carry_over);
+
+	// open the files to verify all files can be read. open output file to
+	// verify those can be written.
+	pfb_read_all(tld_impl, &allow, &in_pcc->in_contexts);
+	if(allow.count > 0)
+	{
+		in_pcc->out_context.allow = &allow;
+		// an in-memory list keeps the exceptions for the lists it is merged
+		// with later on, e.g., as an index.
+		if(pfb_is_out_context_BUFFER(&in_pcc->out_context))
+		{
+			pfb_keep_allowed(&allow, in_pcc->out_context.out_buffer);
+		}
+	}
+
+	// append mode: if writing header and comments and regexes outside of this
+	// area, then it needs to be true(?) otherwise it's always create a new
+	// file.
+	pfb_open_out_context(&in_pcc->out_context, false);
+	pfb_write_format_headers(&in_pcc->out_context);
+
+	// one input context means the carry over can be written to the output
+	// context. when multiple inputs are independently de-duplicated, this would
+	// have multiple input contexts to deal with paired with a single output
+	// context.
+	if(include_carry_over)
+	{
+		pfb_write_carry_over(in_pcc);
+	}
+
+	pfb_consolidate(tld_impl, &in_pcc->out_context);
+
+	in_pcc->out_context.allow = nullptr;
+	pfb_free_allow(&allow);
+
+	pfb_close_contexts(&in_pcc->in_contexts);
+	pfb_close_out_context(&in_pcc->out_context);
 }
 
 pfb_context_t pfb_context_from_FILE(FILE *tmp)
@@ -728,10 +1284,21 @@ void pfb_free_out_buffer(pfb_out_buffer_t pob[static 1])
 	DEBUG_PRINTF("pob li alloc=%u\n", pob->litelines.alloc);
 	DEBUG_PRINTF("pob li used=%u\n", pob->litelines.used);
 	DEBUG_PRINTF("pob li overalloc=%u\n", pob->litelines.alloc - pob->litelines.used);
+	pfb_mem_release(pob->charged);
+	pob->charged = 0;
+	if(pob->mapping)
+	{
+		munmap(pob->mapping, pob->mapping_len);
+		*pob = (pfb_out_buffer_t){};
+		return;
+	}
 	free(pob->buffer);
 	pob->buffer = nullptr;
 	pob->alloc_len = 0;
 	free(pob->litelines.li);
 	pob->litelines.li = nullptr;
+	free(pob->allowed);
+	pob->allowed = nullptr;
+	pob->allowed_len = 0;
 }
 
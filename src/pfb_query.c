@@ -0,0 +1,304 @@
+/**
+ * pfb_query.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// mmap() and posix_madvise() are POSIX; -std=c23 declares only ISO C otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "dedupdomains.h"
+#include "pfb_context.h"
+#include "pfb_query.h"
+#include "pfb_lookup.h"
+#include "domaintree.h"
+#include "domaininfo.h"
+#include "tld_hash_context.h"
+#include "adbplusline.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Answer which rule, if any, blocks each of a file of query names, e.g., a day
+ * of resolver logs reduced to one name per line. The lists are de-duplicated
+ * and inserted into a DomainTree; the queries are looked up in batches of
+ * QUERY_BATCH so the cache misses of one batch overlap. The query file is
+ * mapped and every DomainView is reused: nothing is allocated per query.
+ *
+ * Writes "<query>\t<rule>" for every blocked query followed by a summary line
+ * "! queried\t<count>\tblocked\t<count>\tinvalid\t<count>". Blank lines and
+ * lines starting with '#' are skipped; a trailing '.' is ignored.
+ */
+
+#define QUERY_BATCH 16
+
+// longest name in DNS presentation format, without the trailing '.'.
+#define QUERY_MAX_LEN 253
+
+typedef struct query_context
+{
+	TLD_implementation_t tld_impl;
+	pfb_out_buffer_t const *sorted;
+	pfb_out_context_t out_context;
+
+	DomainView_t dvs[QUERY_BATCH];
+	DomainLookup_t lookups[QUERY_BATCH];
+	uint used;
+
+	// holds one output line; grown to the longest rule.
+	char *line;
+	size_t line_alloc;
+
+	size_t queried;
+	size_t blocked;
+	size_t invalid;
+} query_context_t;
+
+/**
+ * Insert every entry of the de-duplicated 'sorted' into the tree. The entries
+ * refer to 'sorted' which must outlive the tree.
+ */
+static void insert_BUFFER(TLD_implementation_t tld_impl,
+		pfb_out_buffer_t const sorted[static 1])
+{
+	DomainView_t dv;
+	init_DomainView(&dv);
+
+	for(size_len_t i = 0; i < sorted->litelines.used; i++)
+	{
+		AdbplusView_t lv;
+		if(!parse_adbplus_line(&lv, sorted->buffer + sorted->litelines.li[i].offset)
+				|| !update_DomainView(&dv, lv.data, lv.len))
+		{
+			continue;
+		}
+		dv.li = sorted->litelines.li[i];
+		dv.match_strength = lv.ms;
+		insert_DomainTree(tld_impl, &dv);
+	}
+
+	free_DomainView(&dv);
+}
+
+static void free_tree(TLD_implementation_t tld_impl)
+{
+	TLD_EntryIter_t it = nullptr;
+	DomainTree_t **dt = nullptr;
+	tld_impl.impl_funcs->create_entry_iter(tld_impl.context, &it, &dt);
+
+	while(dt != nullptr)
+	{
+		free_DomainTree(dt);
+		dt = tld_impl.impl_funcs->next_used_tld_entry(it);
+	}
+
+	tld_impl.impl_funcs->free_entry_iter(&it);
+}
+
+static void write_hit(query_context_t qc[static 1], DomainLookup_t const *lookup)
+{
+	DomainView_t const *dv = lookup->dv;
+	line_info_t const li = lookup->di->li;
+
+	const size_t len = dv->fqd.len + 1 + li.line_len;
+	if(len > qc->line_alloc)
+	{
+		qc->line_alloc = len;
+		CHECK_REALLOC(qc->line, qc->line_alloc);
+	}
+
+	memcpy(qc->line, dv->fqd.data, dv->fqd.len);
+	qc->line[dv->fqd.len] = '\t';
+	memcpy(qc->line + dv->fqd.len + 1, qc->sorted->buffer + li.offset,
+			li.line_len);
+
+	qc->out_context.writer_cb(qc->line, len, &qc->out_context);
+	qc->blocked++;
+}
+
+static void flush_batch(query_context_t qc[static 1])
+{
+	lookup_batch_DomainTree(qc->tld_impl, qc->lookups, qc->used);
+
+	for(uint i = 0; i < qc->used; i++)
+	{
+		if(qc->lookups[i].di)
+		{
+			write_hit(qc, &qc->lookups[i]);
+		}
+	}
+	qc->used = 0;
+}
+
+static bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void add_query(query_context_t qc[static 1], char const *name,
+		size_len_t len)
+{
+	while(len > 0 && is_space(*name))
+	{
+		name++;
+		len--;
+	}
+	while(len > 0 && is_space(name[len - 1]))
+	{
+		len--;
+	}
+	if(len == 0 || name[0] == '#')
+	{
+		return;
+	}
+
+	qc->queried++;
+
+	DomainView_t *dv = &qc->dvs[qc->used];
+	if(len > QUERY_MAX_LEN + 1 || !pfb_query_DomainView(dv, name, len))
+	{
+		qc->invalid++;
+		return;
+	}
+
+	qc->lookups[qc->used].dv = dv;
+	if(++qc->used == QUERY_BATCH)
+	{
+		flush_batch(qc);
+	}
+}
+
+static void query_mapping(query_context_t qc[static 1], char const *begin,
+		char const *end)
+{
+	while(begin < end)
+	{
+		char const *nl = memchr(begin, '\n', end - begin);
+		if(!nl)
+		{
+			nl = end;
+		}
+		add_query(qc, begin, nl - begin);
+		begin = nl + 1;
+	}
+
+	flush_batch(qc);
+}
+
+/**
+ * Map 'path' read-only. An empty file maps to nothing and is not an error.
+ */
+static bool map_queries(const char path[static 1], void **mapping,
+		size_t len[static 1])
+{
+	const int fd = open(path, O_RDONLY);
+	if(fd == -1)
+	{
+		ELOG_STDERR("ERROR: failed to open queries %s for reading\n", path);
+		return false;
+	}
+
+	struct stat s;
+	if(fstat(fd, &s) != 0)
+	{
+		ELOG_STDERR("ERROR: failed to stat queries %s\n", path);
+		close(fd);
+		return false;
+	}
+
+	*mapping = nullptr;
+	*len = s.st_size;
+	if(*len > 0)
+	{
+		*mapping = mmap(nullptr, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(*mapping == MAP_FAILED)
+		{
+			ELOG_STDERR("ERROR: failed to map queries %s\n", path);
+			close(fd);
+			return false;
+		}
+		posix_madvise(*mapping, *len, POSIX_MADV_SEQUENTIAL);
+	}
+	close(fd);
+	return true;
+}
+
+/**
+ * Look up every name of 'query_fname' in the lists of 'in_paths_list' and
+ * write the hits to 'out_fname', or stdout if nullptr.
+ */
+bool pfb_query_adlists(const char query_fname[static 1],
+		paths_list_t in_paths_list, const char *out_fname,
+		bool (*load_set)(paths_list_t, pfb_out_buffer_t[static 1]))
+{
+	void *mapping;
+	size_t mapping_len;
+	if(!map_queries(query_fname, &mapping, &mapping_len))
+	{
+		return false;
+	}
+
+	pfb_out_buffer_t sorted;
+	if(!load_set(in_paths_list, &sorted))
+	{
+		if(mapping)
+		{
+			munmap(mapping, mapping_len);
+		}
+		return false;
+	}
+
+	query_context_t qc = {
+		.tld_impl = create_tld_hash_impl(),
+		.sorted = &sorted,
+		.out_context = pfb_init_out_context(out_fname),
+	};
+	ASSERT(qc.tld_impl.context);
+	for(uint i = 0; i < QUERY_BATCH; i++)
+	{
+		init_DomainView(&qc.dvs[i]);
+	}
+
+	insert_BUFFER(qc.tld_impl, &sorted);
+
+	pfb_open_out_context(&qc.out_context, false);
+	query_mapping(&qc, mapping, (char const*)mapping + mapping_len);
+
+	char summary[128];
+	const int summary_len = snprintf(summary, sizeof(summary),
+			"! queried\t%zu\tblocked\t%zu\tinvalid\t%zu",
+			qc.queried, qc.blocked, qc.invalid);
+	qc.out_context.writer_cb(summary, summary_len, &qc.out_context);
+
+	pfb_free_out_context(&qc.out_context);
+	free(qc.line);
+	for(uint i = 0; i < QUERY_BATCH; i++)
+	{
+		free_DomainView(&qc.dvs[i]);
+	}
+	free_tree(qc.tld_impl);
+	free_tld_impl(&qc.tld_impl);
+	pfb_free_out_buffer(&sorted);
+	if(mapping)
+	{
+		munmap(mapping, mapping_len);
+	}
+	return true;
+}
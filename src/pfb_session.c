@@ -0,0 +1,559 @@
+/**
+ * pfb_session.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// fmemopen() and open_memstream() are POSIX; -std=c23 declares only ISO C
+// otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "dedupdomains.h"
+#include "pfb_allow.h"
+#include "pfb_context.h"
+#include "pfb_differ.h"
+#include "pfb_lookup.h"
+#include "pfb_prune.h"
+#include "pfb_session.h"
+#include "tld_hash_context.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The lists of a session are held as the de-duplicated and sorted buffers the
+ * differ works on. The session, its lists, and the results handed out are
+ * allocated by the session's allocator; the buffers of the engine are not.
+ * Diagnostics raised during a call are routed to the session's log sink
+ * through the sink of the calling thread.
+ */
+
+#define SESSION_BUFFER_SIZE 4096
+
+typedef struct session_list
+{
+	char *name;
+	pfb_out_buffer_t sorted;
+} session_list_t;
+
+struct pfb_session
+{
+	pfb_session_allocator_t allocator;
+	pfb_log_sink_t log;
+
+	session_list_t *lists;
+	uint lists_used;
+	uint lists_alloc;
+
+	// consolidation of all lists; rebuilt when first needed after a change.
+	pfb_out_buffer_t all;
+	bool all_valid;
+
+	DomainView_t query;
+	DomainView_t scratch;
+};
+
+static void *default_alloc(size_t size, void *)
+{
+	return malloc(size);
+}
+
+static void default_free(void *ptr, void *)
+{
+	free(ptr);
+}
+
+static void *session_alloc(pfb_session_t s[static 1], size_t size)
+{
+	void *ptr = s->allocator.alloc(size, s->allocator.context);
+	CHECK_MALLOC(ptr);
+	return ptr;
+}
+
+static void session_free(pfb_session_t s[static 1], void *ptr)
+{
+	if(ptr)
+	{
+		s->allocator.free(ptr, s->allocator.context);
+	}
+}
+
+/**
+ * Route the diagnostics of this thread to the session until leave_session().
+ */
+static pfb_log_sink_t const *enter_session(pfb_session_t s[static 1])
+{
+	return swap_threadLogSink(s->log.write ? &s->log : nullptr);
+}
+
+static void leave_session(pfb_log_sink_t const *prev)
+{
+	swap_threadLogSink(prev);
+}
+
+pfb_session_t *pfb_create_session(pfb_session_config_t const *config)
+{
+	pfb_session_allocator_t allocator = {
+		.alloc = default_alloc,
+		.free = default_free,
+	};
+	if(config && config->allocator.alloc && config->allocator.free)
+	{
+		allocator = config->allocator;
+	}
+
+	pfb_session_t *s = allocator.alloc(sizeof(pfb_session_t), allocator.context);
+	if(!s)
+	{
+		return nullptr;
+	}
+
+	*s = (pfb_session_t){
+		.allocator = allocator,
+		.log = config ? config->log : (pfb_log_sink_t){},
+	};
+	init_DomainView(&s->query);
+	init_DomainView(&s->scratch);
+	return s;
+}
+
+static void invalidate_all(pfb_session_t s[static 1])
+{
+	if(s->all_valid)
+	{
+		pfb_free_out_buffer(&s->all);
+		s->all_valid = false;
+	}
+}
+
+void pfb_free_session(pfb_session_t *s)
+{
+	if(!s)
+	{
+		return;
+	}
+
+	for(uint i = 0; i < s->lists_used; i++)
+	{
+		session_free(s, s->lists[i].name);
+		pfb_free_out_buffer(&s->lists[i].sorted);
+	}
+	session_free(s, s->lists);
+	invalidate_all(s);
+	free_DomainView(&s->query);
+	free_DomainView(&s->scratch);
+	session_free(s, s);
+}
+
+static pfb_out_buffer_t create_out_buffer()
+{
+	pfb_out_buffer_t ret = {
+		.buffer = malloc(SESSION_BUFFER_SIZE),
+		.alloc_len = SESSION_BUFFER_SIZE,
+	};
+	CHECK_MALLOC(ret.buffer);
+	return ret;
+}
+
+/**
+ * De-duplicate and sort the list held in 'data' into 'out'. The input context
+ * reads 'data' through a FILE so the reader is the same as for files on disk.
+ */
+static void sort_BUFFER(const char *data, size_t len,
+		pfb_out_buffer_t out[static 1])
+{
+	*out = create_out_buffer();
+	if(len == 0)
+	{
+		return;
+	}
+
+	FILE *in_file = fmemopen((void*)data, len, "rb");
+	CHECK_MALLOC(in_file);
+
+	pfb_context_collect_t pcc = {
+		.out_context = pfb_init_out_context_BUFFER(out),
+	};
+	pcc.in_contexts.begin_context = calloc(1, sizeof(pfb_context_t));
+	CHECK_MALLOC(pcc.in_contexts.begin_context);
+	pcc.in_contexts.end_context = pcc.in_contexts.begin_context + 1;
+	*pcc.in_contexts.begin_context = (pfb_context_t){
+		.in_file = in_file,
+		.file_size = len,
+		// the entries are re-read through the FILE; writing from a memory
+		// buffer is supported only to a FILE.
+		.use_mem_buffer = false,
+	};
+
+	TLD_implementation_t tld_impl = create_tld_hash_impl();
+	ASSERT(tld_impl.context);
+
+	// the list held is an intermediate one; exceptions subtract from it alone.
+	pfb_allow_t allow = pfb_init_allow(false);
+	pfb_read_all(tld_impl, &allow, &pcc.in_contexts);
+	if(allow.count > 0)
+	{
+		pcc.out_context.allow = &allow;
+	}
+	pfb_consolidate(tld_impl, &pcc.out_context);
+	pcc.out_context.allow = nullptr;
+	pfb_free_allow(&allow);
+
+	// without a name, the context leaves closing its FILE to its creator.
+	fclose(in_file);
+	pfb_free_context_collect(&pcc);
+	free_tld_impl(&tld_impl);
+}
+
+static session_list_t *find_list(pfb_session_t s[static 1], const char *name)
+{
+	for(uint i = 0; i < s->lists_used; i++)
+	{
+		if(strcmp(s->lists[i].name, name) == 0)
+			return &s->lists[i];
+	}
+	return nullptr;
+}
+
+static session_list_t *add_list(pfb_session_t s[static 1], const char *name)
+{
+	if(s->lists_used == s->lists_alloc)
+	{
+		const uint lists_alloc = MAX(2 * s->lists_alloc, 4u);
+		session_list_t *lists = session_alloc(s, sizeof(session_list_t) * lists_alloc);
+		if(s->lists_used)
+		{
+			memcpy(lists, s->lists, sizeof(session_list_t) * s->lists_used);
+		}
+		session_free(s, s->lists);
+		s->lists = lists;
+		s->lists_alloc = lists_alloc;
+	}
+
+	const size_t name_len = strlen(name);
+	session_list_t *list = &s->lists[s->lists_used++];
+	list->name = session_alloc(s, name_len + 1);
+	memcpy(list->name, name, name_len + 1);
+	return list;
+}
+
+/**
+ * Ingest the list held in the 'len' bytes of 'data' as the list 'name',
+ * replacing any list of that name. 'data' is not referenced after the call.
+ */
+bool pfb_session_ingest(pfb_session_t *s, const char *name, const char *data,
+		size_t len)
+{
+	ASSERT(s);
+	pfb_log_sink_t const *prev = enter_session(s);
+
+	bool ok = false;
+	if(!name || !*name || (!data && len > 0))
+	{
+		ELOG_STDERR("ERROR: a list needs a non-empty name and data\n");
+	}
+	else
+	{
+		session_list_t *list = find_list(s, name);
+		if(list)
+		{
+			pfb_free_out_buffer(&list->sorted);
+		}
+		else
+		{
+			list = add_list(s, name);
+		}
+		sort_BUFFER(data, len, &list->sorted);
+		invalidate_all(s);
+		ok = true;
+	}
+
+	leave_session(prev);
+	return ok;
+}
+
+bool pfb_session_remove(pfb_session_t *s, const char *name)
+{
+	ASSERT(s);
+	pfb_log_sink_t const *prev = enter_session(s);
+
+	session_list_t *list = name ? find_list(s, name) : nullptr;
+	if(list)
+	{
+		session_free(s, list->name);
+		pfb_free_out_buffer(&list->sorted);
+		*list = s->lists[--s->lists_used];
+		invalidate_all(s);
+	}
+	else
+	{
+		ELOG_STDERR("ERROR: no list %s\n", name ? name : "");
+	}
+
+	leave_session(prev);
+	return list != nullptr;
+}
+
+/**
+ * The list 'name', or the consolidation of all lists when 'name' is nullptr.
+ * Returns nullptr if there is no such list.
+ */
+static pfb_out_buffer_t *get_list(pfb_session_t s[static 1], const char *name)
+{
+	if(name)
+	{
+		session_list_t *list = find_list(s, name);
+		if(!list)
+		{
+			ELOG_STDERR("ERROR: no list %s\n", name);
+			return nullptr;
+		}
+		return &list->sorted;
+	}
+
+	if(!s->all_valid)
+	{
+		s->all = create_out_buffer();
+		if(s->lists_used > 0)
+		{
+			pfb_out_buffer_t **in = calloc(s->lists_used, sizeof(pfb_out_buffer_t*));
+			CHECK_MALLOC(in);
+			for(uint i = 0; i < s->lists_used; i++)
+			{
+				in[i] = &s->lists[i].sorted;
+			}
+			pfb_out_context_t out_context = pfb_init_out_context_BUFFER(&s->all);
+			union_adbplus_adlists_BUFFER(in, s->lists_used, &out_context);
+			free(in);
+		}
+		s->all_valid = true;
+	}
+	return &s->all;
+}
+
+static void copy_result(pfb_session_t s[static 1], const char *data, size_t len,
+		pfb_result_t result[static 1])
+{
+	result->data = session_alloc(s, len + 1);
+	memcpy(result->data, data, len);
+	result->data[len] = '\0';
+	result->len = len;
+}
+
+/**
+ * Write the list 'name', or the consolidation of all lists when 'name' is
+ * nullptr, to 'result' as an adlist: one entry per line.
+ */
+bool pfb_session_dedup(pfb_session_t *s, const char *name,
+		pfb_result_t result[static 1])
+{
+	ASSERT(s);
+	pfb_log_sink_t const *prev = enter_session(s);
+
+	*result = (pfb_result_t){};
+	pfb_out_buffer_t const *sorted = get_list(s, name);
+	if(sorted)
+	{
+		size_t len = 0;
+		for(size_len_t i = 0; i < sorted->litelines.used; i++)
+		{
+			len += sorted->litelines.li[i].line_len + 1;
+		}
+
+		result->data = session_alloc(s, len + 1);
+		char *w = result->data;
+		for(size_len_t i = 0; i < sorted->litelines.used; i++)
+		{
+			const line_info_t li = sorted->litelines.li[i];
+			memcpy(w, sorted->buffer + li.offset, li.line_len);
+			w += li.line_len;
+			*w++ = '\n';
+		}
+		*w = '\0';
+		result->len = len;
+	}
+
+	leave_session(prev);
+	return sorted != nullptr;
+}
+
+/**
+ * Write the diff report of the list 'name_A' against 'name_B' to 'result'. A
+ * nullptr name is the consolidation of all lists.
+ */
+bool pfb_session_diff(pfb_session_t *s, const char *name_A, const char *name_B,
+		pfb_result_t result[static 1])
+{
+	ASSERT(s);
+	pfb_log_sink_t const *prev = enter_session(s);
+
+	*result = (pfb_result_t){};
+	pfb_out_buffer_t *sorted_A = get_list(s, name_A);
+	pfb_out_buffer_t *sorted_B = sorted_A ? get_list(s, name_B) : nullptr;
+	if(sorted_B)
+	{
+		char *report = nullptr;
+		size_t report_len = 0;
+		FILE *out_file = open_memstream(&report, &report_len);
+		CHECK_MALLOC(out_file);
+		pfb_out_context_t out_context = pfb_init_out_context(nullptr);
+		out_context.out_file = out_file;
+		diff_adbplus_adlists_BUFFER(sorted_A, sorted_B, &out_context,
+				DIFF_REPORT);
+		pfb_free_out_context(&out_context);
+		fclose(out_file);
+
+		copy_result(s, report, report_len, result);
+		free(report);
+	}
+
+	leave_session(prev);
+	return sorted_B != nullptr;
+}
+
+/**
+ * Find the rule of the list 'name', or of the consolidation of all lists when
+ * 'name' is nullptr, which blocks 'domain'. 'result' holds the rule, or is
+ * empty if nothing blocks 'domain'. Returns false if 'domain' is not a domain
+ * or there is no such list.
+ */
+bool pfb_session_lookup(pfb_session_t *s, const char *name, const char *domain,
+		size_t len, pfb_result_t result[static 1])
+{
+	ASSERT(s);
+	pfb_log_sink_t const *prev = enter_session(s);
+
+	*result = (pfb_result_t){};
+	pfb_out_buffer_t const *sorted = nullptr;
+	if(!domain || !pfb_query_DomainView(&s->query, domain, len))
+	{
+		ELOG_STDERR("ERROR: not a domain: %.*s\n", domain ? (int)len : 0,
+				domain ? domain : "");
+	}
+	else
+	{
+		sorted = get_list(s, name);
+	}
+
+	size_len_t found;
+	if(sorted && pfb_lookup_BUFFER(sorted, &s->query, &s->scratch, &found))
+	{
+		const line_info_t li = sorted->litelines.li[found];
+		copy_result(s, sorted->buffer + li.offset, li.line_len, result);
+	}
+
+	leave_session(prev);
+	return sorted != nullptr;
+}
+
+void pfb_free_result(pfb_session_t *s, pfb_result_t result[static 1])
+{
+	ASSERT(s);
+	session_free(s, result->data);
+	*result = (pfb_result_t){};
+}
+
+#ifdef BUILD_TESTS
+#include <threads.h>
+
+static const char test_list_A[] =
+	"! comment\n"
+	"||ads.example.com^\n"
+	"||x.ads.example.com^\n"
+	"||tracker.net^\n";
+static const char test_list_B[] =
+	"||tracker.net^\n"
+	"||b.example.org^\n";
+
+static void test_log(const char *message, void *context)
+{
+	UNUSED(message);
+	(*(uint*)context)++;
+}
+
+static int test_one_session(void *)
+{
+	uint logged = 0;
+	pfb_session_config_t config = {
+		.log = {.write = test_log, .context = &logged},
+	};
+	pfb_session_t *s = pfb_create_session(&config);
+	assert(s);
+
+	assert(pfb_session_ingest(s, "a", test_list_A, sizeof(test_list_A) - 1));
+	assert(pfb_session_ingest(s, "b", test_list_B, sizeof(test_list_B) - 1));
+	assert(pfb_session_ingest(s, "empty", "! nothing\n", 10));
+
+	pfb_result_t r;
+	assert(pfb_session_dedup(s, "a", &r));
+	assert(strcmp(r.data, "||ads.example.com^\n||tracker.net^\n") == 0);
+	pfb_free_result(s, &r);
+
+	assert(pfb_session_dedup(s, "empty", &r));
+	assert(r.len == 0);
+	pfb_free_result(s, &r);
+
+	assert(pfb_session_dedup(s, nullptr, &r));
+	assert(strcmp(r.data,
+				"||ads.example.com^\n||tracker.net^\n||b.example.org^\n") == 0);
+	pfb_free_result(s, &r);
+
+	const char *q = "deep.x.ads.example.com";
+	assert(pfb_session_lookup(s, nullptr, q, strlen(q), &r));
+	assert(strcmp(r.data, "||ads.example.com^") == 0);
+	pfb_free_result(s, &r);
+
+	q = "example.com";
+	assert(pfb_session_lookup(s, "a", q, strlen(q), &r));
+	assert(r.len == 0);
+	pfb_free_result(s, &r);
+
+	assert(pfb_session_diff(s, "a", "b", &r));
+	assert(r.len > 0);
+	pfb_free_result(s, &r);
+
+	assert(logged == 0);
+	assert(!pfb_session_dedup(s, "missing", &r));
+	assert(!pfb_session_remove(s, "missing"));
+	assert(logged == 2);
+
+	assert(pfb_session_remove(s, "b"));
+	assert(pfb_session_lookup(s, nullptr, "b.example.org", 13, &r));
+	assert(r.len == 0);
+
+	pfb_free_session(s);
+	return 0;
+}
+
+void test_pfb_session()
+{
+	printf("Testing pfb_session..\n");
+	test_one_session(nullptr);
+
+	// sessions share nothing; run several at once.
+	thrd_t threads[4];
+	for(uint i = 0; i < 4; i++)
+	{
+		assert(thrd_create(&threads[i], test_one_session, nullptr) == thrd_success);
+	}
+	for(uint i = 0; i < 4; i++)
+	{
+		int res;
+		assert(thrd_join(threads[i], &res) == thrd_success);
+		assert(res == 0);
+	}
+	printf("Tested pfb_session.\n");
+}
+#endif
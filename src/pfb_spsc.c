@@ -0,0 +1,213 @@
+/**
+ * pfb_spsc.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "pfb_spsc.h"
+#include <stdlib.h>
+#include <threads.h>
+
+// spins before yielding and yields before sleeping while a ring is full or
+// empty; the other side is usually a moment away.
+#define SPSC_SPINS 64
+#define SPSC_YIELDS 256
+#define SPSC_SLEEP_NS 50000
+
+/**
+ * A ring holding up to 'capacity' items, rounded up to a power of two.
+ */
+void pfb_init_spsc(pfb_spsc_t q[static 1], size_t capacity)
+{
+	size_t slots = 1;
+	while(slots < capacity)
+	{
+		slots *= 2;
+	}
+
+	q->slots = calloc(slots, sizeof(void*));
+	CHECK_MALLOC(q->slots);
+	q->mask = slots - 1;
+	atomic_init(&q->head, 0);
+	atomic_init(&q->tail, 0);
+}
+
+void pfb_free_spsc(pfb_spsc_t q[static 1])
+{
+	free(q->slots);
+	q->slots = nullptr;
+	q->mask = 0;
+}
+
+/**
+ * Producer side. Returns false if the ring is full.
+ */
+bool pfb_spsc_push(pfb_spsc_t q[static 1], void *item)
+{
+	const size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+	const size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+	if(tail - head > q->mask)
+	{
+		return false;
+	}
+
+	q->slots[tail & q->mask] = item;
+	atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+	return true;
+}
+
+/**
+ * Consumer side. Returns nullptr if the ring is empty.
+ */
+void *pfb_spsc_pop(pfb_spsc_t q[static 1])
+{
+	const size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	const size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+	if(head == tail)
+	{
+		return nullptr;
+	}
+
+	void *item = q->slots[head & q->mask];
+	atomic_store_explicit(&q->head, head + 1, memory_order_release);
+	return item;
+}
+
+static void spsc_wait(uint tries)
+{
+	if(tries < SPSC_SPINS)
+	{
+		return;
+	}
+	if(tries < SPSC_SPINS + SPSC_YIELDS)
+	{
+		thrd_yield();
+		return;
+	}
+	thrd_sleep(&(struct timespec){.tv_nsec = SPSC_SLEEP_NS}, nullptr);
+}
+
+/**
+ * pfb_spsc_push() waiting for room.
+ */
+void pfb_spsc_put(pfb_spsc_t q[static 1], void *item)
+{
+	for(uint tries = 0; !pfb_spsc_push(q, item); tries++)
+	{
+		spsc_wait(tries);
+	}
+}
+
+/**
+ * pfb_spsc_pop() waiting for an item. Never returns nullptr; the producer
+ * does not push it.
+ */
+void *pfb_spsc_take(pfb_spsc_t q[static 1])
+{
+	void *item;
+	for(uint tries = 0; !(item = pfb_spsc_pop(q)); tries++)
+	{
+		spsc_wait(tries);
+	}
+	return item;
+}
+
+#ifdef BUILD_TESTS
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TEST_ITEMS 100000
+
+static void *item_of(uintptr_t i)
+{
+	// nullptr means empty; number the items from 1.
+	return (void*)(i + 1);
+}
+
+static int test_producer(void *data)
+{
+	pfb_spsc_t *q = data;
+	for(uintptr_t i = 0; i < TEST_ITEMS; i++)
+	{
+		pfb_spsc_put(q, item_of(i));
+	}
+	return 0;
+}
+
+void test_pfb_spsc()
+{
+	printf("Testing pfb_spsc..\n");
+	pfb_spsc_t q;
+
+	// rounded up to a power of two
+	pfb_init_spsc(&q, 3);
+	assert(q.mask == 3);
+	assert(pfb_spsc_pop(&q) == nullptr);
+
+	// full after four, in order, empty again after four
+	for(uintptr_t i = 0; i < 4; i++)
+	{
+		assert(pfb_spsc_push(&q, item_of(i)));
+	}
+	assert(!pfb_spsc_push(&q, item_of(4)));
+	for(uintptr_t i = 0; i < 4; i++)
+	{
+		assert(pfb_spsc_pop(&q) == item_of(i));
+	}
+	assert(pfb_spsc_pop(&q) == nullptr);
+
+	// head and tail run past the end of the slots many times over
+	for(uintptr_t i = 0; i < 1000; i++)
+	{
+		assert(pfb_spsc_push(&q, item_of(i)));
+		assert(pfb_spsc_push(&q, item_of(i + 1)));
+		assert(pfb_spsc_push(&q, item_of(i + 2)));
+		assert(pfb_spsc_pop(&q) == item_of(i));
+		assert(pfb_spsc_pop(&q) == item_of(i + 1));
+		assert(pfb_spsc_pop(&q) == item_of(i + 2));
+		assert(pfb_spsc_pop(&q) == nullptr);
+	}
+	for(uintptr_t i = 0; i < 4; i++)
+	{
+		assert(pfb_spsc_push(&q, item_of(i)));
+	}
+	assert(!pfb_spsc_push(&q, item_of(4)));
+	assert(pfb_spsc_pop(&q) == item_of(0));
+	assert(pfb_spsc_push(&q, item_of(4)));
+	for(uintptr_t i = 1; i < 5; i++)
+	{
+		assert(pfb_spsc_take(&q) == item_of(i));
+	}
+	assert(pfb_spsc_pop(&q) == nullptr);
+
+	// put and take wait for each other across two threads
+	thrd_t producer;
+	assert(thrd_create(&producer, test_producer, &q) == thrd_success);
+	for(uintptr_t i = 0; i < TEST_ITEMS; i++)
+	{
+		assert(pfb_spsc_take(&q) == item_of(i));
+	}
+	int res;
+	assert(thrd_join(producer, &res) == thrd_success);
+	assert(res == 0);
+	assert(pfb_spsc_pop(&q) == nullptr);
+
+	pfb_free_spsc(&q);
+	printf("Tested pfb_spsc.\n");
+}
+#endif
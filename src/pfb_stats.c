@@ -0,0 +1,394 @@
+/**
+ * pfb_stats.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// clock_gettime(), sigaction() and getrusage() are POSIX; -std=c23 declares
+// only ISO C otherwise.
+#define _POSIX_C_SOURCE 200809L
+#include "pfb_stats.h"
+#include "pfb_memory.h"
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <sys/resource.h>
+
+// the counters of a thread are added to the totals every so many lines.
+#define STATS_FLUSH_LINES 65536
+
+typedef struct stats_input
+{
+	char *name;
+	size_t lines;
+	size_t bytes;
+	size_t entries;
+	size_t kept;
+} stats_input_t;
+
+static const char *const counter_names[PFB_STATS_COUNTERS] = {
+	[PFB_STATS_LINES_READ] = "lines_read",
+	[PFB_STATS_BYTES_READ] = "bytes_read",
+	[PFB_STATS_LINES_FULL] = "lines_full",
+	[PFB_STATS_LINES_WEAK] = "lines_weak",
+	[PFB_STATS_LINES_COMMENT] = "lines_comment",
+	[PFB_STATS_LINES_HEADER] = "lines_header",
+	[PFB_STATS_LINES_EXCEPTION] = "lines_exception",
+	[PFB_STATS_LINES_BOGUS] = "lines_bogus",
+	[PFB_STATS_LINES_PREFILTERED] = "lines_prefiltered",
+	[PFB_STATS_REJECTED] = "rejected",
+	[PFB_STATS_NODES_CREATED] = "nodes_created",
+	[PFB_STATS_NODES_FREED] = "nodes_freed",
+	[PFB_STATS_SUBTREES_PRUNED] = "subtrees_pruned",
+	[PFB_STATS_UPGRADES] = "upgrades",
+	[PFB_STATS_HASH_RESIZES] = "hash_resizes",
+	[PFB_STATS_CARRY_OVER_LINES] = "carry_over_lines",
+	[PFB_STATS_OUTPUT_LINES] = "output_lines",
+};
+
+static const char *const phase_names[PFB_PHASE_COUNT] = {
+	[PFB_PHASE_READ] = "read",
+	[PFB_PHASE_CONSOLIDATE] = "consolidate",
+	[PFB_PHASE_DIFF] = "diff",
+	[PFB_PHASE_MERGE] = "merge",
+};
+
+static atomic_size_t totals[PFB_STATS_COUNTERS];
+static thread_local size_t pending[PFB_STATS_COUNTERS];
+
+// summed over the threads running the phase.
+static atomic_ullong phase_wall_ns[PFB_PHASE_COUNT];
+static atomic_ullong phase_cpu_ns[PFB_PHASE_COUNT];
+
+static once_flag stats_once = ONCE_FLAG_INIT;
+static mtx_t stats_lock;
+static stats_input_t *inputs = nullptr;
+static size_t inputs_used = 0;
+
+static FILE *stats_file = nullptr;
+static struct timespec stats_start;
+static volatile sig_atomic_t stats_requested = 0;
+
+static void init_stats_lock()
+{
+	mtx_init(&stats_lock, mtx_plain);
+}
+
+static void on_stats_signal(int sig)
+{
+	UNUSED(sig);
+	stats_requested = 1;
+}
+
+void pfb_stats_count(enum pfb_stats_counter counter, size_t n)
+{
+	ASSERT(counter < PFB_STATS_COUNTERS);
+	pending[counter] += n;
+}
+
+/**
+ * Count a line read from an input and what it was parsed as.
+ */
+void pfb_stats_line(MatchStrength_t ms, size_t bytes)
+{
+	pending[PFB_STATS_LINES_READ]++;
+	pending[PFB_STATS_BYTES_READ] += bytes;
+	switch(ms)
+	{
+		case MATCH_FULL:
+			pending[PFB_STATS_LINES_FULL]++;
+			break;
+		case MATCH_WEAK:
+			pending[PFB_STATS_LINES_WEAK]++;
+			break;
+		case MATCH_COMMENT:
+			pending[PFB_STATS_LINES_COMMENT]++;
+			break;
+		case MATCH_HEADER:
+			pending[PFB_STATS_LINES_HEADER]++;
+			break;
+		case MATCH_EXCEPTION:
+			pending[PFB_STATS_LINES_EXCEPTION]++;
+			break;
+		default:
+			pending[PFB_STATS_LINES_BOGUS]++;
+			break;
+	}
+
+	if(pending[PFB_STATS_LINES_READ] >= STATS_FLUSH_LINES)
+	{
+		pfb_stats_flush();
+		pfb_stats_poll();
+	}
+}
+
+/**
+ * Count a line read from an input which the prefilter dropped unparsed.
+ */
+void pfb_stats_line_prefiltered(size_t bytes)
+{
+	pending[PFB_STATS_LINES_READ]++;
+	pending[PFB_STATS_BYTES_READ] += bytes;
+	pending[PFB_STATS_LINES_PREFILTERED]++;
+
+	if(pending[PFB_STATS_LINES_READ] >= STATS_FLUSH_LINES)
+	{
+		pfb_stats_flush();
+		pfb_stats_poll();
+	}
+}
+
+/**
+ * Add the counters of the calling thread to the totals.
+ */
+void pfb_stats_flush()
+{
+	for(uint i = 0; i < PFB_STATS_COUNTERS; i++)
+	{
+		if(pending[i])
+		{
+			atomic_fetch_add_explicit(&totals[i], pending[i],
+					memory_order_relaxed);
+			pending[i] = 0;
+		}
+	}
+}
+
+static unsigned long long elapsed_ns(struct timespec const *from,
+		struct timespec const *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1000000000ull +
+		to->tv_nsec - from->tv_nsec;
+}
+
+pfb_phase_clock_t pfb_stats_begin(enum pfb_stats_phase phase)
+{
+	pfb_phase_clock_t clock = {.phase = phase};
+	clock_gettime(CLOCK_MONOTONIC, &clock.wall);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &clock.cpu);
+	return clock;
+}
+
+/**
+ * Add the wall and CPU time of the calling thread since pfb_stats_begin() to
+ * the phase, flush the counters, and write the stats if asked to.
+ */
+void pfb_stats_end(pfb_phase_clock_t const clock[static 1])
+{
+	ASSERT(clock->phase < PFB_PHASE_COUNT);
+	struct timespec wall, cpu;
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+	atomic_fetch_add_explicit(&phase_wall_ns[clock->phase],
+			elapsed_ns(&clock->wall, &wall), memory_order_relaxed);
+	atomic_fetch_add_explicit(&phase_cpu_ns[clock->phase],
+			elapsed_ns(&clock->cpu, &cpu), memory_order_relaxed);
+
+	pfb_stats_flush();
+	pfb_stats_poll();
+}
+
+/**
+ * Account an input once it is done with: the lines read from it, the
+ * entries it held, and those of them kept in the output. An input read more
+ * than once adds up. Only kept while the stats are written.
+ */
+void pfb_stats_input(char const *name, size_t lines, size_t bytes,
+		size_t entries, size_t kept)
+{
+	ASSERT(name);
+	call_once(&stats_once, init_stats_lock);
+	mtx_lock(&stats_lock);
+	if(!stats_file)
+	{
+		mtx_unlock(&stats_lock);
+		return;
+	}
+
+	stats_input_t *in = nullptr;
+	for(size_t i = 0; i < inputs_used && !in; i++)
+	{
+		if(strcmp(inputs[i].name, name) == 0)
+		{
+			in = &inputs[i];
+		}
+	}
+	if(!in)
+	{
+		CHECK_REALLOC(inputs, sizeof(stats_input_t) * (inputs_used + 1));
+		in = &inputs[inputs_used++];
+		*in = (stats_input_t){.name = strdup(name)};
+		CHECK_MALLOC(in->name);
+	}
+	in->lines += lines;
+	in->bytes += bytes;
+	in->entries += entries;
+	in->kept += kept;
+
+	mtx_unlock(&stats_lock);
+}
+
+static void write_json_string(FILE *out, char const *s)
+{
+	fputc('"', out);
+	for(; *s; s++)
+	{
+		if(*s == '"' || *s == '\\')
+		{
+			fprintf(out, "\\%c", *s);
+		}
+		else if((unsigned char)*s < 0x20)
+		{
+			fprintf(out, "\\u%04x", *s);
+		}
+		else
+		{
+			fputc(*s, out);
+		}
+	}
+	fputc('"', out);
+}
+
+static double timeval_s(struct timeval tv)
+{
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/**
+ * Write the totals as one JSON object on a line. Called with stats_lock held.
+ */
+static void write_stats(bool final)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	fprintf(stats_file, "{\"final\":%s,\"elapsed_s\":%.6f,\"cpu_s\":%.6f,"
+			"\"rss_peak_kb\":%ld,\"mem_peak\":%zu",
+			final ? "true" : "false", elapsed_ns(&stats_start, &now) * 1e-9,
+			timeval_s(usage.ru_utime) + timeval_s(usage.ru_stime),
+			usage.ru_maxrss, pfb_mem_peak());
+
+	for(uint i = 0; i < PFB_STATS_COUNTERS; i++)
+	{
+		fprintf(stats_file, ",\"%s\":%zu", counter_names[i],
+				atomic_load_explicit(&totals[i], memory_order_relaxed));
+	}
+
+	fputs(",\"phases\":{", stats_file);
+	for(uint i = 0; i < PFB_PHASE_COUNT; i++)
+	{
+		fprintf(stats_file, "%s\"%s\":{\"wall_s\":%.6f,\"cpu_s\":%.6f}",
+				i ? "," : "", phase_names[i],
+				atomic_load_explicit(&phase_wall_ns[i], memory_order_relaxed) * 1e-9,
+				atomic_load_explicit(&phase_cpu_ns[i], memory_order_relaxed) * 1e-9);
+	}
+
+	fputs("},\"inputs\":[", stats_file);
+	for(size_t i = 0; i < inputs_used; i++)
+	{
+		fputs(i ? ",{\"name\":" : "{\"name\":", stats_file);
+		write_json_string(stats_file, inputs[i].name);
+		fprintf(stats_file, ",\"lines\":%zu,\"bytes\":%zu,\"entries\":%zu,"
+				"\"kept\":%zu}", inputs[i].lines, inputs[i].bytes,
+				inputs[i].entries, inputs[i].kept);
+	}
+	fputs("]}\n", stats_file);
+	fflush(stats_file);
+}
+
+/**
+ * Write the stats to 'fname', or stderr for '-', on SIGUSR1 and at exit.
+ */
+bool pfb_stats_open(char const *fname)
+{
+	ASSERT(fname);
+	ASSERT(!stats_file);
+	call_once(&stats_once, init_stats_lock);
+
+	stats_file = strcmp(fname, "-") == 0 ? stderr : fopen(fname, "w");
+	if(!stats_file)
+	{
+		ELOG_STDERR("ERROR: failed to open %s for writing\n", fname);
+		return false;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &stats_start);
+
+	// restart the reads a signal interrupts; the daemon wakes from poll().
+	struct sigaction sa = {.sa_handler = on_stats_signal, .sa_flags = SA_RESTART};
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, nullptr);
+
+	atexit(pfb_stats_close);
+	return true;
+}
+
+/**
+ * Write the stats if SIGUSR1 was received since they were last written.
+ * Called between lines and phases; the signal handler only sets a flag.
+ */
+void pfb_stats_poll()
+{
+	if(!stats_requested)
+	{
+		return;
+	}
+
+	call_once(&stats_once, init_stats_lock);
+	mtx_lock(&stats_lock);
+	if(stats_requested && stats_file)
+	{
+		stats_requested = 0;
+		pfb_stats_flush();
+		write_stats(false);
+	}
+	mtx_unlock(&stats_lock);
+}
+
+/**
+ * Write the final stats and close the file. Registered with atexit() so an
+ * early exit reports too.
+ */
+void pfb_stats_close()
+{
+	if(!stats_file)
+	{
+		return;
+	}
+
+	mtx_lock(&stats_lock);
+	pfb_stats_flush();
+	write_stats(true);
+	if(stats_file != stderr)
+	{
+		fclose(stats_file);
+	}
+	stats_file = nullptr;
+
+	for(size_t i = 0; i < inputs_used; i++)
+	{
+		free(inputs[i].name);
+	}
+	free(inputs);
+	inputs = nullptr;
+	inputs_used = 0;
+	mtx_unlock(&stats_lock);
+}
@@ -0,0 +1,490 @@
+/**
+ * pfb_update.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "dedupdomains.h"
+#include "pfb_allow.h"
+#include "pfb_context.h"
+#include "pfb_differ.h"
+#include "pfb_hash.h"
+#include "pfb_index.h"
+#include "pfb_update.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * An index remembers which inputs, identified by pfb_index_source_t, hold each
+ * entry; including the entries blocked by a parent from another input. An
+ * update keeps what the unchanged inputs contributed, drops what the removed
+ * or changed inputs contributed, and de-duplicates only the new or changed
+ * inputs. Parents are honored in both directions: a new parent blocks entries
+ * already in the index, and entries blocked by a parent that goes away are
+ * written again. So are exceptions: each allowed domain is kept with the
+ * sources holding its exception and removes the entries of every source.
+ */
+
+/**
+ * The streams given to the first merge. The entries of the old index come
+ * first followed by one stream per new or changed input.
+ */
+enum update_streams
+{
+	UPDATE_OLD_VISIBLE = 0,
+	UPDATE_OLD_SHADOW = 1,
+	UPDATE_FIRST_NEW = 2,
+};
+
+typedef struct update_context
+{
+	// bit per old source; where its entries went, or -1 if removed or changed.
+	int old_to_new[PFB_INDEX_MAX_SOURCES];
+	pfb_index_sources_t old;
+	// new source of each stream from UPDATE_FIRST_NEW on.
+	uint const *stream_source;
+	// the streams merged; the line written is read from one of them.
+	pfb_out_buffer_t *const *in;
+
+	pfb_out_context_t out_context;
+	uint64_t *masks;
+	size_len_t masks_alloc;
+} update_context_t;
+
+static uint64_t remap_mask(update_context_t const uc[static 1], uint64_t mask)
+{
+	uint64_t ret = 0;
+	for(uint j = 0; j < uc->old.source_count; j++)
+	{
+		if((mask >> j) & 1 && uc->old_to_new[j] >= 0)
+		{
+			ret |= 1ULL << uc->old_to_new[j];
+		}
+	}
+	return ret;
+}
+
+/**
+ * Gather the sources now holding each entry; entries no longer held by any
+ * source are dropped. The line is written as one of those sources holds it,
+ * not as a removed or changed source did.
+ */
+static void visit_update_sources(DV_merge_group_t const group[static 1],
+		void *context)
+{
+	update_context_t *uc = context;
+	ASSERT(uc);
+
+	uint64_t mask = 0;
+	uint line_owner = group->owners_used;
+	for(uint i = 0; i < group->owners_used; i++)
+	{
+		const uint owner = group->owners[i];
+		const size_len_t pos = group->positions[i];
+		uint64_t owner_mask;
+		if(owner == UPDATE_OLD_VISIBLE)
+		{
+			owner_mask = remap_mask(uc, uc->old.masks[pos]);
+		}
+		else if(owner == UPDATE_OLD_SHADOW)
+		{
+			owner_mask = remap_mask(uc, uc->old.shadow_masks[pos]);
+		}
+		else
+		{
+			owner_mask = 1ULL << uc->stream_source[owner - UPDATE_FIRST_NEW];
+		}
+
+		if(owner_mask != 0 && line_owner == group->owners_used)
+		{
+			line_owner = i;
+		}
+		mask |= owner_mask;
+	}
+
+	if(mask == 0)
+		return;
+
+	pfb_out_buffer_t const *from = uc->in[group->owners[line_owner]];
+	const line_info_t li = from->litelines.li[group->positions[line_owner]];
+	pfb_out_buffer_t *out_buffer = uc->out_context.out_buffer;
+	uc->out_context.writer_cb(from->buffer + li.offset, li.line_len,
+			&uc->out_context);
+	uc->out_context.counter++;
+
+	const size_len_t idx = out_buffer->litelines.used - 1;
+	if(idx >= uc->masks_alloc)
+	{
+		uc->masks_alloc = MAX(2 * uc->masks_alloc, 1024u);
+		CHECK_REALLOC(uc->masks, sizeof(uint64_t) * uc->masks_alloc);
+	}
+	uc->masks[idx] = mask;
+}
+
+/**
+ * The allowed domains of the sources, each null terminated, and the new
+ * sources holding each.
+ */
+typedef struct update_allowed
+{
+	char *names;
+	size_t names_used;
+	size_t names_alloc;
+	uint64_t *masks;
+	size_t count;
+	size_t masks_alloc;
+} update_allowed_t;
+
+static void add_allowed(update_allowed_t ua[static 1], const char *name,
+		size_t len, uint64_t mask)
+{
+	if(ua->names_used + len + 1 > ua->names_alloc)
+	{
+		ua->names_alloc = MAX(2 * ua->names_alloc, ua->names_used + len + 1024);
+		CHECK_REALLOC(ua->names, ua->names_alloc);
+	}
+	memcpy(ua->names + ua->names_used, name, len);
+	ua->names[ua->names_used + len] = '\0';
+	ua->names_used += len + 1;
+
+	if(ua->count == ua->masks_alloc)
+	{
+		ua->masks_alloc = MAX(2 * ua->masks_alloc, 64u);
+		CHECK_REALLOC(ua->masks, sizeof(uint64_t) * ua->masks_alloc);
+	}
+	ua->masks[ua->count++] = mask;
+}
+
+/**
+ * Add the allowed domains of the old index still held by a source, then those
+ * of every input loaded.
+ */
+static void gather_allowed(update_context_t const uc[static 1],
+		pfb_out_buffer_t const old_index[static 1],
+		pfb_out_buffer_t const sets[], uint loaded,
+		update_allowed_t ua[static 1])
+{
+	size_t k = 0;
+	for(size_t i = 0; i < old_index->allowed_len && k < uc->old.allowed_count; k++)
+	{
+		const char *name = old_index->allowed + i;
+		const size_t len = strlen(name);
+		const uint64_t mask = remap_mask(uc, uc->old.allowed_masks[k]);
+		if(mask != 0)
+		{
+			add_allowed(ua, name, len, mask);
+		}
+		i += len + 1;
+	}
+
+	for(uint j = 0; j < loaded; j++)
+	{
+		for(size_t i = 0; i < sets[j].allowed_len; )
+		{
+			const char *name = sets[j].allowed + i;
+			const size_t len = strlen(name);
+			add_allowed(ua, name, len, 1ULL << uc->stream_source[j]);
+			i += len + 1;
+		}
+	}
+}
+
+typedef struct split_context
+{
+	// the domains allowed by the sources; nullptr if there are none.
+	pfb_allow_t *allow;
+	uint64_t const *masks;
+	LiteLineData_t const *all;
+	LiteLineData_t visible;
+	uint64_t *visible_masks;
+	LiteLineData_t shadow;
+	uint64_t *shadow_masks;
+} split_context_t;
+
+/**
+ * Separate the entries blocked by a parent or allowed by an exception from
+ * those written to the list.
+ */
+static void visit_update_split(DV_merge_group_t const group[static 1],
+		void *context)
+{
+	split_context_t *sc = context;
+	ASSERT(sc);
+	ASSERT(group->owners_used == 1);
+
+	const size_len_t pos = group->positions[0];
+	LiteLineData_t *to = &sc->visible;
+	uint64_t *to_masks = sc->visible_masks;
+	if(group->covered_used > 0 || (sc->allow && pfb_is_allowed(sc->allow,
+				group->line, group->line_len, group->dv->match_strength)))
+	{
+		to = &sc->shadow;
+		to_masks = sc->shadow_masks;
+	}
+
+	to->li[to->used] = sc->all->li[pos];
+	to_masks[to->used] = sc->masks[pos];
+	to->used++;
+}
+
+static bool stat_source(path_info_t const path[static 1],
+		pfb_index_source_t source[static 1])
+{
+	*source = (pfb_index_source_t){
+		.st_dev = path->pfb_s.st_dev,
+		.st_ino = path->pfb_s.st_ino,
+		.file_size = path->pfb_s.file_size,
+	};
+	return pfb_hash_file(path->path, &source->hash);
+}
+
+static bool same_source(pfb_index_source_t const a[static 1],
+		pfb_index_source_t const b[static 1])
+{
+	return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+		a->file_size == b->file_size && a->hash == b->hash;
+}
+
+static bool write_index_file(const char out_fname[static 1],
+		pfb_out_buffer_t const visible[static 1],
+		pfb_index_sources_t const sources[static 1])
+{
+	// written aside and renamed over the output so the old index, which may
+	// be the output, is never left half written.
+	const size_t len = strlen(out_fname) + sizeof(".tmp");
+	char *tmp_fname = malloc(len);
+	CHECK_MALLOC(tmp_fname);
+	snprintf(tmp_fname, len, "%s.tmp", out_fname);
+
+	FILE *out_file = fopen(tmp_fname, "wb");
+	if(!out_file)
+	{
+		ELOG_STDERR("ERROR: failed to open %s for writing\n", tmp_fname);
+		free(tmp_fname);
+		return false;
+	}
+
+	bool ok = pfb_write_index_sources(out_file, visible, sources);
+	ok = fclose(out_file) == 0 && ok;
+	if(ok && rename(tmp_fname, out_fname) != 0)
+	{
+		ELOG_STDERR("ERROR: failed to rename %s to %s\n", tmp_fname, out_fname);
+		ok = false;
+	}
+	if(!ok)
+	{
+		unlink(tmp_fname);
+	}
+	free(tmp_fname);
+	return ok;
+}
+
+/**
+ * Update the index at 'index_path' to hold the de-duplicated entries of the
+ * inputs in 'in_paths_list' and write it to 'out_fname', which may be the same
+ * path. Only the inputs that are new or changed since the index was written
+ * are loaded, each with 'load_set'. A missing index, or one written without
+ * its sources, is rebuilt from all inputs.
+ */
+bool pfb_update_index(const char index_path[static 1],
+		paths_list_t in_paths_list, const char out_fname[static 1],
+		bool (*load_set)(paths_list_t, pfb_out_buffer_t[static 1]))
+{
+	ASSERT(load_set);
+	ASSERT(in_paths_list.len > 0);
+
+	const uint source_count = in_paths_list.len;
+	if(source_count > PFB_INDEX_MAX_SOURCES)
+	{
+		ELOG_STDERR("ERROR: an index can track at most %d inputs; given %u\n",
+				PFB_INDEX_MAX_SOURCES, source_count);
+		return false;
+	}
+
+	pfb_index_source_t sources[PFB_INDEX_MAX_SOURCES] = {};
+	for(uint i = 0; i < source_count; i++)
+	{
+		if(!stat_source(&in_paths_list.paths[i], &sources[i]))
+		{
+			return false;
+		}
+	}
+
+	update_context_t uc = {};
+	pfb_out_buffer_t old_index = {};
+	bool have_old = false;
+	if(access(index_path, F_OK) == 0)
+	{
+		if(!pfb_map_index(index_path, &old_index))
+		{
+			return false;
+		}
+		have_old = pfb_index_sources(&old_index, &uc.old);
+		if(!have_old)
+		{
+			ELOG_STDERR("NOTICE: %s does not record its inputs; rebuilding it.\n",
+					index_path);
+		}
+	}
+
+	bool kept[PFB_INDEX_MAX_SOURCES] = {};
+	for(uint j = 0; j < uc.old.source_count; j++)
+	{
+		uc.old_to_new[j] = -1;
+		for(uint i = 0; i < source_count; i++)
+		{
+			if(!kept[i] && same_source(&uc.old.sources[j], &sources[i]))
+			{
+				kept[i] = true;
+				uc.old_to_new[j] = i;
+				break;
+			}
+		}
+	}
+
+	// at most one stream per input plus the two of the old index.
+	pfb_out_buffer_t *sets = calloc(source_count, sizeof(pfb_out_buffer_t));
+	CHECK_MALLOC(sets);
+	pfb_out_buffer_t **in = calloc(source_count + UPDATE_FIRST_NEW,
+			sizeof(pfb_out_buffer_t*));
+	CHECK_MALLOC(in);
+	uint *stream_source = calloc(source_count, sizeof(uint));
+	CHECK_MALLOC(stream_source);
+
+	// views into the old mapping; owned by old_index.
+	pfb_out_buffer_t old_visible = {};
+	pfb_out_buffer_t old_shadow = {};
+	if(have_old)
+	{
+		old_visible = (pfb_out_buffer_t){
+			.buffer = old_index.buffer,
+			.next_idx = old_index.next_idx,
+			.alloc_len = old_index.alloc_len,
+			.litelines = old_index.litelines,
+		};
+		old_shadow = old_visible;
+		old_shadow.litelines = uc.old.shadow;
+	}
+	in[UPDATE_OLD_VISIBLE] = &old_visible;
+	in[UPDATE_OLD_SHADOW] = &old_shadow;
+
+	uint loaded = 0;
+	for(uint i = 0; i < source_count; i++)
+	{
+		if(kept[i])
+			continue;
+
+		const paths_list_t one = {
+			.paths = &in_paths_list.paths[i],
+			.len = 1,
+			.alloced = 1,
+		};
+		if(!load_set(one, &sets[loaded]))
+		{
+			for(uint j = 0; j < loaded; j++)
+			{
+				pfb_free_out_buffer(&sets[j]);
+			}
+			pfb_free_out_buffer(&old_index);
+			free(stream_source);
+			free(in);
+			free(sets);
+			return false;
+		}
+		in[UPDATE_FIRST_NEW + loaded] = &sets[loaded];
+		stream_source[loaded] = i;
+		loaded++;
+	}
+	uc.stream_source = stream_source;
+	uc.in = in;
+
+	DEBUG_PRINTF("update: %u of %u inputs loaded\n", loaded, source_count);
+
+	pfb_out_buffer_t all = {
+		.buffer = malloc(4096),
+		.alloc_len = 4096,
+	};
+	CHECK_MALLOC(all.buffer);
+	uc.out_context = pfb_init_out_context_BUFFER(&all);
+	merge_adbplus_adlists_BUFFER(in, UPDATE_FIRST_NEW + loaded,
+			visit_update_sources, &uc);
+
+	update_allowed_t ua = {};
+	gather_allowed(&uc, &old_index, sets, loaded, &ua);
+
+	// the entries of the old index are copied out; the mapping can go.
+	for(uint i = 0; i < loaded; i++)
+	{
+		pfb_free_out_buffer(&sets[i]);
+	}
+	pfb_free_out_buffer(&old_index);
+	free(stream_source);
+	free(in);
+	free(sets);
+
+	pfb_allow_t allow = pfb_init_allow(false);
+	pfb_insert_allowed(&allow, ua.names, ua.names_used);
+
+	const size_len_t count = all.litelines.used;
+	split_context_t sc = {
+		.allow = ua.count > 0 ? &allow : nullptr,
+		.masks = uc.masks,
+		.all = &all.litelines,
+		.visible = {.li = malloc(sizeof(line_info_t) * (count + 1)), .alloc = count},
+		.visible_masks = malloc(sizeof(uint64_t) * (count + 1)),
+		.shadow = {.li = malloc(sizeof(line_info_t) * (count + 1)), .alloc = count},
+		.shadow_masks = malloc(sizeof(uint64_t) * (count + 1)),
+	};
+	CHECK_MALLOC(sc.visible.li);
+	CHECK_MALLOC(sc.visible_masks);
+	CHECK_MALLOC(sc.shadow.li);
+	CHECK_MALLOC(sc.shadow_masks);
+
+	pfb_out_buffer_t *all_in[] = {&all};
+	merge_adbplus_adlists_BUFFER(all_in, 1, visit_update_split, &sc);
+
+	const pfb_out_buffer_t visible = {
+		.buffer = all.buffer,
+		.next_idx = all.next_idx,
+		.alloc_len = all.alloc_len,
+		.litelines = sc.visible,
+		.allowed = ua.names,
+		.allowed_len = ua.names_used,
+	};
+	const pfb_index_sources_t new_sources = {
+		.sources = sources,
+		.source_count = source_count,
+		.masks = sc.visible_masks,
+		.shadow = sc.shadow,
+		.shadow_masks = sc.shadow_masks,
+		.allowed_masks = ua.masks,
+		.allowed_count = ua.count,
+	};
+	const bool ok = write_index_file(out_fname, &visible, &new_sources);
+
+	free(sc.visible.li);
+	free(sc.visible_masks);
+	free(sc.shadow.li);
+	free(sc.shadow_masks);
+	free(uc.masks);
+	pfb_free_allow(&allow);
+	free(ua.names);
+	free(ua.masks);
+	pfb_free_out_buffer(&all);
+	return ok;
+}
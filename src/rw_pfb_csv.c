@@ -133,8 +133,9 @@ static bool load_LineData(char const *buffer, char const *end_buffer,
 	// elements on a web page, scripts, cookies, etc.
 	if(request_alloc > MAX_ALLOC_LINE)
 	{
-		ELOG_STDERR("WARNING: requested line length %lu exceeds acceptable maximum of %lu characters.",
+		ELOG_STDERR("WARNING: requested line length %lu exceeds acceptable maximum of %lu characters.\n",
 				request_alloc, MAX_ACCEPTABLE_LINE_LENGTH);
+#ifndef NDEBUG
 		DEBUG_PRINTF("line_len=%u\n", ld->li.line_len);
 		const size_t peak_len = 50;
 		DEBUG_PRINTF("First %lu characters of ld->buffer:", peak_len);
@@ -142,6 +143,7 @@ static bool load_LineData(char const *buffer, char const *end_buffer,
 		DEBUG_PRINTF("\ncurrent buffer first %lu bytes:", peak_len);
 		fwrite(buffer, 1, MIN(real_len, peak_len), stderr);
 		DEBUG_PRINTF("\n");
+#endif
 
 		// nuke the entire line.
 		ld->pos = ld->buffer;
@@ -351,6 +353,10 @@ void pfb_read_one_context(pfb_context_t pfbc[static 1],
 {
 	ASSERT(pfbc);
 
+	// the same warning for many lines of this input is logged once with a
+	// count.
+	pfb_log_input(pfbc->in_fname ? pfbc->in_fname : "unnamed input");
+
 	// reading from a file.
 
 	// TODO determine a sane value for this large in memory buffer. ideally it
@@ -404,6 +410,8 @@ void pfb_read_one_context(pfb_context_t pfbc[static 1],
 		ASSERT(do_stuff);
 		read_pfb_line(pfbc, nullptr, READ_BUFFER_SIZE, do_stuff, context);
 	}
+
+	pfb_log_input(nullptr);
 }
 
 #ifdef BUILD_TESTS
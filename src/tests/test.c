@@ -148,6 +148,8 @@ void run_tests()
 	printf("Running tests...");
 	test_domain();
 	test_DomainTree();
+	test_pfb_session();
+	test_pfb_spsc();
 	test_rw_pfb_csv();
 	//test_pfb_prune();
 	test_end2end();
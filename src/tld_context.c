@@ -20,16 +20,29 @@
  */
 #include "tld_context.h"
 #include "tld_hash_context.h"
+#include "tld_sharded_context.h"
 
 const TLD_func_table_t all_impls[] = {
 	{
 		hash_context_insert_tld,
+		nullptr,
+		hash_context_find_tld,
 		hash_context_sort_entries,
 		hash_context_create_entry_iter,
 		hash_context_next_tld_entry,
 		hash_context_free_entry_iter,
 		hash_context_free_context,
 	},
+	{
+		sharded_context_insert_tld,
+		sharded_context_release_tld,
+		sharded_context_find_tld,
+		sharded_context_sort_entries,
+		sharded_context_create_entry_iter,
+		sharded_context_next_tld_entry,
+		sharded_context_free_entry_iter,
+		sharded_context_free_context,
+	},
 };
 
 void free_tld_impl(TLD_implementation_t tld_impl[static 1])
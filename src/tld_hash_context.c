@@ -20,8 +20,8 @@
  */
 #include "tld_context.h"
 #include "tld_hash_context.h"
-#include "uthash.h"
 #include "domaintree.h"
+#include "uthash.h"
 #include "domain.h"
 
 typedef struct TLD_context_impl
@@ -74,12 +74,14 @@ void hash_context_create_entry_iter(TLD_context_t c,
 	CHECK_MALLOC(entryiter);
 	TLD_context_impl_t *impl = (TLD_context_impl_t*)c;
 
-	ASSERT(impl->root); // TODO handle empty tree scenario; this is nil.
 	entryiter->root = impl->root;
-	ASSERT(entryiter->root);
 
 	*iter = entryiter;
-	*dt = &entryiter->root->child;
+	// an empty tree has no first entry; *dt remains nullptr.
+	if(entryiter->root)
+	{
+		*dt = &entryiter->root->child;
+	}
 }
 
 void hash_context_free_entry_iter(TLD_EntryIter_t iter[static 1])
@@ -143,6 +145,17 @@ DomainTree_t** hash_context_insert_tld(TLD_context_t ic, SubdomainView_t sdv)
 	return &entry->child;
 }
 
+DomainTree_t** hash_context_find_tld(TLD_context_t ic, SubdomainView_t sdv)
+{
+	ASSERT(ic);
+	TLD_context_impl_t *c = (TLD_context_impl_t*)ic;
+
+	TLD_entry_impl_t *entry = nullptr;
+	HASH_FIND(hh, c->root, sdv.data, sdv.len, entry);
+
+	return entry ? &entry->child : nullptr;
+}
+
 void hash_context_sort_entries(TLD_context_t context)
 {
 	TLD_context_impl_t *h_context = (TLD_context_impl_t*)context;
@@ -0,0 +1,281 @@
+/**
+ * tld_sharded_context.c
+ *
+ * Part of pfb_adbplus_dedup_diff
+ *
+ * Copyright (c) 2025 robert.babilon@gmail.com
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "tld_context.h"
+#include "tld_sharded_context.h"
+#include "domaintree.h"
+#include "uthash.h"
+#include "domain.h"
+#include <stdalign.h>
+#include <threads.h>
+
+/**
+ * The TLDs are spread over shards by the top bits of their hash; uthash
+ * places an entry in a bucket by the low bits, so the entries of a shard
+ * still spread over its buckets.
+ */
+#define TLD_SHARDS 256
+#define TLD_SHARD_SHIFT 24
+
+typedef struct TLD_entry_impl
+{
+	UT_hash_handle hh;
+	/**
+	 * The uthash table for the subdomains of this TLD.
+	 */
+	struct DomainTree *child;
+	/**
+	 * length in characters of the tld array.
+	 */
+	size_len_t len;
+	/**
+	 * Holds the TLD.
+	 */
+	char tld[];
+} TLD_entry_impl_t;
+
+/**
+ * One lock guards the table of a shard and the trees of all of its TLDs. It
+ * is held from sharded_context_insert_tld() to sharded_context_release_tld(),
+ * i.e., for the whole of an insert_DomainTree().
+ */
+typedef struct TLD_shard_impl
+{
+	alignas(64) mtx_t lock;
+	TLD_entry_impl_t *root;
+} TLD_shard_impl_t;
+
+typedef struct TLD_context_impl
+{
+	TLD_shard_impl_t shards[TLD_SHARDS];
+	bool sorted;
+} TLD_context_impl_t;
+
+TLD_implementation_t create_tld_sharded_impl()
+{
+	TLD_context_impl_t *sc = calloc(1, sizeof(TLD_context_impl_t));
+	CHECK_MALLOC(sc);
+	for(uint i = 0; i < TLD_SHARDS; i++)
+	{
+		mtx_init(&sc->shards[i].lock, mtx_plain);
+	}
+	TLD_implementation_t impl = {
+		sc,
+		&all_impls[sharded_impl_type],
+	};
+	return impl;
+}
+
+/**
+ * The entries of all shards, gathered when the iterator is created; the
+ * shards are not written while it is in use.
+ */
+typedef struct TLD_entryiter_impl
+{
+	TLD_entry_impl_t **entries;
+	size_t count;
+	size_t next;
+} TLD_entryiter_impl_t;
+
+static int sort_TLD_entry_by_tld(const void *pa, const void *pb)
+{
+	TLD_entry_impl_t const *a = *(TLD_entry_impl_t *const *)pa;
+	TLD_entry_impl_t const *b = *(TLD_entry_impl_t *const *)pb;
+	int first_n = memcmp(a->tld, b->tld, MIN(a->len, b->len));
+	int ret;
+	if(first_n == 0)
+		ret = a->len - b->len;
+	else
+		ret = first_n;
+	return ret;
+}
+
+void sharded_context_create_entry_iter(TLD_context_t c,
+		TLD_EntryIter_t iter[static 1], DomainTree_t **dt[static 1])
+{
+	ASSERT(c);
+	ASSERT(iter);
+	ASSERT(*iter == nullptr);
+	ASSERT(dt);
+	ASSERT(*dt == nullptr);
+	TLD_entryiter_impl_t *entryiter = calloc(1, sizeof(TLD_entryiter_impl_t));
+	CHECK_MALLOC(entryiter);
+	TLD_context_impl_t *impl = (TLD_context_impl_t*)c;
+
+	for(uint i = 0; i < TLD_SHARDS; i++)
+	{
+		entryiter->count += HASH_COUNT(impl->shards[i].root);
+	}
+	if(entryiter->count > 0)
+	{
+		entryiter->entries = malloc(entryiter->count * sizeof(TLD_entry_impl_t*));
+		CHECK_MALLOC(entryiter->entries);
+	}
+
+	size_t n = 0;
+	for(uint i = 0; i < TLD_SHARDS; i++)
+	{
+		for(TLD_entry_impl_t *e = impl->shards[i].root; e; e = e->hh.next)
+		{
+			entryiter->entries[n++] = e;
+		}
+	}
+	ASSERT(n == entryiter->count);
+
+	// the order of the hash impl after hash_context_sort_entries().
+	if(impl->sorted && n > 1)
+	{
+		qsort(entryiter->entries, n, sizeof(TLD_entry_impl_t*),
+				sort_TLD_entry_by_tld);
+	}
+
+	*iter = entryiter;
+	// an empty tree has no first entry; *dt remains nullptr.
+	if(n > 0)
+	{
+		*dt = &entryiter->entries[0]->child;
+		entryiter->next = 1;
+	}
+}
+
+void sharded_context_free_entry_iter(TLD_EntryIter_t iter[static 1])
+{
+	TLD_entryiter_impl_t *entryiter = (TLD_entryiter_impl_t*)*iter;
+	if(entryiter)
+	{
+		free(entryiter->entries);
+	}
+	free(entryiter);
+	*iter = nullptr;
+}
+
+DomainTree_t** sharded_context_next_tld_entry(TLD_EntryIter_t entryiter)
+{
+	ASSERT(entryiter);
+	TLD_entryiter_impl_t *s_entryiter = (TLD_entryiter_impl_t*)entryiter;
+
+	if(s_entryiter->next < s_entryiter->count)
+	{
+		return &s_entryiter->entries[s_entryiter->next++]->child;
+	}
+
+	return nullptr;
+}
+
+static TLD_shard_impl_t *find_shard(TLD_context_impl_t c[static 1],
+		SubdomainView_t const sdv[static 1], unsigned hashv[static 1])
+{
+	HASH_VALUE(sdv->data, sdv->len, *hashv);
+	return &c->shards[(*hashv >> TLD_SHARD_SHIFT) % TLD_SHARDS];
+}
+
+/**
+ * Lock the shard of the TLD and return its tree, adding the TLD if it is
+ * new. The shard stays locked until sharded_context_release_tld().
+ */
+DomainTree_t** sharded_context_insert_tld(TLD_context_t ic, SubdomainView_t sdv)
+{
+	ASSERT(ic);
+	TLD_context_impl_t *c = (TLD_context_impl_t*)ic;
+
+	unsigned hashv;
+	TLD_shard_impl_t *shard = find_shard(c, &sdv, &hashv);
+	mtx_lock(&shard->lock);
+
+	TLD_entry_impl_t *entry = nullptr;
+	HASH_FIND_BYHASHVALUE(hh, shard->root, sdv.data, sdv.len, hashv, entry);
+
+	if(!entry)
+	{
+		TLD_entry_impl_t *ntld_entry = calloc(1, sizeof(TLD_entry_impl_t)
+				+ sizeof(char) * sdv.len);
+		CHECK_MALLOC(ntld_entry);
+		memcpy(ntld_entry->tld, sdv.data, sdv.len);
+		ntld_entry->len = sdv.len;
+		HASH_ADD_KEYPTR_BYHASHVALUE(hh, shard->root, ntld_entry->tld, sdv.len,
+				hashv, ntld_entry);
+		ASSERT(ntld_entry->child == nullptr);
+		return &ntld_entry->child;
+	}
+
+	return &entry->child;
+}
+
+void sharded_context_release_tld(TLD_context_t ic, SubdomainView_t sdv)
+{
+	ASSERT(ic);
+	TLD_context_impl_t *c = (TLD_context_impl_t*)ic;
+
+	unsigned hashv;
+	mtx_unlock(&find_shard(c, &sdv, &hashv)->lock);
+}
+
+/**
+ * Not to be called while other threads insert; no lock is taken.
+ */
+DomainTree_t** sharded_context_find_tld(TLD_context_t ic, SubdomainView_t sdv)
+{
+	ASSERT(ic);
+	TLD_context_impl_t *c = (TLD_context_impl_t*)ic;
+
+	unsigned hashv;
+	TLD_shard_impl_t *shard = find_shard(c, &sdv, &hashv);
+
+	TLD_entry_impl_t *entry = nullptr;
+	HASH_FIND_BYHASHVALUE(hh, shard->root, sdv.data, sdv.len, hashv, entry);
+
+	return entry ? &entry->child : nullptr;
+}
+
+/**
+ * The shards are not sorted in place; the iterator sorts the entries of all
+ * of them at once.
+ */
+void sharded_context_sort_entries(TLD_context_t context)
+{
+	TLD_context_impl_t *s_context = (TLD_context_impl_t*)context;
+
+	s_context->sorted = true;
+}
+
+void sharded_context_free_context(TLD_context_t c[static 1])
+{
+	ASSERT(c);
+	TLD_context_impl_t *sc = *c;
+	ASSERT(sc);
+
+	for(uint i = 0; i < TLD_SHARDS; i++)
+	{
+		TLD_shard_impl_t *shard = &sc->shards[i];
+		TLD_entry_impl_t *current = nullptr, *tmp = nullptr;
+		HASH_ITER(hh, shard->root, current, tmp)
+		{
+			// expect the DomainTree_t held in 'child' to have been destroyed
+			// and cleared prior to the destruction of the top level.
+			ASSERT(current->child == nullptr);
+			HASH_DEL(shard->root, current);
+			free(current);
+		}
+		mtx_destroy(&shard->lock);
+	}
+
+	free(sc);
+	*c = nullptr;
+}